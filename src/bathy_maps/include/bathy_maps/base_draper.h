@@ -14,12 +14,18 @@
 
 #include <Eigen/Dense>
 #include <random>
+#include <mutex>
+#include <map>
+#include <tuple>
 
 #include <data_tools/xtf_data.h>
 #include <data_tools/csv_data.h>
 #include <sonar_tracing/bathy_tracer.h>
+#include <sonar_tracing/travel_time_table.h>
+#include <bathy_maps/sound_speed_profiles.h>
 
 struct ping_draping_result;
+struct compact_ping_draping_result;
 
 using sss_draping_result = std::pair<ping_draping_result, ping_draping_result>;
 
@@ -53,6 +59,59 @@ struct ping_draping_result {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+// caller owned buffers for draping one side of a ping, which are only grown
+// and may be reused between pings. the first nbr_hits rows of the per hit
+// vectors are valid, and the per bin data has one row per waterfall bin
+struct side_draping_buffers {
+
+    int nbr_hits;
+
+    // per hit data, in the same order as the hits
+    Eigen::VectorXd hits_times;
+    Eigen::VectorXi hits_bins; // waterfall bin of each hit, -1 if outside
+    Eigen::VectorXd hits_intensities; // measured intensities
+    Eigen::VectorXd hits_model_intensities;
+
+    // per bin averages of the hits in each bin
+    Eigen::MatrixXd bin_points;
+    Eigen::MatrixXd bin_normals;
+    Eigen::VectorXd bin_model_intensities;
+    Eigen::VectorXd bin_counts;
+
+    side_draping_buffers() : nbr_hits(0) {}
+};
+
+// multibeam hits of a whole trajectory, beam j of pose i is at row i*nbr_beams + j
+// of hits, which is zero where valid(i, j) is false
+struct mbes_simulation_result {
+
+    using ValidT = Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    Eigen::MatrixXd hits;
+    ValidT valid;
+};
+
+// cache of sidescan beam fans, keyed on tilt angle and beam width quantized to angle_step
+// and the number of lines. a fan is stored as the cross track slopes of the lines, the
+// port line directions in the sensor frame are (0, slope, -1) and starboard (0, -slope, -1)
+class sss_beam_fan_cache {
+public:
+
+    using FanPtr = std::shared_ptr<const Eigen::VectorXd>;
+
+private:
+
+    double angle_step;
+    std::mutex fans_mutex;
+    std::map<std::tuple<int, int, int>, FanPtr> fans;
+
+public:
+
+    sss_beam_fan_cache(double angle_step = 1e-3) : angle_step(angle_step) {}
+
+    FanPtr get_fan(double tilt_angle, double beam_width, int nbr_lines); // nullptr if the angles are not finite
+};
+
 struct BaseDraper {
 public:
 
@@ -81,29 +140,46 @@ protected:
     //Eigen::VectorXi hit_counts;
     //Eigen::MatrixXd N_faces; // the normals of F1, V1, i.e. the bathymetry mesh
     csv_data::csv_asvp_sound_speed::EntriesT sound_speeds;
+    SoundSpeedProfiles sound_speed_profiles; // index of sound_speeds by time and position
     double sensor_yaw;
     Eigen::Vector3d sensor_offset_port;
     Eigen::Vector3d sensor_offset_stbd;
     bool ray_tracing_enabled; // is snell ray tracing enabled?
-    double tracing_map_size; // TODO: remove this as it is no longer needed
+    double tracing_map_size; // max horizontal range of the refraction travel time tables
+    std::shared_ptr<TravelTimeTableCache> travel_time_tables; // shared between copies, thread safe
     double intensity_multiplier;
     std::default_random_engine generator; // hopefully not same seed every time
+    std::shared_ptr<sss_beam_fan_cache> beam_fans; // shared between copies, thread safe
+    int nbr_sss_lines; // rays per side, unless adaptive
+    double rays_per_sample; // rays per sidescan sample in slant range if > 0, otherwise nbr_sss_lines rays
+
+    // a new tracer context on the shared scene of V1, F1, or the height field of tracer.
+    // tracer itself is not rebound, so concurrent calls may each make their own
+    BathyTracer make_tracer_context() const;
+
+    int compute_nbr_sss_lines(const std_data::sss_ping& ping, double altitude, double tilt_angle,
+                              double beam_width, double sound_speed);
 
     // NOTE: these are new style functions
     std::pair<Eigen::MatrixXd, Eigen::MatrixXd> compute_sss_dirs(const Eigen::Matrix3d& R, double tilt_angle, double beam_width, int nbr_lines);
+    // same as above but writes the directions into dirs_left and dirs_right, which are reused if they have nbr_lines rows
+    void compute_sss_dirs(const Eigen::Matrix3d& R, double tilt_angle, double beam_width, int nbr_lines,
+                          Eigen::MatrixXd& dirs_left, Eigen::MatrixXd& dirs_right);
     std::tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> project(const std_data::sss_ping& ping);
+    std::tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> project(const std_data::sss_ping& ping, BathyTracer& context);
     std::tuple<Eigen::MatrixXd, Eigen::MatrixXd> trace_side(const std_data::sss_ping_side& ping,
                                                             const Eigen::Vector3d& sensor_origin,
-                                                            const Eigen::MatrixXd& dirs);
+                                                            const Eigen::MatrixXd& dirs,
+                                                            BathyTracer& context);
 
-    ping_draping_result project_ping_side(const std_data::sss_ping_side& sensor, const Eigen::MatrixXd& hits,
-                                          const Eigen::MatrixXd& hits_normals, const Eigen::Vector3d& origin,
+    ping_draping_result project_ping_side(const std_data::sss_ping& ping, const std_data::sss_ping_side& sensor,
+                                          const Eigen::MatrixXd& hits, const Eigen::MatrixXd& hits_normals, const Eigen::Vector3d& origin,
                                           int nbr_bins);
 
     //double compute_simple_sound_vel();
-    std::pair<Eigen::VectorXd, Eigen::VectorXd> get_sound_vels_below(const Eigen::Vector3d& sensor_origin);
-    Eigen::VectorXd compute_refraction_times(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P);
-    Eigen::VectorXd compute_times(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P);
+    sound_speed_layers get_sound_vels_below(const std_data::sss_ping& ping, const Eigen::Vector3d& sensor_origin);
+    Eigen::VectorXd compute_refraction_times(const sound_speed_layers& layers, const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P);
+    Eigen::VectorXd compute_times(const std_data::sss_ping& ping, const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P);
 
     std::pair<Eigen::Vector3d, Eigen::Vector3d> get_port_stbd_sensor_origins(const std_data::sss_ping& ping);
     Eigen::VectorXi compute_bin_indices(const Eigen::VectorXd& times, const std_data::sss_ping_side& ping, size_t nbr_windows);
@@ -133,14 +209,46 @@ public:
                const csv_data::csv_asvp_sound_speed::EntriesT& sound_speeds = csv_data::csv_asvp_sound_speed::EntriesT());
 
     sss_draping_result project_ping(const std_data::sss_ping& ping, int nbr_bins);
+    // computes times, bins, measured and model intensities and the per bin averages of
+    // the hits of one side in a single pass, project_ping_side wraps this
+    void drape_ping_side(const std_data::sss_ping& ping, const std_data::sss_ping_side& sensor,
+                         const Eigen::MatrixXd& hits, const Eigen::MatrixXd& hits_normals,
+                         const Eigen::Vector3d& origin, int nbr_bins,
+                         std::default_random_engine& noise_generator, side_draping_buffers& buffers) const;
+    // same as above but traces with context, which lets several threads project
+    // pings concurrently as long as each has its own tracer context
+    sss_draping_result project_ping(const std_data::sss_ping& ping, int nbr_bins, BathyTracer& context);
+    // same as project_ping but writes float32 results into left and right, reusing their buffers
+    void project_ping_compact(const std_data::sss_ping& ping, int nbr_bins,
+                              compact_ping_draping_result& left, compact_ping_draping_result& right);
+    void project_ping_compact(const std_data::sss_ping& ping, int nbr_bins, BathyTracer& context,
+                              compact_ping_draping_result& left, compact_ping_draping_result& right);
     Eigen::MatrixXd project_mbes(const Eigen::Vector3d& pos, const Eigen::Matrix3d& R, int nbr_beams, double beam_width);
     double project_altimeter(const Eigen::Vector3d& pos);
 
+    // beam directions in the sensor frame, the same fan as in project_mbes
+    static Eigen::MatrixXd mbes_beam_dirs(int nbr_beams, double beam_width);
+    // traces beam_dirs rotated by rotations[i] from positions.row(i) for all poses,
+    // spread over nbr_threads threads, or one per core if nbr_threads <= 0
+    mbes_simulation_result project_mbes_trajectory(const Eigen::MatrixXd& positions,
+                                                   const std::vector<Eigen::Matrix3d, Eigen::aligned_allocator<Eigen::Matrix3d> >& rotations,
+                                                   const Eigen::MatrixXd& beam_dirs, int nbr_threads = 0);
+    // same as above with the poses of pings, rotated by heading, pitch and roll
+    mbes_simulation_result project_mbes_pings(const std_data::mbes_ping::PingsT& pings,
+                                              const Eigen::MatrixXd& beam_dirs, int nbr_threads = 0);
+    // altimeter depths at all positions, zero where there is no hit
+    Eigen::VectorXd project_altimeters(const Eigen::MatrixXd& positions, int nbr_threads = 0);
+
     void set_sidescan_yaw(double new_sensor_yaw) { sensor_yaw = new_sensor_yaw; }
     void set_sidescan_port_stbd_offsets(const Eigen::Vector3d& new_offset_port, const Eigen::Vector3d& new_offset_stbd) { sensor_offset_port = new_offset_port; sensor_offset_stbd = new_offset_stbd; }
-    void set_tracing_map_size(double new_tracing_map_size) { tracing_map_size = new_tracing_map_size; }
+    void set_tracing_map_size(double new_tracing_map_size);
     void set_intensity_multiplier(double new_intensity_multiplier) { intensity_multiplier = new_intensity_multiplier; }
     void set_ray_tracing_enabled(bool enabled);
+    // traces on height_map instead of building a bvh, V1, F1 must be mesh_from_height_map(height_map, bounds)
+    void set_tracing_height_map(const Eigen::MatrixXd& height_map);
+    void set_nbr_sss_lines(int new_nbr_sss_lines) { nbr_sss_lines = new_nbr_sss_lines; }
+    // picks the number of rays from the sidescan slant range resolution, 0 disables
+    void set_adaptive_rays_per_sample(double new_rays_per_sample) { rays_per_sample = new_rays_per_sample; }
 
 };
 
@@ -0,0 +1,80 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BATCH_DRAPER_H
+#define BATCH_DRAPER_H
+
+#include <bathy_maps/base_draper.h>
+#include <bathy_maps/sss_map_image.h>
+#include <atomic>
+
+// drapes a whole data set of sidescan pings without a viewer. the pings are projected
+// by a pool of worker threads, each with its own tracer context on the shared mesh,
+// and fed to the MapSaver in ping order, so the result is the same as with one thread
+template <typename MapSaver>
+class BatchDraper : public BaseDraper {
+public:
+
+    using BoundsT = Eigen::Matrix2d;
+    using MapType = typename MapSaver::MapType;
+    using ProgressCallbackT = std::function<void(int, int)>; // (nbr pings done, nbr pings)
+    using PingObserverT = std::function<void(const std_data::sss_ping&, const ping_draping_result&, const ping_draping_result&)>;
+
+protected:
+
+    std_data::sss_ping::PingsT pings;
+    double resolution;
+    int nbr_threads;
+    int window_size; // max nbr of projected pings waiting for the ordered reduction
+    bool store_map_images;
+    std::atomic<bool> cancelled;
+    Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> coverage; // 1m cells with mesh vertices
+
+    std::function<void(MapType)> save_callback;
+    ProgressCallbackT progress_callback;
+    PingObserverT ping_observer;
+
+    bool is_mesh_underneath_vehicle(const Eigen::Vector3d& origin) const;
+
+public:
+
+    static void default_callback(const MapType&) {}
+
+    BatchDraper(const Eigen::MatrixXd& V1, const Eigen::MatrixXi& F1,
+                const std_data::sss_ping::PingsT& pings,
+                const BoundsT& bounds,
+                const csv_data::csv_asvp_sound_speed::EntriesT& sound_speeds = csv_data::csv_asvp_sound_speed::EntriesT());
+
+    void set_resolution(double new_resolution) { resolution = new_resolution; }
+    void set_nbr_threads(int new_nbr_threads) { nbr_threads = new_nbr_threads; }
+    void set_store_map_images(bool store) { store_map_images = store; }
+    void set_image_callback(const std::function<void(MapType)>& callback) { save_callback = callback; }
+    // called from the thread running drape after each ping has been reduced
+    void set_progress_callback(const ProgressCallbackT& callback) { progress_callback = callback; }
+    // called in ping order with the projected ping, e.g. for visualization
+    void set_ping_observer(const PingObserverT& observer) { ping_observer = observer; }
+
+    // stops a running drape as soon as possible, safe to call from any thread or from the callbacks.
+    // the images finished before cancelling are still returned
+    void cancel() { cancelled = true; }
+    bool is_cancelled() const { return cancelled; }
+
+    // drapes all pings, one image per survey line as in MapDraper
+    typename MapType::ImagesT drape();
+};
+
+sss_map_image::ImagesT batch_drape_maps(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                                        const BaseDraper::BoundsT& bounds, const std_data::sss_ping::PingsT& pings,
+                                        const csv_data::csv_asvp_sound_speed::EntriesT& sound_speeds, double sensor_yaw,
+                                        double resolution, const std::function<void(sss_map_image)>& save_callback,
+                                        int nbr_threads = 0);
+
+#endif // BATCH_DRAPER_H
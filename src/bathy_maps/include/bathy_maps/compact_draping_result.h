@@ -0,0 +1,87 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COMPACT_DRAPING_RESULT_H
+#define COMPACT_DRAPING_RESULT_H
+
+#include <bathy_maps/base_draper.h>
+#include <fstream>
+#include <string>
+
+// ping_draping_result in float32 and row major, the points are in the map local
+// frame of the draper so floats keep mm precision over several km. the buffers
+// are only grown, the first nbr_hits and nbr_bins rows are valid, so that one
+// result can be reused for all pings
+struct compact_ping_draping_result {
+
+    using PointsT = Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>;
+
+    Eigen::Vector3d sensor_origin;
+    int nbr_hits;
+    int nbr_bins;
+
+    PointsT hits_points;
+    Eigen::VectorXi hits_inds;
+    Eigen::VectorXf hits_times;
+    Eigen::VectorXf hits_intensities;
+
+    PointsT time_bin_points;
+    PointsT time_bin_normals;
+    Eigen::VectorXf time_bin_model_intensities;
+
+    compact_ping_draping_result() : sensor_origin(Eigen::Vector3d::Zero()), nbr_hits(0), nbr_bins(0) {}
+
+    void reserve(int new_nbr_hits, int new_nbr_bins);
+    void assign(const Eigen::Vector3d& origin, const Eigen::MatrixXd& hits, const side_draping_buffers& buffers);
+    void assign(const ping_draping_result& result);
+    ping_draping_result to_result() const;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+// streams port and starboard results of pings to a binary file one ping at a time,
+// without keeping them in memory or going through cereal
+class DrapingResultWriter {
+private:
+
+    std::ofstream output;
+
+    void write_side(const compact_ping_draping_result& result);
+
+public:
+
+    DrapingResultWriter(const std::string& path);
+
+    bool is_open() const { return output.is_open(); }
+    bool write(const compact_ping_draping_result& left, const compact_ping_draping_result& right);
+    void close() { output.close(); }
+};
+
+// reads the files of DrapingResultWriter one ping at a time, reusing the result buffers
+class DrapingResultReader {
+private:
+
+    std::ifstream input;
+    std::streamoff file_size; // bounds the counts read from the file
+
+    bool read_side(compact_ping_draping_result& result);
+
+public:
+
+    DrapingResultReader(const std::string& path);
+
+    bool is_open() const { return input.is_open(); }
+    // returns false at the end of the file
+    bool read(compact_ping_draping_result& left, compact_ping_draping_result& right);
+    void close() { input.close(); }
+};
+
+#endif // COMPACT_DRAPING_RESULT_H
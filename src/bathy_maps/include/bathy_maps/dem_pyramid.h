@@ -0,0 +1,60 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEM_PYRAMID_H
+#define DEM_PYRAMID_H
+
+#include <bathy_maps/sparse_raster.h>
+#include <tuple>
+
+// a pyramid of height maps built once from the finest grid, each level halving the
+// resolution of the previous one by reducing 2 x 2 cells with data to their mean, min
+// or max. the levels are sparse rasters, so they are stored tile-wise, and height maps
+// and meshes can be cut out at a given resolution without regridding the soundings
+class DemPyramid
+{
+public:
+
+    using BoundsT = Eigen::Matrix2d;
+
+    enum Reduction { MEAN, MIN, MAX };
+
+private:
+
+    Reduction reduction;
+    std::vector<SparseRaster> levels; // levels[0] is the finest
+
+    SparseRaster reduce(const SparseRaster& fine) const;
+    // the cells of a level within bounds, which are rounded outwards to whole cells
+    SparseRaster get_region(int level, const BoundsT& bounds) const;
+
+public:
+
+    // builds coarser levels until one fits in a tile, or there are max_levels levels if > 0
+    DemPyramid(const SparseRaster& height_map, Reduction reduction = MEAN, int max_levels = 0);
+    // the cells of height_map that are equal to nodata have no data
+    DemPyramid(const Eigen::MatrixXd& height_map, const BoundsT& bounds, float nodata = 0.f, Reduction reduction = MEAN, int max_levels = 0);
+
+    int nbr_levels() const { return levels.size(); }
+    const SparseRaster& get_level(int level) const { return levels[level]; }
+    double get_resolution(int level) const { return levels[level].get_resolution(); }
+    // the coarsest level with a resolution of at most res, or the finest level
+    int level_for_resolution(double res) const;
+
+    // the height map of the level for res within bounds, and the bounds of the returned
+    // cells. empty cells are nodata, by default zero as in mesh_map::height_map_from_pings
+    std::pair<Eigen::MatrixXd, BoundsT> get_height_map(const BoundsT& bounds, double res) const;
+    SparseRaster get_sparse_height_map(const BoundsT& bounds, double res) const;
+    // mesh of the cells with data of get_height_map, relative to the returned bounds
+    std::tuple<Eigen::MatrixXd, Eigen::MatrixXi, BoundsT> get_mesh(const BoundsT& bounds, double res) const;
+};
+
+#endif // DEM_PYRAMID_H
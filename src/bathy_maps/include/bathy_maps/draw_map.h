@@ -13,6 +13,7 @@
 #define DRAW_MAP_H
 
 #include <data_tools/std_data.h>
+#include <bathy_maps/sparse_raster.h>
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem.hpp>
 #undef BOOST_NO_CXX11_SCOPED_ENUMS
@@ -21,6 +22,7 @@
 class BathyMapImage {
 private:
     cv::Point2f world_pos_to_image(const Eigen::Vector3d& pos, bool relative=false);
+    void set_bounds(const Eigen::Matrix2d& bounds);
 public:
     using TargetsT = std::map<std::string, std::pair<double, double> >;
 
@@ -31,11 +33,13 @@ public:
 
     BathyMapImage(const std_data::mbes_ping::PingsT& pings, int rows=500, int cols=500);
     BathyMapImage(const Eigen::MatrixXd& height_map, const Eigen::Matrix2d& bounds);
+    BathyMapImage(const SparseRaster& height_map);
     void draw_track(const std_data::mbes_ping::PingsT& pings);
     void draw_track(const std_data::mbes_ping::PingsT& pings, const cv::Scalar& color);
     void draw_track(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& pos);
     void draw_height_map(const std_data::mbes_ping::PingsT& pings);
     void draw_height_map(const Eigen::MatrixXd& height_map);
+    void draw_height_map(const SparseRaster& height_map);
     void draw_back_scatter_map(std_data::mbes_ping::PingsT& pings);
     void draw_targets(const TargetsT& targets, const cv::Scalar& color);
     void draw_indices(std_data::mbes_ping::PingsT& pings, int skip_indices=500);
@@ -0,0 +1,123 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HEIGHT_MAP_GRIDDER_H
+#define HEIGHT_MAP_GRIDDER_H
+
+#include <data_tools/std_data.h>
+#include <bathy_maps/sparse_raster.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+
+// grids soundings into height maps with cells of size res, one batch at a time, so that
+// a survey can be streamed file by file. the cells are kept in sparse tiles of
+// tile_size x tile_size cells. a batch is first bucketed by tile in parallel, then every
+// tile is updated by a single thread in the order of the batch, so the result does not
+// depend on the number of threads. without bounds, the grid grows with the data.
+// single pings can be added as they arrive for online mapping, and the tiles changed
+// since the last clear_dirty are tracked so that consumers only refresh those
+class HeightMapGridder
+{
+public:
+
+    using BoundsT = Eigen::Matrix2d;
+    using PointsT = std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >;
+    using BoundsListT = std::vector<BoundsT, Eigen::aligned_allocator<BoundsT> >;
+
+    // the layers to accumulate, MEAN and counts are always kept
+    enum Layers { MEAN = 1, MIN = 2, MAX = 4, MEDIAN = 8, VARIANCE = 16, ALL_LAYERS = 31 };
+
+    static const int tile_size = 64;
+
+private:
+
+    struct tile
+    {
+        int row; // of the first cell in the tile
+        int col;
+        std::vector<unsigned int> counts;
+        std::vector<double> means;
+        std::vector<double> squares; // sums of squared differences from the mean
+        std::vector<float> mins;
+        std::vector<float> maxs;
+        std::vector<float> medians; // robbins-monro estimates of the medians
+    };
+
+    // the soundings of one batch chunk, bucketed by tile
+    struct tile_bucket
+    {
+        std::vector<int> cells; // index within the tile
+        std::vector<double> heights;
+    };
+    struct batch_chunk;
+
+    double res;
+    int layers;
+    int nbr_threads;
+    bool has_bounds;
+    Eigen::Vector2d origin; // corner of cell (0, 0)
+    int rows; // size of the grid if it has bounds
+    int cols;
+    int min_row; // extent of the cells with data
+    int max_row;
+    int min_col;
+    int max_col;
+    std::unordered_map<long long, std::unique_ptr<tile> > tiles;
+    std::unordered_set<long long> dirty_tiles;
+
+    // the cell of a point, returns false if it is outside the bounds
+    bool point_cell(const Eigen::Vector3d& point, int& row, int& col) const;
+    tile* get_tile(long long key, int tile_row, int tile_col);
+    void add_to_cell(tile& t, int cell, double height);
+    void add_to_tile(tile& t, const tile_bucket& bucket);
+
+    // the rows x cols cells from row0, col0 of the values value(tile, cell) of the cells with data
+    template <typename ValueFunc>
+    Eigen::MatrixXd get_cells(int row0, int col0, int rows, int cols, const ValueFunc& value) const;
+    template <typename ValueFunc>
+    Eigen::MatrixXd get_cells(const ValueFunc& value) const;
+
+    // calls for_chunk(c, chunk) for all c in [0, nbr_chunks), which should call chunk.add(point)
+    // for the points of chunk c in order, chunks are visited concurrently
+    template <typename ChunkFunc>
+    void add_batch(int nbr_chunks, const ChunkFunc& for_chunk);
+
+public:
+
+    HeightMapGridder(double res, int layers = MEAN, int nbr_threads = 0);
+    // only keeps the soundings within bounds, the max corner is rounded up to whole cells
+    HeightMapGridder(const BoundsT& bounds, double res, int layers = MEAN, int nbr_threads = 0);
+
+    void add_points(const Eigen::MatrixXd& points);
+    void add_cloud(const PointsT& cloud);
+    void add_pings(const std_data::mbes_ping::PingsT& pings);
+    // adds one ping in the calling thread, in O(beams)
+    void add_ping(const std_data::mbes_ping& ping);
+
+    double get_resolution() const { return res; }
+    BoundsT get_bounds() const;
+    int get_rows() const;
+    int get_cols() const;
+    // dense rows x cols grid of one layer over get_bounds(), empty cells are zero
+    Eigen::MatrixXd get_layer(Layers layer) const;
+    // the cells of one layer within bounds, which are rounded outwards to whole cells
+    Eigen::MatrixXd get_layer(Layers layer, const BoundsT& bounds) const;
+    Eigen::MatrixXd get_counts() const;
+    // one layer over get_bounds(), only allocating the tiles with data
+    SparseRaster get_sparse_layer(Layers layer) const;
+
+    // the bounds of the tiles changed since the last clear_dirty
+    BoundsListT get_dirty_bounds() const;
+    void clear_dirty() { dirty_tiles.clear(); }
+};
+
+#endif // HEIGHT_MAP_GRIDDER_H
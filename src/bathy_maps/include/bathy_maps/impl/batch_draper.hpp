@@ -0,0 +1,190 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/batch_draper.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+using namespace csv_data;
+
+template <typename MapSaver>
+BatchDraper<MapSaver>::BatchDraper(const Eigen::MatrixXd& V1, const Eigen::MatrixXi& F1,
+                                   const std_data::sss_ping::PingsT& pings,
+                                   const BoundsT& bounds,
+                                   const csv_asvp_sound_speed::EntriesT& sound_speeds)
+    : BaseDraper(V1, F1, bounds, sound_speeds), pings(pings),
+      resolution(30./8.), nbr_threads(0), window_size(256), store_map_images(true), cancelled(false),
+      save_callback(&default_callback)
+{
+    // same coverage test as the texture of ViewDraper, with a resolution of 1m
+    int rows = int(bounds(1, 1)-bounds(0, 1));
+    int cols = int(bounds(1, 0)-bounds(0, 0));
+    coverage = Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic>::Constant(rows, cols, false);
+    for (int j = 0; j < V1.rows(); ++j) {
+        int y = int(V1(j, 1));
+        int x = int(V1(j, 0));
+        if (x >= 0 && x < cols && y >= 0 && y < rows && V1(j, 2) != 0.) {
+            coverage(y, x) = true;
+        }
+    }
+}
+
+template <typename MapSaver>
+bool BatchDraper<MapSaver>::is_mesh_underneath_vehicle(const Eigen::Vector3d& origin) const
+{
+    int y = int(origin(1));
+    int x = int(origin(0));
+    if (x >= 0 && x < coverage.cols() && y >= 0 && y < coverage.rows()) {
+        return coverage(y, x);
+    }
+    return false;
+}
+
+template <typename MapSaver>
+typename BatchDraper<MapSaver>::MapType::ImagesT BatchDraper<MapSaver>::drape()
+{
+    struct projected_ping {
+        bool ready;
+        bool skipped;
+        ping_draping_result left;
+        ping_draping_result right;
+        projected_ping() : ready(false), skipped(true) {}
+    };
+
+    cancelled = false;
+
+    typename MapType::ImagesT map_images;
+    MapSaver map_image_builder(bounds, resolution, 256);
+    const int nbr_bins = map_image_builder.get_waterfall_bins();
+    const int nbr_pings = pings.size();
+
+    int nbr_workers = nbr_threads > 0? nbr_threads : max(int(thread::hardware_concurrency()), 1);
+    const int nbr_slots = max(window_size, nbr_workers);
+
+    // the workers project pings ahead of the reduction by at most nbr_slots pings
+    vector<projected_ping, Eigen::aligned_allocator<projected_ping> > slots(nbr_slots);
+    mutex slots_mutex;
+    condition_variable ready_cond; // a slot has been filled, or a worker stopped
+    condition_variable space_cond; // a slot has been reduced, or we are cancelled
+    int next = 0; // next ping to project
+    int reduced = 0; // next ping to reduce
+
+    BathyTracer shared_context = make_tracer_context();
+
+    auto worker = [&]() {
+        BathyTracer context = shared_context; // shares the scene, but not the query state
+        while (true) {
+            int i;
+            {
+                unique_lock<mutex> lock(slots_mutex);
+                space_cond.wait(lock, [&] { return cancelled || next >= nbr_pings || next < reduced + nbr_slots; });
+                if (cancelled || next >= nbr_pings) {
+                    break;
+                }
+                i = next++;
+            }
+
+            projected_ping result;
+            result.ready = true;
+            result.skipped = !is_mesh_underneath_vehicle(pings[i].pos_ - offset);
+            if (!result.skipped) {
+                tie(result.left, result.right) = project_ping(pings[i], nbr_bins, context);
+            }
+
+            {
+                lock_guard<mutex> lock(slots_mutex);
+                slots[i % nbr_slots] = std::move(result);
+            }
+            ready_cond.notify_all();
+        }
+        {
+            lock_guard<mutex> lock(slots_mutex);
+        }
+        ready_cond.notify_all();
+    };
+
+    auto finish_image = [&]() {
+        MapType map_image = map_image_builder.finish();
+        save_callback(map_image);
+        if (store_map_images) {
+            map_images.push_back(map_image);
+        }
+        map_image_builder = MapSaver(bounds, resolution, 256);
+    };
+
+    vector<thread> threads;
+    for (int j = 0; j < min(nbr_workers, max(nbr_pings, 1)); ++j) {
+        threads.emplace_back(worker);
+    }
+
+    while (reduced < nbr_pings) {
+        projected_ping result;
+        int i;
+        {
+            unique_lock<mutex> lock(slots_mutex);
+            ready_cond.wait(lock, [&] { return cancelled || slots[reduced % nbr_slots].ready; });
+            if (cancelled) {
+                break;
+            }
+            result = std::move(slots[reduced % nbr_slots]);
+            slots[reduced % nbr_slots].ready = false;
+            i = reduced++;
+        }
+        space_cond.notify_all();
+
+        // split off a new image at the start of each survey line
+        if (pings[i].first_in_file_ && !map_image_builder.empty()) {
+            finish_image();
+        }
+
+        if (!result.skipped) {
+            Eigen::Vector3d pos = pings[i].pos_ - offset;
+            Eigen::Vector3d rpy(pings[i].roll_, pings[i].pitch_, pings[i].heading_);
+
+            // we need these checks since time_bin_points.col(2) might not exist
+            if (result.left.hits_points.rows() > 0) {
+                map_image_builder.add_hits(result.left.hits_points, result.left.hits_inds, result.left.hits_intensities,
+                                           result.left.time_bin_points.col(2), result.left.time_bin_model_intensities,
+                                           pings[i].port, pos, rpy, true);
+            }
+            if (result.right.hits_points.rows() > 0) {
+                map_image_builder.add_hits(result.right.hits_points, result.right.hits_inds, result.right.hits_intensities,
+                                           result.right.time_bin_points.col(2), result.right.time_bin_model_intensities,
+                                           pings[i].stbd, pos, rpy, false);
+            }
+            if (ping_observer) {
+                ping_observer(pings[i], result.left, result.right);
+            }
+        }
+
+        if (progress_callback) {
+            progress_callback(i + 1, nbr_pings);
+        }
+    }
+
+    // wake up the workers waiting for space if we were cancelled
+    {
+        lock_guard<mutex> lock(slots_mutex);
+    }
+    space_cond.notify_all();
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    if (!cancelled && !map_image_builder.empty()) {
+        finish_image();
+    }
+
+    return map_images;
+}
@@ -13,14 +13,26 @@
 #define MESH_MAP_H
 
 #include <Eigen/Dense>
+#include <cstdint>
 #include <data_tools/std_data.h>
 #include <data_tools/xtf_data.h>
+#include <bathy_maps/sparse_raster.h>
 
 namespace mesh_map {
 
     using BoundsT = Eigen::Matrix2d;
+    // row-major float32 and int32 buffers, laid out as the embree vertex and index buffers
+    using VerticesfT = Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>;
+    using FacesiT = Eigen::Matrix<int32_t, Eigen::Dynamic, 3, Eigen::RowMajor>;
 
     std::pair<Eigen::MatrixXd, Eigen::MatrixXi> mesh_from_height_map(const Eigen::MatrixXd& height_map, const BoundsT& bounds);
+    // same faces in the same order as mesh_from_height_map, so the face indices of a
+    // HeightFieldScene still apply, but only the vertices used by faces are kept. the
+    // rows are meshed in parallel directly into buffers of the exact size
+    std::pair<Eigen::MatrixXd, Eigen::MatrixXi> compact_mesh_from_height_map(const Eigen::MatrixXd& height_map, const BoundsT& bounds, int nbr_threads=0);
+    std::pair<VerticesfT, FacesiT> compact_float_mesh_from_height_map(const Eigen::MatrixXd& height_map, const BoundsT& bounds, int nbr_threads=0);
+    // only the cells with data get vertices, in the order of the tiles
+    std::pair<Eigen::MatrixXd, Eigen::MatrixXi> mesh_from_height_map(const SparseRaster& height_map);
     std::pair<Eigen::MatrixXd, BoundsT> height_map_from_pings(const std_data::mbes_ping::PingsT& pings, double res);
     std::pair<Eigen::MatrixXd, BoundsT> height_map_from_cloud(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& cloud, double res);
     std::pair<Eigen::MatrixXd, BoundsT> height_map_from_dtm_cloud(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& cloud, double res);
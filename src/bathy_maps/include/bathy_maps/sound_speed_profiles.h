@@ -0,0 +1,66 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOUND_SPEED_PROFILES_H
+#define SOUND_SPEED_PROFILES_H
+
+#include <data_tools/csv_data.h>
+#include <data_tools/std_data.h>
+
+// the sound speed layers below a sensor, in the format of trace_multiple_layers
+// but with heights in the world frame instead of relative to the sensor.
+// the vectors point into the SoundSpeedProfiles and are valid as long as it is
+struct sound_speed_layers
+{
+    Eigen::Map<const Eigen::VectorXd> speeds;
+    Eigen::Map<const Eigen::VectorXd> heights;
+    double harmonic_mean_speed;
+
+    sound_speed_layers(const double* speeds, const double* heights, int nbr_layers, double harmonic_mean_speed)
+        : speeds(speeds, nbr_layers), heights(heights, nbr_layers), harmonic_mean_speed(harmonic_mean_speed) {}
+};
+
+// index of all sound speed casts of a mission. the cast used for a ping is the one
+// closest in time and position. the harmonic mean speeds below every sample are
+// computed once per cast, so lookups are a binary search without allocations
+class SoundSpeedProfiles
+{
+private:
+
+    struct profile
+    {
+        long long time_stamp;
+        double lat;
+        double lon;
+        Eigen::VectorXd heights; // decreasing heights of the speed samples
+        Eigen::VectorXd speeds;
+        Eigen::VectorXd harmonic_means; // harmonic_means(i) is the harmonic mean of speeds from i and down
+    };
+
+    std::vector<profile> profiles; // sorted by time
+    double time_scale; // in milliseconds, weighs time against distance
+    double distance_scale; // in meters
+
+    double profile_cost(const profile& p, long long time_stamp, double lat, double lon) const;
+
+public:
+
+    // a time difference of time_scale seconds counts as much as a distance of distance_scale meters
+    SoundSpeedProfiles(const csv_data::csv_asvp_sound_speed::EntriesT& casts,
+                       double time_scale = 3600., double distance_scale = 1000.);
+
+    int nbr_profiles() const { return profiles.size(); }
+    int select_profile(long long time_stamp, double lat, double lon) const;
+    sound_speed_layers layers_below(int profile_index, double sensor_height) const;
+    sound_speed_layers layers_below(const std_data::sss_ping& ping, double sensor_height) const;
+};
+
+#endif // SOUND_SPEED_PROFILES_H
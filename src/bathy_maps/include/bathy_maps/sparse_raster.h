@@ -0,0 +1,103 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SPARSE_RASTER_H
+#define SPARSE_RASTER_H
+
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+// a rows x cols raster of ValueT over bounds, stored in tiles of tile_size x tile_size cells
+// that are only allocated when first written. every cell has a nodata flag, so zero is a
+// valid value, and the cells that were never written are returned as the nodata value.
+// the tiles can be accessed as row-major eigen maps, tiles at the edges extend past the
+// raster but their outside cells are never valid. instantiated for float and double
+template <typename ValueT>
+class SparseRasterT
+{
+public:
+
+    using BoundsT = Eigen::Matrix2d;
+    using TileValuesT = Eigen::Map<Eigen::Matrix<ValueT, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> >;
+    using ConstTileValuesT = Eigen::Map<const Eigen::Matrix<ValueT, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> >;
+    using TileMaskT = Eigen::Map<Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> >;
+    using ConstTileMaskT = Eigen::Map<const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> >;
+
+    static const int tile_size = 64;
+
+private:
+
+    struct tile
+    {
+        std::vector<ValueT> values;
+        std::vector<unsigned char> mask; // 1 for cells with data
+    };
+
+    int rows;
+    int cols;
+    BoundsT bounds;
+    ValueT nodata;
+    int tile_rows;
+    int tile_cols;
+    std::vector<std::unique_ptr<tile> > tiles; // tile_rows x tile_cols, null if not allocated
+
+    tile& get_tile(int row, int col);
+    // the tile containing cell row, col, null if it is not allocated
+    const tile* find_tile(int row, int col) const;
+
+public:
+
+    SparseRasterT(int rows, int cols, const BoundsT& bounds, ValueT nodata = 0);
+    // copies the allocated tiles
+    SparseRasterT(const SparseRasterT& other);
+    SparseRasterT& operator=(const SparseRasterT& other);
+    SparseRasterT(SparseRasterT&& other) = default;
+    SparseRasterT& operator=(SparseRasterT&& other) = default;
+
+    // the cells that are not equal to nodata are copied
+    static SparseRasterT from_dense(const Eigen::MatrixXd& dense, const BoundsT& bounds, ValueT nodata = 0);
+    // rows x cols grid, the cells without data are nodata
+    Eigen::MatrixXd to_dense() const;
+
+    int get_rows() const { return rows; }
+    int get_cols() const { return cols; }
+    const BoundsT& get_bounds() const { return bounds; }
+    ValueT get_nodata() const { return nodata; }
+    // size of a cell along x and y
+    double get_resolution() const { return (bounds(1, 0) - bounds(0, 0))/double(cols); }
+
+    bool is_valid(int row, int col) const;
+    // nodata if the cell has no data
+    ValueT get(int row, int col) const;
+    void set(int row, int col, ValueT value);
+    // adds to the value of a cell, which starts at zero
+    void add(int row, int col, ValueT value);
+
+    // the first row and col of the allocated tiles, in row-major order
+    std::vector<std::pair<int, int> > get_tiles() const;
+    int nbr_tiles() const;
+    size_t memory_bytes() const;
+    bool empty() const { return nbr_tiles() == 0; }
+
+    // views of the tile containing cell row, col, which must be within the raster. the
+    // non-const versions allocate the tile, the const versions may only be called for the tiles from get_tiles()
+    TileValuesT tile_values(int row, int col);
+    ConstTileValuesT tile_values(int row, int col) const;
+    TileMaskT tile_mask(int row, int col);
+    ConstTileMaskT tile_mask(int row, int col) const;
+};
+
+using SparseRaster = SparseRasterT<float>;
+// for sums and other accumulations that need the precision
+using SparseRasterd = SparseRasterT<double>;
+
+#endif // SPARSE_RASTER_H
@@ -18,6 +18,7 @@
 #include <cereal/types/vector.hpp>
 
 #include <bathy_maps/patch_views.h>
+#include <bathy_maps/sparse_raster.h>
 #include <data_tools/std_data.h>
 
 struct sss_map_image {
@@ -63,8 +64,10 @@ private:
     int image_rows;
     int image_cols;
 
-    Eigen::MatrixXd sss_map_image_sums;
-    Eigen::MatrixXd sss_map_image_counts;
+    // sparse since the swaths only cover a small part of the bounds,
+    // in double like the dense sums so that long surveys do not lose precision
+    SparseRasterd sss_map_image_sums;
+    SparseRasterd sss_map_image_counts;
 
     int waterfall_width;
     int waterfall_counter;
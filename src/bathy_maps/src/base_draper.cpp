@@ -10,11 +10,13 @@
  */
 
 #include <bathy_maps/base_draper.h>
+#include <bathy_maps/compact_draping_result.h>
 
 #include <igl/per_face_normals.h>
 #include <bathy_maps/mesh_map.h>
 #include <sonar_tracing/snell_ray_tracing.h>
 #include <chrono>
+#include <cmath>
 
 using namespace std;
 using namespace xtf_data;
@@ -24,14 +26,32 @@ BaseDraper::BaseDraper(const Eigen::MatrixXd& V1, const Eigen::MatrixXi& F1,
                        const BoundsT& bounds,
                        const csv_asvp_sound_speed::EntriesT& sound_speeds)
     : V1(V1), F1(F1),
-      sound_speeds(sound_speeds), bounds(bounds),
+      bounds(bounds), sound_speeds(sound_speeds), sound_speed_profiles(sound_speeds),
       sensor_yaw(0.), ray_tracing_enabled(false),
-      tracing_map_size(200.), intensity_multiplier(1.)
+      tracing_map_size(200.), intensity_multiplier(1.),
+      beam_fans(make_shared<sss_beam_fan_cache>()), nbr_sss_lines(500), rays_per_sample(0.)
 {
     offset = Eigen::Vector3d(bounds(0, 0), bounds(0, 1), 0.);
     sensor_offset_port = Eigen::Vector3d::Zero();
     sensor_offset_stbd = Eigen::Vector3d::Zero();
     igl::per_face_normals(V1, F1, N1); // compute normals for mesh 
+    set_tracing_map_size(tracing_map_size);
+    tracer.set_mesh(V1, F1);
+}
+
+void BaseDraper::set_tracing_map_size(double new_tracing_map_size)
+{
+    tracing_map_size = new_tracing_map_size;
+    double floor_height = V1.rows() > 0? V1.col(2).minCoeff() : 0.;
+    travel_time_tables = make_shared<TravelTimeTableCache>(tracing_map_size, floor_height);
+}
+
+void BaseDraper::set_tracing_height_map(const Eigen::MatrixXd& height_map)
+{
+    // same resolution as in mesh_from_height_map
+    double res = (bounds(1, 0) - bounds(0, 0))/double(height_map.cols());
+    tracer.set_height_field(HeightFieldScene::create(height_map, res));
+    tracer.set_scene(BathyScene::Ptr()); // only the height field is traced now
 }
 
 void BaseDraper::set_ray_tracing_enabled(bool enabled)
@@ -49,30 +69,114 @@ pair<Eigen::Vector3d, Eigen::Vector3d> BaseDraper::get_port_stbd_sensor_origins(
     return make_pair(origin_port, origin_stbd);
 }
 
-pair<Eigen::MatrixXd, Eigen::MatrixXd> BaseDraper::compute_sss_dirs(const Eigen::Matrix3d& R, double tilt_angle, double beam_width, int nbr_lines)
+BathyTracer BaseDraper::make_tracer_context() const
+{
+    BathyTracer context;
+    context.set_height_field(tracer.get_height_field());
+    context.set_mesh(V1, F1);
+    return context;
+}
+
+sss_beam_fan_cache::FanPtr sss_beam_fan_cache::get_fan(double tilt_angle, double beam_width, int nbr_lines)
 {
-    const double min_theta = tilt_angle - 0.5*beam_width; // M_PI/180.*10.;
-    const double max_theta = tilt_angle + 0.5*beam_width; //M_PI/180.*60.;
+    // the quantized keys are only defined for finite angles
+    if (!std::isfinite(tilt_angle) || !std::isfinite(beam_width) || nbr_lines < 2) {
+        return FanPtr();
+    }
+    int tilt_index = int(round(tilt_angle/angle_step));
+    int width_index = int(round(beam_width/angle_step));
+    auto key = make_tuple(tilt_index, width_index, nbr_lines);
+
+    lock_guard<mutex> lock(fans_mutex);
+    auto iter = fans.find(key);
+    if (iter != fans.end()) {
+        return iter->second;
+    }
+
+    // the lines are evenly spaced in slant range, i.e. in 1/cos of the angle
+    const double min_theta = double(tilt_index - width_index/2.)*angle_step;
+    const double max_theta = double(tilt_index + width_index/2.)*angle_step;
 
     double min_c = 1./cos(min_theta);
     double max_c = 1./cos(max_theta);
     double step = (max_c - min_c)/double(nbr_lines-1);
 
-    Eigen::MatrixXd dirs_left(nbr_lines, 3);
-    Eigen::MatrixXd dirs_right(nbr_lines, 3);
+    Eigen::VectorXd slopes(nbr_lines);
     for (int i = 0; i < nbr_lines; ++i) {
         double ci = min_c + double(i)*step;
-        double bi = sqrt(ci*ci-1.);
-        Eigen::Vector3d dir_left(0., bi, -1.);
-        Eigen::Vector3d dir_right(0., -bi, -1.);
-        dirs_left.row(i) = (R*dir_left).transpose();
-        dirs_right.row(i) = (R*dir_right).transpose();
+        slopes(i) = sqrt(ci*ci-1.);
+    }
+
+    if (fans.size() > 4096) {
+        fans.clear();
     }
+    FanPtr fan = make_shared<const Eigen::VectorXd>(slopes);
+    fans[key] = fan;
+    return fan;
+}
 
+pair<Eigen::MatrixXd, Eigen::MatrixXd> BaseDraper::compute_sss_dirs(const Eigen::Matrix3d& R, double tilt_angle, double beam_width, int nbr_lines)
+{
+    Eigen::MatrixXd dirs_left;
+    Eigen::MatrixXd dirs_right;
+    compute_sss_dirs(R, tilt_angle, beam_width, nbr_lines, dirs_left, dirs_right);
     return make_pair(dirs_left, dirs_right);
 }
 
+void BaseDraper::compute_sss_dirs(const Eigen::Matrix3d& R, double tilt_angle, double beam_width, int nbr_lines,
+                                  Eigen::MatrixXd& dirs_left, Eigen::MatrixXd& dirs_right)
+{
+    sss_beam_fan_cache::FanPtr fan = beam_fans->get_fan(tilt_angle, beam_width, nbr_lines);
+    if (!fan) {
+        dirs_left.resize(0, 3);
+        dirs_right.resize(0, 3);
+        return;
+    }
+
+    // R*(0, +-slope, -1) for all lines, one column at a time
+    dirs_left.resize(nbr_lines, 3);
+    dirs_right.resize(nbr_lines, 3);
+    for (int k = 0; k < 3; ++k) {
+        dirs_left.col(k) = R(k, 1)*(*fan);
+        dirs_right.col(k) = -dirs_left.col(k);
+        dirs_left.col(k).array() -= R(k, 2);
+        dirs_right.col(k).array() -= R(k, 2);
+    }
+}
+
+int BaseDraper::compute_nbr_sss_lines(const std_data::sss_ping& ping, double altitude, double tilt_angle,
+                                      double beam_width, double sound_speed)
+{
+    if (rays_per_sample <= 0.) {
+        return nbr_sss_lines;
+    }
+
+    // the lines are evenly spaced in slant range, aim for rays_per_sample per sample
+    int nbr_samples = max(ping.port.pings.size(), ping.stbd.pings.size());
+    double time_duration = max(ping.port.time_duration, ping.stbd.time_duration);
+    if (nbr_samples == 0 || time_duration <= 0.) {
+        return nbr_sss_lines;
+    }
+    double sample_range = .5*sound_speed*time_duration/double(nbr_samples);
+    double min_theta = tilt_angle - 0.5*beam_width;
+    double max_theta = tilt_angle + 0.5*beam_width;
+    double slant_span = altitude*(1./cos(max_theta) - 1./cos(min_theta));
+    if (!std::isfinite(slant_span)) {
+        return nbr_sss_lines;
+    }
+
+    // round up to whole packets of the tracer
+    int nbr_lines = int(ceil(rays_per_sample*slant_span/sample_range)) + 1;
+    nbr_lines = 8*((nbr_lines + 7)/8);
+    return min(max(nbr_lines, 16), 8192);
+}
+
 tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> BaseDraper::project(const std_data::sss_ping& ping)
+{
+    return project(ping, tracer);
+}
+
+tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> BaseDraper::project(const std_data::sss_ping& ping, BathyTracer& context)
 {
     if (DEBUG_OUTPUT) cout << "Setting new position: " << ping.pos_.transpose() << endl;
     Eigen::Matrix3d Rcomp = Eigen::AngleAxisd(sensor_yaw, Eigen::Vector3d::UnitZ()).matrix();
@@ -88,13 +192,16 @@ tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> BaseDr
 
     // all of this is for adaptively determining the beam_width and tilt_angle for a certain depth
     auto start = chrono::high_resolution_clock::now();
-    double depth = .8*tracer.depth_mesh_underneath_vehicle(offset_pos, V1, F1); // make it slightly wider
+    double depth = .8*context.depth_mesh_underneath_vehicle(offset_pos, V1, F1); // make it slightly wider
     if (depth == 0.) {
         return make_tuple(hits_left, hits_right, normals_left, normals_right);
     }
-    Eigen::VectorXd speeds, depths;
-    tie(speeds, depths) = get_sound_vels_below(offset_pos);
-    double max_distance = .5*speeds.mean()*ping.port.time_duration;
+    sound_speed_layers layers = get_sound_vels_below(ping, offset_pos);
+    double max_distance = .5*layers.harmonic_mean_speed*ping.port.time_duration;
+    if (!(depth < max_distance)) {
+        // the seafloor is out of range, acos below would not be defined
+        return make_tuple(hits_left, hits_right, normals_left, normals_right);
+    }
     double beam_width = acos(depth/max_distance);
     double tilt_angle = beam_width/2.;
     auto stop = chrono::high_resolution_clock::now();
@@ -105,12 +212,13 @@ tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> BaseDr
     Eigen::Vector3d origin_stbd;
     tie(origin_port, origin_stbd) = get_port_stbd_sensor_origins(ping);
 
-    Eigen::MatrixXd dirs_left;
-    Eigen::MatrixXd dirs_right;
-    tie(dirs_left, dirs_right) = compute_sss_dirs(R, tilt_angle, beam_width, 500);
+    // the directions are written to the buffers of the context, which trace_side does not touch
+    ray_buffers& buffers = context.buffers;
+    int nbr_lines = compute_nbr_sss_lines(ping, depth/.8, tilt_angle, beam_width, layers.harmonic_mean_speed);
+    compute_sss_dirs(R, tilt_angle, beam_width, nbr_lines, buffers.dirs_left, buffers.dirs_right);
 
-    tie(hits_left, normals_left) = trace_side(ping.port, origin_port, dirs_left);
-    tie(hits_right, normals_right) = trace_side(ping.stbd, origin_stbd, dirs_right);
+    tie(hits_left, normals_left) = trace_side(ping.port, origin_port, buffers.dirs_left, context);
+    tie(hits_right, normals_right) = trace_side(ping.stbd, origin_stbd, buffers.dirs_right, context);
 
     return make_tuple(hits_left, hits_right, normals_left, normals_right);
 }
@@ -118,22 +226,23 @@ tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> BaseDr
 // New style functions follow here:
 tuple<Eigen::MatrixXd, Eigen::MatrixXd> BaseDraper::trace_side(const std_data::sss_ping_side& ping,
                                                                const Eigen::Vector3d& sensor_origin,
-                                                               const Eigen::MatrixXd& dirs)
+                                                               const Eigen::MatrixXd& dirs,
+                                                               BathyTracer& context)
 {
-    Eigen::MatrixXd hits;
-    Eigen::VectorXi hits_inds;
-    Eigen::MatrixXd normals;
+    // the hit buffers of the context are only grown, the results are copied out of them
+    ray_buffers& buffers = context.buffers;
 
     auto start = chrono::high_resolution_clock::now();
     
-    tie(hits, hits_inds) = tracer.compute_hits(sensor_origin, dirs, V1, F1);
+    int hit_count = context.compute_hits(sensor_origin, dirs, V1, F1, buffers.hits, buffers.hits_inds, buffers.hits_dists);
+    Eigen::MatrixXd hits = buffers.hits.topRows(hit_count);
     auto stop = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
     if (DEBUG_OUTPUT) cout << "embree_compute_hits full time: " << duration.count() << " microseconds" << endl;
     
-    normals.resize(hits.rows(), 3);
-    for (int j = 0; j < hits.rows(); ++j) {
-        normals.row(j) = N1.row(hits_inds(j));
+    Eigen::MatrixXd normals(hit_count, 3);
+    for (int j = 0; j < hit_count; ++j) {
+        normals.row(j) = N1.row(buffers.hits_inds(j));
     }
 
     return make_tuple(hits, normals);
@@ -147,66 +256,30 @@ double BaseDraper::compute_simple_sound_vel()
 }
 */
 
-pair<Eigen::VectorXd, Eigen::VectorXd> BaseDraper::get_sound_vels_below(const Eigen::Vector3d& sensor_origin)
+sound_speed_layers BaseDraper::get_sound_vels_below(const std_data::sss_ping& ping, const Eigen::Vector3d& sensor_origin)
 {
-    int i;
-    int nbr_speeds = sound_speeds[0].dbars.rows();
-    for (i = 0; i < nbr_speeds; ++i) {
-        if (-sound_speeds[0].dbars[i] < sensor_origin(2)) {
-            if (DEBUG_OUTPUT) cout << "Breaking at " << -sound_speeds[0].dbars[i] << ", which is below " << sensor_origin(2) << endl;
-            break;
-        }
-    }
-
-    if (i >= nbr_speeds) {
-        return make_pair(sound_speeds[0].vels.tail(1), (sensor_origin(2)-1.)*Eigen::VectorXd::Ones(1));
-    }
-
-    return make_pair(sound_speeds[0].vels.tail(nbr_speeds-i), -sound_speeds[0].dbars.tail(nbr_speeds-i));
+    return sound_speed_profiles.layers_below(ping, sensor_origin(2));
 }
 
-Eigen::VectorXd BaseDraper::compute_times(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P)
+Eigen::VectorXd BaseDraper::compute_times(const std_data::sss_ping& ping, const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P)
 {
+    sound_speed_layers layers = get_sound_vels_below(ping, sensor_origin);
     if (ray_tracing_enabled) {
-        return compute_refraction_times(sensor_origin, P);
+        return compute_refraction_times(layers, sensor_origin, P);
     }
 
-    Eigen::VectorXd speeds, depths;
-    tie(speeds, depths) = get_sound_vels_below(sensor_origin);
-    //double sound_vel = compute_simple_sound_vel();
-    Eigen::VectorXd times = 2.*(P.rowwise() - sensor_origin.transpose()).rowwise().norm()/speeds.mean();
+    Eigen::VectorXd times = 2./layers.harmonic_mean_speed*(P.rowwise() - sensor_origin.transpose()).rowwise().norm();
     return times;
 }
 
-Eigen::VectorXd BaseDraper::compute_refraction_times(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P)
+Eigen::VectorXd BaseDraper::compute_refraction_times(const sound_speed_layers& layers, const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P)
 {
-    static bool is_left = true;
+    if (DEBUG_OUTPUT) cout << "Number of layers: " << layers.speeds.rows() << endl;
 
-    /*
-    Eigen::VectorXd layer_depths = -sound_speeds[0].dbars.segment(1, sound_speeds[0].dbars.rows()-2);
-    Eigen::VectorXd layer_speeds = sound_speeds[0].vels.head(sound_speeds[0].vels.rows()-1);
-    */
-    Eigen::VectorXd layer_speeds, layer_depths;
-    tie(layer_speeds, layer_depths) = get_sound_vels_below(sensor_origin);
-    layer_depths.array() -= sensor_origin(2); // refraction assumes sensor z=0
-
-    if (DEBUG_OUTPUT) cout << "Number of depths: " << layer_depths.rows() << ", number of speeds: " << layer_speeds.rows() << endl;
-
-    Eigen::VectorXd x = (P.leftCols<2>().rowwise() - sensor_origin.head<2>().transpose()).rowwise().norm();
-    Eigen::MatrixXd end_points(x.rows(), 2);
-    end_points.col(0) = x;
-    end_points.col(1) = P.col(2).array() - sensor_origin(2); // refraction assumes sensor z=0
-
-    Eigen::MatrixXd layer_widths;
-    Eigen::VectorXd times;
-    tie(times, layer_widths) = trace_multiple_layers(layer_depths, layer_speeds, end_points);
-    times.array() *= 2.; // back and forth
+    // tables are shared between pings with the same profile and similar sensor depth
+    Eigen::VectorXd times = travel_time_tables->compute_times(layers.heights, layers.speeds, sensor_origin, P);
     if (DEBUG_OUTPUT) cout << "Got final times: " << times.transpose() << endl;
 
-    visualize_rays(end_points, layer_depths, layer_widths, -25., false, is_left);
-
-    is_left = !is_left;
-
     return times;
 }
 
@@ -300,29 +373,44 @@ Eigen::VectorXd BaseDraper::compute_lambert_intensities(const Eigen::MatrixXd& h
     return intensities;
 }
 
+namespace {
+
+const double model_alpha = 0.5;
+const double model_sigma_theta = 0.3;
+
+// intensity model of one hit, noise is drawn from N(1, model_sigma_theta)
+inline double model_intensity(double dist, double theta, double noise)
+{
+    //double TL = 20.*log10(dist); //1./(dist*dist);
+    double DL = cos(theta);
+    double G = std::min(1., 2.*DL*DL);
+    double SL = G/DL*exp(-theta*theta/(2.*model_sigma_theta*model_sigma_theta));
+    double SS = 10.*log10((1. - model_alpha)*DL + model_alpha*SL);
+    double NL = 10.*log10(noise);
+    //intensity = 1./(-25.+42.)*(42. + SS - TL + NL); // log(1.+1.73*200.*TL*SS*NL);
+    double intensity = 1./(10.)*(9. + SS + NL); // log(1.+1.73*200.*TL*SS*NL);
+    return std::min(std::max(intensity, 0.), 1.);
+}
+
+// seeds the noise of one ping side through seed_seq, which spreads the time stamp
+// and side over the engine state, so the port and stbd streams are uncorrelated
+std::default_random_engine side_noise_generator(long long time_stamp, bool is_port)
+{
+    unsigned long long ts = time_stamp;
+    std::seed_seq seeds{ (unsigned)(ts & 0xffffffffULL), (unsigned)(ts >> 32), (unsigned)is_port };
+    return std::default_random_engine(seeds);
+}
+
+} // namespace
+
 Eigen::VectorXd BaseDraper::compute_model_intensities(const Eigen::VectorXd& dists, const Eigen::VectorXd& thetas)
 {
     Eigen::VectorXd intensities(dists.rows());
 
-    double alpha = 0.5;
-    double sigma_theta = 0.3;
-
-    std::normal_distribution<double> noise_dist(1., sigma_theta);
+    std::normal_distribution<double> noise_dist(1., model_sigma_theta);
 
     for (int j = 0; j < dists.rows(); ++j) { 
-        double dist = dists(j);
-        double theta = thetas(j);
-        double TL = 20.*log10(dist); //1./(dist*dist);
-        double DL = cos(theta);
-        double G = std::min(1., 2.*DL*DL);
-        double SL = G/DL*exp(-theta*theta/(2.*sigma_theta*sigma_theta));
-        double SS = 10.*log10((1. - alpha)*DL + alpha*SL);
-        double NL = 10.*log10(noise_dist(generator));
-        //intensities(j) = 1./(-25.+42.)*(42. + SS - TL + NL); // log(1.+1.73*200.*TL*SS*NL);
-        intensities(j) = 1./(10.)*(9. + SS + NL); // log(1.+1.73*200.*TL*SS*NL);
-        intensities(j) = std::min(std::max(intensities(j), 0.), 1.);
-        //intensities(j) = DL*DL;
-        //10*log(1.73*200.)-log(TL)+log(SS)+NL
+        intensities(j) = model_intensity(dists(j), thetas(j), noise_dist(generator));
     }
 
     return intensities;
@@ -353,30 +441,112 @@ double BaseDraper::project_altimeter(const Eigen::Vector3d& pos)
     return tracer.depth_mesh_underneath_vehicle(pos - offset, V1, F1);
 }
 
-Eigen::MatrixXd BaseDraper::project_mbes(const Eigen::Vector3d& pos, const Eigen::Matrix3d& R, int nbr_beams, double beam_width)
+Eigen::MatrixXd BaseDraper::mbes_beam_dirs(int nbr_beams, double beam_width)
 {
-    Eigen::MatrixXd hits;
-    Eigen::VectorXi hits_inds;
     Eigen::MatrixXd dirs(nbr_beams, 3);
     for (int i = 0; i < nbr_beams; ++i) {
         double angle = double(nbr_beams/2-i-1)/double(nbr_beams)*beam_width;
         dirs.row(i) = Eigen::RowVector3d(0., sin(angle), -cos(angle));
-        //dirs.row(i) = Eigen::RowVector3d(0., 0., -1.);
     }
-    dirs = dirs*R.transpose();
+    return dirs;
+}
+
+Eigen::MatrixXd BaseDraper::project_mbes(const Eigen::Vector3d& pos, const Eigen::Matrix3d& R, int nbr_beams, double beam_width)
+{
+    Eigen::MatrixXd hits;
+    Eigen::VectorXi hits_inds;
+    Eigen::MatrixXd dirs(nbr_beams, 3);
+    dirs.noalias() = mbes_beam_dirs(nbr_beams, beam_width)*R.transpose();
     tie(hits, hits_inds) = tracer.compute_hits(pos - offset, dirs, V1, F1);
     hits.array().rowwise() += offset.array().transpose();
     return hits;
 }
 
+mbes_simulation_result BaseDraper::project_mbes_trajectory(const Eigen::MatrixXd& positions,
+                                                           const vector<Eigen::Matrix3d, Eigen::aligned_allocator<Eigen::Matrix3d> >& rotations,
+                                                           const Eigen::MatrixXd& beam_dirs, int nbr_threads)
+{
+    int nbr_poses = positions.rows();
+    int nbr_beams = beam_dirs.rows();
+    if (int(rotations.size()) != nbr_poses) {
+        cout << "Need one rotation per position, got " << rotations.size() << " for " << nbr_poses << endl;
+        return mbes_simulation_result();
+    }
+
+    mbes_simulation_result result;
+    result.hits.setZero(nbr_poses*nbr_beams, 3);
+    result.valid.setConstant(nbr_poses, nbr_beams, false);
+
+    // poses are handed out in blocks, each with its own tracer context and buffers
+    const int block_size = 64;
+    int nbr_blocks = (nbr_poses + block_size - 1)/block_size;
+    BathyTracer shared_context = make_tracer_context();
+    std_data::parallel_for(nbr_blocks, nbr_threads, [&](int b) {
+        BathyTracer context = shared_context;
+        Eigen::MatrixXd dirs(nbr_beams, 3);
+        Eigen::MatrixXd hits;
+        Eigen::VectorXi hits_inds;
+        for (int i = b*block_size; i < min((b+1)*block_size, nbr_poses); ++i) {
+            dirs.noalias() = beam_dirs*rotations[i].transpose();
+            Eigen::Vector3d pos = positions.row(i).transpose() - offset;
+            context.compute_ray_hits(pos, dirs, V1, F1, hits, hits_inds);
+            for (int j = 0; j < nbr_beams; ++j) {
+                if (hits_inds(j) >= 0) {
+                    result.hits.row(i*nbr_beams + j) = hits.row(j) + offset.transpose();
+                    result.valid(i, j) = true;
+                }
+            }
+        }
+    });
+
+    return result;
+}
+
+mbes_simulation_result BaseDraper::project_mbes_pings(const std_data::mbes_ping::PingsT& pings,
+                                                      const Eigen::MatrixXd& beam_dirs, int nbr_threads)
+{
+    Eigen::MatrixXd positions(pings.size(), 3);
+    vector<Eigen::Matrix3d, Eigen::aligned_allocator<Eigen::Matrix3d> > rotations(pings.size());
+    for (int i = 0; i < int(pings.size()); ++i) {
+        positions.row(i) = pings[i].pos_.transpose();
+        Eigen::Matrix3d Rx = Eigen::AngleAxisd(pings[i].roll_, Eigen::Vector3d::UnitX()).matrix();
+        Eigen::Matrix3d Ry = Eigen::AngleAxisd(pings[i].pitch_, Eigen::Vector3d::UnitY()).matrix();
+        Eigen::Matrix3d Rz = Eigen::AngleAxisd(pings[i].heading_, Eigen::Vector3d::UnitZ()).matrix();
+        rotations[i] = Rz*Ry*Rx;
+    }
+    return project_mbes_trajectory(positions, rotations, beam_dirs, nbr_threads);
+}
+
+Eigen::VectorXd BaseDraper::project_altimeters(const Eigen::MatrixXd& positions, int nbr_threads)
+{
+    Eigen::VectorXd depths(positions.rows());
+
+    const int block_size = 256;
+    int nbr_blocks = (positions.rows() + block_size - 1)/block_size;
+    BathyTracer shared_context = make_tracer_context();
+    std_data::parallel_for(nbr_blocks, nbr_threads, [&](int b) {
+        BathyTracer context = shared_context;
+        for (int i = b*block_size; i < min((b+1)*block_size, int(positions.rows())); ++i) {
+            depths(i) = context.depth_mesh_underneath_vehicle(positions.row(i).transpose() - offset, V1, F1);
+        }
+    });
+
+    return depths;
+}
+
 sss_draping_result BaseDraper::project_ping(const std_data::sss_ping& ping, int nbr_bins)
+{
+    return project_ping(ping, nbr_bins, tracer);
+}
+
+sss_draping_result BaseDraper::project_ping(const std_data::sss_ping& ping, int nbr_bins, BathyTracer& context)
 {
     Eigen::MatrixXd hits_left;
     Eigen::MatrixXd hits_right;
     Eigen::MatrixXd normals_left;
     Eigen::MatrixXd normals_right;
     auto start = chrono::high_resolution_clock::now();
-    tie(hits_left, hits_right, normals_left, normals_right) = project(ping);
+    tie(hits_left, hits_right, normals_left, normals_right) = project(ping, context);
     auto stop = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
     if (DEBUG_OUTPUT) cout << "project time: " << duration.count() << " microseconds" << endl;
@@ -392,12 +562,12 @@ sss_draping_result BaseDraper::project_ping(const std_data::sss_ping& ping, int
     if (DEBUG_OUTPUT) cout << "get_port_stbd_sensor_origins time: " << duration.count() << " microseconds" << endl;
 
     start = chrono::high_resolution_clock::now();
-    ping_draping_result left = project_ping_side(ping.port, hits_left, normals_left, origin_port, nbr_bins);
+    ping_draping_result left = project_ping_side(ping, ping.port, hits_left, normals_left, origin_port, nbr_bins);
     stop = chrono::high_resolution_clock::now();
     duration = chrono::duration_cast<chrono::microseconds>(stop - start);
     if (DEBUG_OUTPUT) cout << "project_ping_side left time: " << duration.count() << " microseconds" << endl;
     start = chrono::high_resolution_clock::now();
-    ping_draping_result right = project_ping_side(ping.stbd, hits_right, normals_right, origin_stbd, nbr_bins);
+    ping_draping_result right = project_ping_side(ping, ping.stbd, hits_right, normals_right, origin_stbd, nbr_bins);
     stop = chrono::high_resolution_clock::now();
     duration = chrono::duration_cast<chrono::microseconds>(stop - start);
     if (DEBUG_OUTPUT) cout << "project_ping_side right time: " << duration.count() << " microseconds" << endl;
@@ -405,33 +575,138 @@ sss_draping_result BaseDraper::project_ping(const std_data::sss_ping& ping, int
     return make_pair(left, right);
 }
 
-ping_draping_result BaseDraper::project_ping_side(const std_data::sss_ping_side& sensor, const Eigen::MatrixXd& hits,
-                                                  const Eigen::MatrixXd& hits_normals, const Eigen::Vector3d& origin,
+void BaseDraper::project_ping_compact(const std_data::sss_ping& ping, int nbr_bins,
+                                      compact_ping_draping_result& left, compact_ping_draping_result& right)
+{
+    project_ping_compact(ping, nbr_bins, tracer, left, right);
+}
+
+void BaseDraper::project_ping_compact(const std_data::sss_ping& ping, int nbr_bins, BathyTracer& context,
+                                      compact_ping_draping_result& left, compact_ping_draping_result& right)
+{
+    Eigen::MatrixXd hits_left;
+    Eigen::MatrixXd hits_right;
+    Eigen::MatrixXd normals_left;
+    Eigen::MatrixXd normals_right;
+    tie(hits_left, hits_right, normals_left, normals_right) = project(ping, context);
+
+    Eigen::Vector3d origin_port;
+    Eigen::Vector3d origin_stbd;
+    tie(origin_port, origin_stbd) = get_port_stbd_sensor_origins(ping);
+
+    // same seeds as in project_ping_side, so both give the same model intensities
+    side_draping_buffers buffers;
+    std::default_random_engine port_generator = side_noise_generator(ping.time_stamp_, true);
+    drape_ping_side(ping, ping.port, hits_left, normals_left, origin_port, nbr_bins, port_generator, buffers);
+    left.assign(origin_port, hits_left, buffers);
+    std::default_random_engine stbd_generator = side_noise_generator(ping.time_stamp_, false);
+    drape_ping_side(ping, ping.stbd, hits_right, normals_right, origin_stbd, nbr_bins, stbd_generator, buffers);
+    right.assign(origin_stbd, hits_right, buffers);
+}
+
+ping_draping_result BaseDraper::project_ping_side(const std_data::sss_ping& ping, const std_data::sss_ping_side& sensor,
+                                                  const Eigen::MatrixXd& hits, const Eigen::MatrixXd& hits_normals, const Eigen::Vector3d& origin,
                                                   int nbr_bins)
 {
+    // seeded per ping side so that the noise does not depend on the order pings are draped in
+    std::default_random_engine noise_generator = side_noise_generator(ping.time_stamp_, &sensor == &ping.port);
+    side_draping_buffers buffers;
+    drape_ping_side(ping, sensor, hits, hits_normals, origin, nbr_bins, noise_generator, buffers);
+
     ping_draping_result res;
     res.hits_points = hits;
     res.sensor_origin = origin;
+    res.hits_times = buffers.hits_times.head(buffers.nbr_hits);
+    res.hits_inds = buffers.hits_bins.head(buffers.nbr_hits);
+    res.hits_intensities = buffers.hits_intensities.head(buffers.nbr_hits);
+    res.time_bin_points = buffers.bin_points;
+    res.time_bin_normals = buffers.bin_normals;
+    res.time_bin_model_intensities = buffers.bin_model_intensities;
 
-    res.hits_times = compute_times(origin, hits);
+    if (DEBUG_OUTPUT) cout << "Adding hits: " << res.hits_points.rows() << endl;
 
-    // compute the elevation waterfall row
-    res.time_bin_points = convert_to_time_bins(res.hits_times, hits, sensor, nbr_bins);
-    res.time_bin_normals = convert_to_time_bins(res.hits_times, hits_normals, sensor, nbr_bins);
+    return res;
+}
 
-    // compute the intensities of the model
-    Eigen::VectorXd model_intensities = compute_model_intensities(hits, hits_normals, origin);
-    res.time_bin_model_intensities = convert_to_time_bins(res.hits_times, model_intensities, sensor, nbr_bins);
+void BaseDraper::drape_ping_side(const std_data::sss_ping& ping, const std_data::sss_ping_side& sensor,
+                                 const Eigen::MatrixXd& hits, const Eigen::MatrixXd& hits_normals,
+                                 const Eigen::Vector3d& origin, int nbr_bins,
+                                 std::default_random_engine& noise_generator, side_draping_buffers& buffers) const
+{
+    const int nbr_hits = hits.rows();
+    buffers.nbr_hits = nbr_hits;
+    if (buffers.hits_times.rows() < nbr_hits) {
+        buffers.hits_times.resize(nbr_hits);
+        buffers.hits_bins.resize(nbr_hits);
+        buffers.hits_intensities.resize(nbr_hits);
+        buffers.hits_model_intensities.resize(nbr_hits);
+    }
+    buffers.bin_points.setZero(nbr_bins, 3);
+    buffers.bin_normals.setZero(nbr_bins, 3);
+    buffers.bin_model_intensities.setZero(nbr_bins);
+    buffers.bin_counts.setZero(nbr_bins);
+
+    // the travel times are either from the refraction tables or from the harmonic mean speed
+    sound_speed_layers layers = sound_speed_profiles.layers_below(ping, origin(2));
+    TravelTimeTable::Ptr table;
+    if (ray_tracing_enabled) {
+        table = travel_time_tables->get_table(layers.heights, layers.speeds, origin(2));
+    }
+    const double time_per_dist = 2./layers.harmonic_mean_speed;
+    const double bin_step = sensor.time_duration / double(nbr_bins);
+    const int nbr_samples = sensor.pings.size();
+    const double sample_step = sensor.time_duration / double(nbr_samples);
+
+    std::normal_distribution<double> noise_dist(1., model_sigma_theta);
+
+    // the hits and normals are column major, so each coordinate is read as a separate stream
+    for (int i = 0; i < nbr_hits; ++i) {
+        double dx = origin(0) - hits(i, 0);
+        double dy = origin(1) - hits(i, 1);
+        double dz = origin(2) - hits(i, 2);
+        double dist = sqrt(dx*dx + dy*dy + dz*dz);
+        double nx = hits_normals(i, 0);
+        double ny = hits_normals(i, 1);
+        double nz = hits_normals(i, 2);
+        double normal_norm = sqrt(nx*nx + ny*ny + nz*nz);
+        double theta = acos((dx*nx + dy*ny + dz*nz)/(dist*normal_norm));
+
+        double time;
+        if (table) {
+            time = table->two_way_time(Eigen::Vector2d(sqrt(dx*dx + dy*dy), -dz));
+        }
+        else {
+            time = time_per_dist*dist;
+        }
+        buffers.hits_times(i) = time;
 
-    // compute the ground truth intensities
-    res.hits_intensities = compute_intensities(res.hits_times, sensor);
+        int sample_index = int(time/sample_step);
+        buffers.hits_intensities(i) = sample_index >= 0 && sample_index < nbr_samples? double(sensor.pings[sample_index])/10000. : 0.;
 
-    // compute waterfall image inds of hits
-    res.hits_inds = compute_bin_indices(res.hits_times, sensor, nbr_bins);
+        double model = model_intensity(dist, theta, noise_dist(noise_generator));
+        buffers.hits_model_intensities(i) = model;
 
-    if (DEBUG_OUTPUT) cout << "Adding hits: " << res.hits_points.rows() << endl;
+        int bin = int(time/bin_step);
+        if (bin >= 0 && bin < nbr_bins) {
+            buffers.hits_bins(i) = bin;
+            buffers.bin_points.row(bin) += hits.row(i);
+            buffers.bin_normals.row(bin) += hits_normals.row(i);
+            buffers.bin_model_intensities(bin) += model;
+            buffers.bin_counts(bin) += 1.;
+        }
+        else {
+            buffers.hits_bins(i) = -1;
+        }
+    }
 
-    return res;
+    for (int bin = 0; bin < nbr_bins; ++bin) {
+        if (buffers.bin_counts(bin) > 0.) {
+            double weight = 1./buffers.bin_counts(bin);
+            buffers.bin_points.row(bin) *= weight;
+            buffers.bin_normals.row(bin) *= weight;
+            buffers.bin_model_intensities(bin) *= weight;
+        }
+    }
 }
 
 Eigen::VectorXd compute_bin_intensities(const std_data::sss_ping_side& ping, int nbr_bins)
@@ -0,0 +1,38 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/batch_draper.h>
+#include <bathy_maps/impl/batch_draper.hpp>
+#include <bathy_maps/sss_meas_data.h>
+
+template class BatchDraper<sss_map_image_builder>;
+
+template class BatchDraper<sss_meas_data_builder>;
+
+sss_map_image::ImagesT batch_drape_maps(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                                        const BaseDraper::BoundsT& bounds, const std_data::sss_ping::PingsT& pings,
+                                        const csv_asvp_sound_speed::EntriesT& sound_speeds, double sensor_yaw,
+                                        double resolution, const std::function<void(sss_map_image)>& save_callback,
+                                        int nbr_threads)
+{
+    BatchDraper<sss_map_image_builder> draper(V, F, pings, bounds, sound_speeds);
+    draper.set_sidescan_yaw(sensor_yaw);
+    draper.set_resolution(resolution);
+    draper.set_image_callback(save_callback);
+    draper.set_nbr_threads(nbr_threads);
+    draper.set_progress_callback([](int nbr_done, int nbr_pings) {
+        if (nbr_done % 1000 == 0 || nbr_done == nbr_pings) {
+            cout << "Draped " << nbr_done << "/" << nbr_pings << " pings" << endl;
+        }
+    });
+
+    return draper.drape();
+}
@@ -0,0 +1,177 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/compact_draping_result.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const char file_magic[8] = { 'D', 'R', 'A', 'P', 'I', 'N', 'G', '1' };
+
+// bytes written per hit and per bin by DrapingResultWriter::write_side
+const std::streamoff hit_size = 3*sizeof(float) + sizeof(int) + 2*sizeof(float);
+const std::streamoff bin_size = 7*sizeof(float);
+
+template <typename T>
+void write_values(ofstream& output, const T* data, int size)
+{
+    output.write((const char*)data, size*sizeof(T));
+}
+
+template <typename T>
+bool read_values(ifstream& input, T* data, int size)
+{
+    input.read((char*)data, size*sizeof(T));
+    return bool(input);
+}
+
+} // namespace
+
+void compact_ping_draping_result::reserve(int new_nbr_hits, int new_nbr_bins)
+{
+    nbr_hits = new_nbr_hits;
+    nbr_bins = new_nbr_bins;
+    if (hits_points.rows() < nbr_hits) {
+        hits_points.resize(nbr_hits, 3);
+        hits_inds.resize(nbr_hits);
+        hits_times.resize(nbr_hits);
+        hits_intensities.resize(nbr_hits);
+    }
+    if (time_bin_points.rows() < nbr_bins) {
+        time_bin_points.resize(nbr_bins, 3);
+        time_bin_normals.resize(nbr_bins, 3);
+        time_bin_model_intensities.resize(nbr_bins);
+    }
+}
+
+void compact_ping_draping_result::assign(const Eigen::Vector3d& origin, const Eigen::MatrixXd& hits, const side_draping_buffers& buffers)
+{
+    reserve(buffers.nbr_hits, buffers.bin_points.rows());
+    sensor_origin = origin;
+    hits_points.topRows(nbr_hits) = hits.topRows(nbr_hits).cast<float>();
+    hits_inds.head(nbr_hits) = buffers.hits_bins.head(nbr_hits);
+    hits_times.head(nbr_hits) = buffers.hits_times.head(nbr_hits).cast<float>();
+    hits_intensities.head(nbr_hits) = buffers.hits_intensities.head(nbr_hits).cast<float>();
+    time_bin_points.topRows(nbr_bins) = buffers.bin_points.cast<float>();
+    time_bin_normals.topRows(nbr_bins) = buffers.bin_normals.cast<float>();
+    time_bin_model_intensities.head(nbr_bins) = buffers.bin_model_intensities.cast<float>();
+}
+
+void compact_ping_draping_result::assign(const ping_draping_result& result)
+{
+    reserve(result.hits_points.rows(), result.time_bin_points.rows());
+    sensor_origin = result.sensor_origin;
+    hits_points.topRows(nbr_hits) = result.hits_points.cast<float>();
+    hits_inds.head(nbr_hits) = result.hits_inds;
+    hits_times.head(nbr_hits) = result.hits_times.cast<float>();
+    hits_intensities.head(nbr_hits) = result.hits_intensities.cast<float>();
+    time_bin_points.topRows(nbr_bins) = result.time_bin_points.cast<float>();
+    time_bin_normals.topRows(nbr_bins) = result.time_bin_normals.cast<float>();
+    time_bin_model_intensities.head(nbr_bins) = result.time_bin_model_intensities.cast<float>();
+}
+
+ping_draping_result compact_ping_draping_result::to_result() const
+{
+    ping_draping_result result;
+    result.sensor_origin = sensor_origin;
+    result.hits_points = hits_points.topRows(nbr_hits).cast<double>();
+    result.hits_inds = hits_inds.head(nbr_hits);
+    result.hits_times = hits_times.head(nbr_hits).cast<double>();
+    result.hits_intensities = hits_intensities.head(nbr_hits).cast<double>();
+    result.time_bin_points = time_bin_points.topRows(nbr_bins).cast<double>();
+    result.time_bin_normals = time_bin_normals.topRows(nbr_bins).cast<double>();
+    result.time_bin_model_intensities = time_bin_model_intensities.head(nbr_bins).cast<double>();
+    return result;
+}
+
+DrapingResultWriter::DrapingResultWriter(const std::string& path) : output(path, ios::binary)
+{
+    if (!output.is_open()) {
+        cout << "Could not open " << path << " for writing draping results" << endl;
+        return;
+    }
+    output.write(file_magic, sizeof(file_magic));
+}
+
+void DrapingResultWriter::write_side(const compact_ping_draping_result& result)
+{
+    // the row major buffers are contiguous in their first rows
+    write_values(output, result.sensor_origin.data(), 3);
+    write_values(output, &result.nbr_hits, 1);
+    write_values(output, &result.nbr_bins, 1);
+    write_values(output, result.hits_points.data(), 3*result.nbr_hits);
+    write_values(output, result.hits_inds.data(), result.nbr_hits);
+    write_values(output, result.hits_times.data(), result.nbr_hits);
+    write_values(output, result.hits_intensities.data(), result.nbr_hits);
+    write_values(output, result.time_bin_points.data(), 3*result.nbr_bins);
+    write_values(output, result.time_bin_normals.data(), 3*result.nbr_bins);
+    write_values(output, result.time_bin_model_intensities.data(), result.nbr_bins);
+}
+
+bool DrapingResultWriter::write(const compact_ping_draping_result& left, const compact_ping_draping_result& right)
+{
+    write_side(left);
+    write_side(right);
+    return bool(output);
+}
+
+DrapingResultReader::DrapingResultReader(const std::string& path) : input(path, ios::binary), file_size(0)
+{
+    if (!input.is_open()) {
+        cout << "Could not open " << path << " for reading draping results" << endl;
+        return;
+    }
+    input.seekg(0, ios::end);
+    file_size = input.tellg();
+    input.seekg(0, ios::beg);
+    char magic[sizeof(file_magic)];
+    if (!read_values(input, magic, sizeof(magic)) || memcmp(magic, file_magic, sizeof(magic)) != 0) {
+        cout << path << " is not a draping result file" << endl;
+        input.close();
+    }
+}
+
+bool DrapingResultReader::read_side(compact_ping_draping_result& result)
+{
+    Eigen::Vector3d origin;
+    int nbr_hits, nbr_bins;
+    if (!read_values(input, origin.data(), 3) || !read_values(input, &nbr_hits, 1) ||
+        !read_values(input, &nbr_bins, 1) || nbr_hits < 0 || nbr_bins < 0) {
+        return false;
+    }
+    // a corrupt count would otherwise allocate far more than the file could hold
+    std::streamoff remaining = file_size - input.tellg();
+    if (nbr_hits*hit_size + nbr_bins*bin_size > remaining) {
+        cout << "Draping result file is truncated or corrupt" << endl;
+        input.close();
+        return false;
+    }
+    result.reserve(nbr_hits, nbr_bins);
+    result.sensor_origin = origin;
+    return read_values(input, result.hits_points.data(), 3*nbr_hits) &&
+           read_values(input, result.hits_inds.data(), nbr_hits) &&
+           read_values(input, result.hits_times.data(), nbr_hits) &&
+           read_values(input, result.hits_intensities.data(), nbr_hits) &&
+           read_values(input, result.time_bin_points.data(), 3*nbr_bins) &&
+           read_values(input, result.time_bin_normals.data(), 3*nbr_bins) &&
+           read_values(input, result.time_bin_model_intensities.data(), nbr_bins);
+}
+
+bool DrapingResultReader::read(compact_ping_draping_result& left, compact_ping_draping_result& right)
+{
+    if (!input.is_open()) {
+        return false;
+    }
+    return read_side(left) && read_side(right);
+}
@@ -0,0 +1,148 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/dem_pyramid.h>
+#include <bathy_maps/mesh_map.h>
+#include <cmath>
+
+using namespace std;
+
+DemPyramid::DemPyramid(const SparseRaster& height_map, Reduction reduction, int max_levels) : reduction(reduction)
+{
+    levels.push_back(height_map);
+    while (max_levels <= 0 || nbr_levels() < max_levels) {
+        const SparseRaster& finest = levels.back();
+        if (finest.get_rows() <= SparseRaster::tile_size && finest.get_cols() <= SparseRaster::tile_size) {
+            break;
+        }
+        levels.push_back(reduce(finest));
+    }
+}
+
+DemPyramid::DemPyramid(const Eigen::MatrixXd& height_map, const BoundsT& bounds, float nodata, Reduction reduction, int max_levels)
+    : DemPyramid(SparseRaster::from_dense(height_map, bounds, nodata), reduction, max_levels)
+{
+}
+
+SparseRaster DemPyramid::reduce(const SparseRaster& fine) const
+{
+    const int tile_size = SparseRaster::tile_size;
+    int rows = (fine.get_rows() + 1)/2;
+    int cols = (fine.get_cols() + 1)/2;
+    double res = 2.*fine.get_resolution();
+    BoundsT bounds = fine.get_bounds();
+    bounds(1, 0) = bounds(0, 0) + double(cols)*res;
+    bounds(1, 1) = bounds(0, 1) + double(rows)*res;
+
+    SparseRaster coarse(rows, cols, bounds, fine.get_nodata());
+    SparseRaster counts(reduction == MEAN? rows : 0, reduction == MEAN? cols : 0, bounds);
+    for (const pair<int, int>& t : fine.get_tiles()) {
+        SparseRaster::ConstTileValuesT values = fine.tile_values(t.first, t.second);
+        SparseRaster::ConstTileMaskT mask = fine.tile_mask(t.first, t.second);
+        for (int i = 0; i < tile_size; ++i) {
+            for (int j = 0; j < tile_size; ++j) {
+                if (!mask(i, j)) {
+                    continue;
+                }
+                int row = (t.first + i)/2;
+                int col = (t.second + j)/2;
+                float value = values(i, j);
+                if (reduction == MEAN) {
+                    coarse.add(row, col, value);
+                    counts.add(row, col, 1.f);
+                }
+                else if (!coarse.is_valid(row, col)) {
+                    coarse.set(row, col, value);
+                }
+                else {
+                    float current = coarse.get(row, col);
+                    coarse.set(row, col, reduction == MIN? min(current, value) : max(current, value));
+                }
+            }
+        }
+    }
+
+    if (reduction == MEAN) {
+        // the sums and counts are written together, so they have the same tiles
+        const SparseRaster& coarse_counts = counts;
+        for (const pair<int, int>& t : coarse_counts.get_tiles()) {
+            SparseRaster::TileValuesT sums = coarse.tile_values(t.first, t.second);
+            sums.array() /= coarse_counts.tile_values(t.first, t.second).array().max(1.f);
+        }
+    }
+
+    return coarse;
+}
+
+int DemPyramid::level_for_resolution(double res) const
+{
+    int level = 0;
+    while (level + 1 < nbr_levels() && get_resolution(level + 1) <= res*(1. + 1e-6)) {
+        ++level;
+    }
+    return level;
+}
+
+SparseRaster DemPyramid::get_region(int level, const BoundsT& bounds) const
+{
+    const int tile_size = SparseRaster::tile_size;
+    const SparseRaster& raster = levels[level];
+    const BoundsT& raster_bounds = raster.get_bounds();
+    double res = raster.get_resolution();
+
+    int col0 = max(int(std::floor((bounds(0, 0) - raster_bounds(0, 0))/res)), 0);
+    int row0 = max(int(std::floor((bounds(0, 1) - raster_bounds(0, 1))/res)), 0);
+    int col1 = min(int(std::ceil((bounds(1, 0) - raster_bounds(0, 0))/res - 1e-6)), raster.get_cols());
+    int row1 = min(int(std::ceil((bounds(1, 1) - raster_bounds(0, 1))/res - 1e-6)), raster.get_rows());
+    col1 = max(col1, col0);
+    row1 = max(row1, row0);
+
+    BoundsT region_bounds;
+    region_bounds << raster_bounds(0, 0) + double(col0)*res, raster_bounds(0, 1) + double(row0)*res,
+                     raster_bounds(0, 0) + double(col1)*res, raster_bounds(0, 1) + double(row1)*res;
+    SparseRaster region(row1 - row0, col1 - col0, region_bounds, raster.get_nodata());
+    for (const pair<int, int>& t : raster.get_tiles()) {
+        if (t.first >= row1 || t.first + tile_size <= row0 || t.second >= col1 || t.second + tile_size <= col0) {
+            continue;
+        }
+        SparseRaster::ConstTileValuesT values = raster.tile_values(t.first, t.second);
+        SparseRaster::ConstTileMaskT mask = raster.tile_mask(t.first, t.second);
+        for (int i = max(row0 - t.first, 0); i < min(row1 - t.first, tile_size); ++i) {
+            for (int j = max(col0 - t.second, 0); j < min(col1 - t.second, tile_size); ++j) {
+                if (mask(i, j)) {
+                    region.set(t.first + i - row0, t.second + j - col0, values(i, j));
+                }
+            }
+        }
+    }
+
+    return region;
+}
+
+SparseRaster DemPyramid::get_sparse_height_map(const BoundsT& bounds, double res) const
+{
+    return get_region(level_for_resolution(res), bounds);
+}
+
+pair<Eigen::MatrixXd, DemPyramid::BoundsT> DemPyramid::get_height_map(const BoundsT& bounds, double res) const
+{
+    SparseRaster region = get_sparse_height_map(bounds, res);
+    return make_pair(region.to_dense(), region.get_bounds());
+}
+
+tuple<Eigen::MatrixXd, Eigen::MatrixXi, DemPyramid::BoundsT> DemPyramid::get_mesh(const BoundsT& bounds, double res) const
+{
+    SparseRaster region = get_sparse_height_map(bounds, res);
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    tie(V, F) = mesh_map::mesh_from_height_map(region);
+    return make_tuple(V, F, region.get_bounds());
+}
@@ -100,6 +100,16 @@ BathyMapImage::BathyMapImage(const mbes_ping::PingsT& pings, int rows, int cols)
 }
 
 BathyMapImage::BathyMapImage(const Eigen::MatrixXd& height_map, const Eigen::Matrix2d& bounds) : rows(height_map.rows()), cols(height_map.cols())
+{
+    set_bounds(bounds);
+}
+
+BathyMapImage::BathyMapImage(const SparseRaster& height_map) : rows(height_map.get_rows()), cols(height_map.get_cols())
+{
+    set_bounds(height_map.get_bounds());
+}
+
+void BathyMapImage::set_bounds(const Eigen::Matrix2d& bounds)
 {
     double maxx = bounds(1, 0);
     double minx = bounds(0, 0);
@@ -225,6 +235,56 @@ void BathyMapImage::draw_height_map(const Eigen::MatrixXd& height_map)
     cout << "Min value: " << minv << ", max value: " << minv+maxv << endl;
 }
 
+void BathyMapImage::draw_height_map(const SparseRaster& height_map)
+{
+    const int tile_size = SparseRaster::tile_size;
+    vector<pair<int, int> > tiles = height_map.get_tiles();
+
+    // same scaling as for the dense height maps, where the empty cells are zero
+    double minv = 0.;
+    double maxv = 0.;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const pair<int, int>& t : tiles) {
+            SparseRaster::ConstTileValuesT values = height_map.tile_values(t.first, t.second);
+            SparseRaster::ConstTileMaskT mask = height_map.tile_mask(t.first, t.second);
+            for (int i = 0; i < tile_size; ++i) {
+                for (int j = 0; j < tile_size; ++j) {
+                    if (!mask(i, j)) {
+                        continue;
+                    }
+                    double value = values(i, j);
+                    if (pass == 0) {
+                        minv = std::min(minv, value);
+                        continue;
+                    }
+                    value -= value < 0? minv : 0.;
+                    maxv = std::max(maxv, value);
+                }
+            }
+        }
+    }
+
+    for (const pair<int, int>& t : tiles) {
+        SparseRaster::ConstTileValuesT values = height_map.tile_values(t.first, t.second);
+        SparseRaster::ConstTileMaskT mask = height_map.tile_mask(t.first, t.second);
+        int tile_rows = std::min(tile_size, std::min(rows, height_map.get_rows()) - t.first);
+        int tile_cols = std::min(tile_size, std::min(cols, height_map.get_cols()) - t.second);
+        for (int i = 0; i < tile_rows; ++i) {
+            for (int j = 0; j < tile_cols; ++j) {
+                if (!mask(i, j)) {
+                    continue;
+                }
+                double value = values(i, j);
+                value -= value < 0? minv : 0.;
+                cv::Point3_<uchar>* p = bathy_map.ptr<cv::Point3_<uchar> >(rows-t.first-i-1, t.second+j);
+                tie(p->z, p->y, p->x) = jet(maxv > 0.? value/maxv : 0.);
+            }
+        }
+    }
+
+    cout << "Min value: " << minv << ", max value: " << minv+maxv << endl;
+}
+
 void BathyMapImage::draw_height_map(const mbes_ping::PingsT& pings)
 {
     Eigen::MatrixXd means(rows, cols); means.setZero();
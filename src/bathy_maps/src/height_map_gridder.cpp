@@ -0,0 +1,455 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/height_map_gridder.h>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// rounds towards minus infinity, unlike integer division
+int floor_div(int a, int b)
+{
+    return a >= 0? a/b : -((-a - 1)/b) - 1;
+}
+
+long long tile_key(int tile_row, int tile_col)
+{
+    return (static_cast<long long>(tile_row) << 32) | static_cast<unsigned int>(tile_col);
+}
+
+// first index of chunk c when splitting n indices into nbr_chunks chunks
+int chunk_begin(int c, int n, int nbr_chunks)
+{
+    return int(static_cast<long long>(c)*n/nbr_chunks);
+}
+
+int resolve_threads(int nbr_threads)
+{
+    return nbr_threads > 0? nbr_threads : max(int(thread::hardware_concurrency()), 1);
+}
+
+// the step of the median estimate is sqrt(pi/2)*sigma/n, the optimal robbins-monro
+// gain for normally distributed soundings
+const double median_gain = 1.2533;
+
+} // namespace
+
+const int HeightMapGridder::tile_size;
+
+HeightMapGridder::HeightMapGridder(double res, int layers, int nbr_threads)
+    : res(res), layers(layers | MEAN), nbr_threads(nbr_threads), has_bounds(false),
+      origin(Eigen::Vector2d::Zero()), rows(0), cols(0),
+      min_row(numeric_limits<int>::max()), max_row(numeric_limits<int>::min()),
+      min_col(numeric_limits<int>::max()), max_col(numeric_limits<int>::min())
+{
+}
+
+HeightMapGridder::HeightMapGridder(const BoundsT& bounds, double res, int layers, int nbr_threads)
+    : HeightMapGridder(res, layers, nbr_threads)
+{
+    has_bounds = true;
+    origin = bounds.row(0).transpose();
+    // the tolerance keeps bounds that are already whole cells from growing by one
+    cols = max(int(std::ceil((bounds(1, 0) - bounds(0, 0))/res - 1e-6)), 0);
+    rows = max(int(std::ceil((bounds(1, 1) - bounds(0, 1))/res - 1e-6)), 0);
+}
+
+HeightMapGridder::tile* HeightMapGridder::get_tile(long long key, int tile_row, int tile_col)
+{
+    unique_ptr<tile>& t = tiles[key];
+    if (t) {
+        return t.get();
+    }
+
+    const int nbr_cells = tile_size*tile_size;
+    t.reset(new tile);
+    t->row = tile_row*tile_size;
+    t->col = tile_col*tile_size;
+    t->counts.assign(nbr_cells, 0);
+    t->means.assign(nbr_cells, 0.);
+    if (layers & (VARIANCE | MEDIAN)) {
+        t->squares.assign(nbr_cells, 0.);
+    }
+    if (layers & MIN) {
+        t->mins.assign(nbr_cells, numeric_limits<float>::max());
+    }
+    if (layers & MAX) {
+        t->maxs.assign(nbr_cells, -numeric_limits<float>::max());
+    }
+    if (layers & MEDIAN) {
+        t->medians.assign(nbr_cells, 0.f);
+    }
+    return t.get();
+}
+
+bool HeightMapGridder::point_cell(const Eigen::Vector3d& point, int& row, int& col) const
+{
+    double x = std::floor((point(0) - origin(0))/res);
+    double y = std::floor((point(1) - origin(1))/res);
+    if (has_bounds && (x < 0. || x >= double(cols) || y < 0. || y >= double(rows))) {
+        return false;
+    }
+    col = int(x);
+    row = int(y);
+    return true;
+}
+
+void HeightMapGridder::add_to_cell(tile& t, int cell, double height)
+{
+    // welford's update of the mean and the squared differences
+    unsigned int n = ++t.counts[cell];
+    double delta = height - t.means[cell];
+    t.means[cell] += delta/double(n);
+    if (!t.squares.empty()) {
+        t.squares[cell] += delta*(height - t.means[cell]);
+    }
+    if (!t.mins.empty()) {
+        t.mins[cell] = min(t.mins[cell], float(height));
+    }
+    if (!t.maxs.empty()) {
+        t.maxs[cell] = max(t.maxs[cell], float(height));
+    }
+    if (!t.medians.empty()) {
+        if (n == 1) {
+            t.medians[cell] = height;
+        }
+        else {
+            double step = median_gain*sqrt(t.squares[cell]/double(n - 1))/double(n);
+            double diff = height - t.medians[cell];
+            t.medians[cell] += diff > 0.? min(diff, step) : max(diff, -step);
+        }
+    }
+}
+
+void HeightMapGridder::add_to_tile(tile& t, const tile_bucket& bucket)
+{
+    for (int i = 0; i < int(bucket.cells.size()); ++i) {
+        add_to_cell(t, bucket.cells[i], bucket.heights[i]);
+    }
+}
+
+struct HeightMapGridder::batch_chunk
+{
+    const HeightMapGridder& gridder;
+    unordered_map<long long, tile_bucket> buckets;
+    int min_row;
+    int max_row;
+    int min_col;
+    int max_col;
+    // the last bucket is remembered, since consecutive soundings are mostly in the same tile
+    long long last_key;
+    tile_bucket* last_bucket;
+
+    batch_chunk(const HeightMapGridder& gridder)
+        : gridder(gridder), min_row(numeric_limits<int>::max()), max_row(numeric_limits<int>::min()),
+          min_col(numeric_limits<int>::max()), max_col(numeric_limits<int>::min()),
+          last_key(0), last_bucket(nullptr)
+    {
+    }
+
+    void add(const Eigen::Vector3d& point)
+    {
+        int row, col;
+        if (!gridder.point_cell(point, row, col)) {
+            return;
+        }
+        int tile_row = floor_div(row, tile_size);
+        int tile_col = floor_div(col, tile_size);
+        long long key = tile_key(tile_row, tile_col);
+        if (last_bucket == nullptr || key != last_key) {
+            last_bucket = &buckets[key];
+            last_key = key;
+        }
+        last_bucket->cells.push_back((row - tile_row*tile_size)*tile_size + col - tile_col*tile_size);
+        last_bucket->heights.push_back(point(2));
+        min_row = min(min_row, row);
+        max_row = max(max_row, row);
+        min_col = min(min_col, col);
+        max_col = max(max_col, col);
+    }
+};
+
+template <typename ChunkFunc>
+void HeightMapGridder::add_batch(int nbr_chunks, const ChunkFunc& for_chunk)
+{
+    vector<batch_chunk> chunks(nbr_chunks, batch_chunk(*this));
+    std_data::parallel_for(nbr_chunks, nbr_threads, [&](int c) {
+        for_chunk(c, chunks[c]);
+    });
+
+    // the tiles are created up front, so the map is not modified while updating
+    unordered_map<long long, int> batch_indices;
+    vector<tile*> batch_tiles;
+    vector<long long> batch_keys;
+    for (const batch_chunk& chunk : chunks) {
+        min_row = min(min_row, chunk.min_row);
+        max_row = max(max_row, chunk.max_row);
+        min_col = min(min_col, chunk.min_col);
+        max_col = max(max_col, chunk.max_col);
+        for (const auto& bucket : chunk.buckets) {
+            if (batch_indices.count(bucket.first) > 0) {
+                continue;
+            }
+            int tile_row = int(bucket.first >> 32);
+            int tile_col = int(static_cast<unsigned int>(bucket.first));
+            batch_indices[bucket.first] = batch_tiles.size();
+            dirty_tiles.insert(bucket.first);
+            batch_tiles.push_back(get_tile(bucket.first, tile_row, tile_col));
+            batch_keys.push_back(bucket.first);
+        }
+    }
+
+    std_data::parallel_for(batch_tiles.size(), nbr_threads, [&](int i) {
+        for (const batch_chunk& chunk : chunks) {
+            auto iter = chunk.buckets.find(batch_keys[i]);
+            if (iter != chunk.buckets.end()) {
+                add_to_tile(*batch_tiles[i], iter->second);
+            }
+        }
+    });
+}
+
+void HeightMapGridder::add_points(const Eigen::MatrixXd& points)
+{
+    int nbr_points = points.rows();
+    int nbr_chunks = min(4*resolve_threads(nbr_threads), max(nbr_points, 1));
+    add_batch(nbr_chunks, [&](int c, batch_chunk& chunk) {
+        for (int i = chunk_begin(c, nbr_points, nbr_chunks); i < chunk_begin(c+1, nbr_points, nbr_chunks); ++i) {
+            chunk.add(points.row(i).transpose());
+        }
+    });
+}
+
+void HeightMapGridder::add_cloud(const PointsT& cloud)
+{
+    int nbr_points = cloud.size();
+    int nbr_chunks = min(4*resolve_threads(nbr_threads), max(nbr_points, 1));
+    add_batch(nbr_chunks, [&](int c, batch_chunk& chunk) {
+        for (int i = chunk_begin(c, nbr_points, nbr_chunks); i < chunk_begin(c+1, nbr_points, nbr_chunks); ++i) {
+            chunk.add(cloud[i]);
+        }
+    });
+}
+
+void HeightMapGridder::add_pings(const std_data::mbes_ping::PingsT& pings)
+{
+    int nbr_pings = pings.size();
+    int nbr_chunks = min(4*resolve_threads(nbr_threads), max(nbr_pings, 1));
+    add_batch(nbr_chunks, [&](int c, batch_chunk& chunk) {
+        for (int i = chunk_begin(c, nbr_pings, nbr_chunks); i < chunk_begin(c+1, nbr_pings, nbr_chunks); ++i) {
+            for (const Eigen::Vector3d& beam : pings[i].beams) {
+                chunk.add(beam);
+            }
+        }
+    });
+}
+
+void HeightMapGridder::add_ping(const std_data::mbes_ping& ping)
+{
+    long long last_key = 0;
+    tile* last_tile = nullptr;
+    for (const Eigen::Vector3d& beam : ping.beams) {
+        int row, col;
+        if (!point_cell(beam, row, col)) {
+            continue;
+        }
+        int tile_row = floor_div(row, tile_size);
+        int tile_col = floor_div(col, tile_size);
+        long long key = tile_key(tile_row, tile_col);
+        if (last_tile == nullptr || key != last_key) {
+            last_tile = get_tile(key, tile_row, tile_col);
+            last_key = key;
+            dirty_tiles.insert(key);
+        }
+        add_to_cell(*last_tile, (row - last_tile->row)*tile_size + col - last_tile->col, beam(2));
+        min_row = min(min_row, row);
+        max_row = max(max_row, row);
+        min_col = min(min_col, col);
+        max_col = max(max_col, col);
+    }
+}
+
+HeightMapGridder::BoundsT HeightMapGridder::get_bounds() const
+{
+    BoundsT bounds;
+    if (has_bounds) {
+        bounds << origin(0), origin(1), origin(0) + double(cols)*res, origin(1) + double(rows)*res;
+    }
+    else if (min_row > max_row) {
+        bounds.setZero();
+    }
+    else {
+        bounds << origin(0) + double(min_col)*res, origin(1) + double(min_row)*res,
+                  origin(0) + double(max_col + 1)*res, origin(1) + double(max_row + 1)*res;
+    }
+    return bounds;
+}
+
+int HeightMapGridder::get_rows() const
+{
+    if (has_bounds) {
+        return rows;
+    }
+    return min_row > max_row? 0 : max_row - min_row + 1;
+}
+
+int HeightMapGridder::get_cols() const
+{
+    if (has_bounds) {
+        return cols;
+    }
+    return min_col > max_col? 0 : max_col - min_col + 1;
+}
+
+template <typename ValueFunc>
+Eigen::MatrixXd HeightMapGridder::get_cells(int row0, int col0, int rows, int cols, const ValueFunc& value) const
+{
+    Eigen::MatrixXd values = Eigen::MatrixXd::Zero(rows, cols);
+    if (rows <= 0 || cols <= 0) {
+        return values;
+    }
+
+    // only the tiles overlapping the window are looked up
+    vector<const tile*> window_tiles;
+    for (int tile_row = floor_div(row0, tile_size); tile_row <= floor_div(row0 + rows - 1, tile_size); ++tile_row) {
+        for (int tile_col = floor_div(col0, tile_size); tile_col <= floor_div(col0 + cols - 1, tile_size); ++tile_col) {
+            auto iter = tiles.find(tile_key(tile_row, tile_col));
+            if (iter != tiles.end()) {
+                window_tiles.push_back(iter->second.get());
+            }
+        }
+    }
+
+    // tiles write disjoint blocks of the values
+    std_data::parallel_for(window_tiles.size(), nbr_threads, [&](int i) {
+        const tile& t = *window_tiles[i];
+        for (int cell = 0; cell < tile_size*tile_size; ++cell) {
+            if (t.counts[cell] == 0) {
+                continue;
+            }
+            int row = t.row + cell/tile_size - row0;
+            int col = t.col + cell%tile_size - col0;
+            if (row >= 0 && row < rows && col >= 0 && col < cols) {
+                values(row, col) = value(t, cell);
+            }
+        }
+    });
+
+    return values;
+}
+
+template <typename ValueFunc>
+Eigen::MatrixXd HeightMapGridder::get_cells(const ValueFunc& value) const
+{
+    int row0 = has_bounds? 0 : min_row;
+    int col0 = has_bounds? 0 : min_col;
+    return get_cells(row0, col0, get_rows(), get_cols(), value);
+}
+
+namespace {
+
+// returns a function giving the value of layer for a cell
+template <typename TileT>
+function<double(const TileT&, int)> layer_value(HeightMapGridder::Layers layer)
+{
+    switch (layer) {
+    case HeightMapGridder::MIN:
+        return [](const TileT& t, int cell) { return double(t.mins[cell]); };
+    case HeightMapGridder::MAX:
+        return [](const TileT& t, int cell) { return double(t.maxs[cell]); };
+    case HeightMapGridder::MEDIAN:
+        return [](const TileT& t, int cell) { return double(t.medians[cell]); };
+    case HeightMapGridder::VARIANCE:
+        return [](const TileT& t, int cell) { return t.counts[cell] > 1? t.squares[cell]/double(t.counts[cell] - 1) : 0.; };
+    default:
+        return [](const TileT& t, int cell) { return t.means[cell]; };
+    }
+}
+
+} // namespace
+
+Eigen::MatrixXd HeightMapGridder::get_layer(Layers layer) const
+{
+    if ((layers & layer) == 0) {
+        cout << "Layer " << int(layer) << " was not accumulated, returning zeros" << endl;
+        return Eigen::MatrixXd::Zero(get_rows(), get_cols());
+    }
+    return get_cells(layer_value<tile>(layer));
+}
+
+Eigen::MatrixXd HeightMapGridder::get_layer(Layers layer, const BoundsT& bounds) const
+{
+    int col0 = int(std::floor((bounds(0, 0) - origin(0))/res));
+    int row0 = int(std::floor((bounds(0, 1) - origin(1))/res));
+    int cols = int(std::ceil((bounds(1, 0) - origin(0))/res - 1e-6)) - col0;
+    int rows = int(std::ceil((bounds(1, 1) - origin(1))/res - 1e-6)) - row0;
+    if ((layers & layer) == 0) {
+        cout << "Layer " << int(layer) << " was not accumulated, returning zeros" << endl;
+        return Eigen::MatrixXd::Zero(max(rows, 0), max(cols, 0));
+    }
+    return get_cells(row0, col0, rows, cols, layer_value<tile>(layer));
+}
+
+Eigen::MatrixXd HeightMapGridder::get_counts() const
+{
+    return get_cells([](const tile& t, int cell) { return double(t.counts[cell]); });
+}
+
+SparseRaster HeightMapGridder::get_sparse_layer(Layers layer) const
+{
+    SparseRaster raster(get_rows(), get_cols(), get_bounds());
+    if ((layers & layer) == 0) {
+        cout << "Layer " << int(layer) << " was not accumulated, returning empty raster" << endl;
+        return raster;
+    }
+
+    int row0 = has_bounds? 0 : min_row;
+    int col0 = has_bounds? 0 : min_col;
+    function<double(const tile&, int)> value = layer_value<tile>(layer);
+    for (const auto& iter : tiles) {
+        const tile& t = *iter.second;
+        for (int cell = 0; cell < tile_size*tile_size; ++cell) {
+            int row = t.row + cell/tile_size - row0;
+            int col = t.col + cell%tile_size - col0;
+            if (t.counts[cell] > 0 && row >= 0 && row < raster.get_rows() && col >= 0 && col < raster.get_cols()) {
+                raster.set(row, col, value(t, cell));
+            }
+        }
+    }
+
+    return raster;
+}
+
+HeightMapGridder::BoundsListT HeightMapGridder::get_dirty_bounds() const
+{
+    BoundsListT dirty_bounds;
+    for (long long key : dirty_tiles) {
+        const tile& t = *tiles.at(key);
+        int row0 = t.row;
+        int col0 = t.col;
+        int row1 = t.row + tile_size;
+        int col1 = t.col + tile_size;
+        if (has_bounds) {
+            row1 = min(row1, rows);
+            col1 = min(col1, cols);
+        }
+        BoundsT bounds;
+        bounds << origin(0) + double(col0)*res, origin(1) + double(row0)*res,
+                  origin(0) + double(col1)*res, origin(1) + double(row1)*res;
+        dirty_bounds.push_back(bounds);
+    }
+    return dirty_bounds;
+}
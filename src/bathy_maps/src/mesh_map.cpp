@@ -10,6 +10,7 @@
  */
 
 #include <bathy_maps/mesh_map.h>
+#include <bathy_maps/height_map_gridder.h>
 
 #include <igl/opengl/glfw/Viewer.h>
 #include <igl/opengl/gl.h>
@@ -26,6 +27,7 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include <chrono>
+#include <limits>
 
 using namespace std;
 
@@ -273,90 +275,54 @@ void show_height_map(const Eigen::MatrixXd& height_map)
 
 pair<Eigen::MatrixXd, BoundsT> height_map_from_pings(const mbes_ping::PingsT& pings, double res)
 {
-    auto xcomp = [](const mbes_ping& p1, const mbes_ping& p2) {
-        return p1.pos_[0] < p2.pos_[0];
-    };
-    auto ycomp = [](const mbes_ping& p1, const mbes_ping& p2) {
-        return p1.pos_[1] < p2.pos_[1];
-    };
-    double maxx = std::max_element(pings.begin(), pings.end(), xcomp)->pos_[0];
-    double minx = std::min_element(pings.begin(), pings.end(), xcomp)->pos_[0];
-    double maxy = std::max_element(pings.begin(), pings.end(), ycomp)->pos_[1];
-    double miny = std::min_element(pings.begin(), pings.end(), ycomp)->pos_[1];
-
-    cout << "Min X: " << minx << ", Max X: " << maxx << ", Min Y: " << miny << ", Max Y: " << maxy << endl;
-
-    int cols = std::ceil((maxx-minx)/res);
-    int rows = std::ceil((maxy-miny)/res);
-    maxx = minx + double(cols)*res;
-    maxy = miny + double(rows)*res;
-
-    cout << "Target res: " << res << endl;
-    cout << "Initial cols: " << cols << ", rows: " << rows << endl;
-
-    Eigen::MatrixXd means(rows, cols); means.setZero();
-    Eigen::MatrixXd counts(rows, cols); counts.setZero();
-
+    // the extent is given by the vehicle positions, found in one pass
+    double minx = numeric_limits<double>::max();
+    double maxx = -numeric_limits<double>::max();
+    double miny = numeric_limits<double>::max();
+    double maxy = -numeric_limits<double>::max();
     for (const mbes_ping& ping : pings) {
-        for (const Eigen::Vector3d& pos : ping.beams) {
-            int col = int((pos[0]-minx)/res);
-            int row = int((pos[1]-miny)/res);
-            if (col >= 0 && col < cols && row >= 0 && row < rows) {
-                means(row, col) += pos[2];
-                counts(row, col) += 1.;
-            }
-        }
+        minx = std::min(minx, ping.pos_[0]);
+        maxx = std::max(maxx, ping.pos_[0]);
+        miny = std::min(miny, ping.pos_[1]);
+        maxy = std::max(maxy, ping.pos_[1]);
     }
 
-    Eigen::ArrayXXd counts_pos = counts.array() + (counts.array() == 0.).cast<double>();
-    means.array() /= counts_pos;
+    cout << "Min X: " << minx << ", Max X: " << maxx << ", Min Y: " << miny << ", Max Y: " << maxy << endl;
 
     BoundsT bounds; bounds << minx, miny, maxx, maxy;
+    HeightMapGridder gridder(bounds, res);
+    gridder.add_pings(pings);
 
-    return make_pair(means, bounds);
+    cout << "Target res: " << res << endl;
+    cout << "Initial cols: " << gridder.get_cols() << ", rows: " << gridder.get_rows() << endl;
+
+    return make_pair(gridder.get_layer(HeightMapGridder::MEAN), gridder.get_bounds());
 }
 
 pair<Eigen::MatrixXd, BoundsT> height_map_from_cloud(const vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& cloud, double res)
 {
-    auto xcomp = [](const Eigen::Vector3d& p1, const Eigen::Vector3d& p2) {
-        return p1[0] < p2[0];
-    };
-    auto ycomp = [](const Eigen::Vector3d& p1, const Eigen::Vector3d& p2) {
-        return p1[1] < p2[1];
-    };
-    double maxx = std::max_element(cloud.begin(), cloud.end(), xcomp)->x();
-    double minx = std::min_element(cloud.begin(), cloud.end(), xcomp)->x();
-    double maxy = std::max_element(cloud.begin(), cloud.end(), ycomp)->y();
-    double miny = std::min_element(cloud.begin(), cloud.end(), ycomp)->y();
-
-    cout << "Min X: " << minx << ", Max X: " << maxx << ", Min Y: " << miny << ", Max Y: " << maxy << endl;
-
-    int cols = std::ceil((maxx-minx)/res);
-    int rows = std::ceil((maxy-miny)/res);
-    maxx = minx + double(cols)*res;
-    maxy = miny + double(rows)*res;
-
-    cout << "Target res: " << res << endl;
-    cout << "Initial cols: " << cols << ", rows: " << rows << endl;
-
-    Eigen::MatrixXd means(rows, cols); means.setZero();
-    Eigen::MatrixXd counts(rows, cols); counts.setZero();
-
+    // the grid starts at the min corner of the cloud, found in one pass
+    double minx = numeric_limits<double>::max();
+    double maxx = -numeric_limits<double>::max();
+    double miny = numeric_limits<double>::max();
+    double maxy = -numeric_limits<double>::max();
     for (const Eigen::Vector3d& pos : cloud) {
-        int col = int((pos[0]-minx)/res);
-        int row = int((pos[1]-miny)/res);
-        if (col >= 0 && col < cols && row >= 0 && row < rows) {
-            means(row, col) += pos[2];
-            counts(row, col) += 1.;
-        }
+        minx = std::min(minx, pos[0]);
+        maxx = std::max(maxx, pos[0]);
+        miny = std::min(miny, pos[1]);
+        maxy = std::max(maxy, pos[1]);
     }
 
-    Eigen::ArrayXXd counts_pos = counts.array() + (counts.array() == 0.).cast<double>();
-    means.array() /= counts_pos;
+    cout << "Min X: " << minx << ", Max X: " << maxx << ", Min Y: " << miny << ", Max Y: " << maxy << endl;
 
     BoundsT bounds; bounds << minx, miny, maxx, maxy;
+    HeightMapGridder gridder(bounds, res);
+    gridder.add_cloud(cloud);
+
+    cout << "Target res: " << res << endl;
+    cout << "Initial cols: " << gridder.get_cols() << ", rows: " << gridder.get_rows() << endl;
 
-    return make_pair(means, bounds);
+    return make_pair(gridder.get_layer(HeightMapGridder::MEAN), gridder.get_bounds());
 }
 
 pair<Eigen::MatrixXd, BoundsT> height_map_from_dtm_cloud(const vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& cloud, double res)
@@ -441,6 +407,162 @@ pair<Eigen::MatrixXd, Eigen::MatrixXi> mesh_from_height_map(const Eigen::MatrixX
     return make_pair(V, F);
 }
 
+namespace {
+
+// writes the vertices used by the faces of mesh_from_height_map to V and the faces to F,
+// in the same order. rows are counted in parallel, prefix summed and then written
+template <typename VerticesT, typename FacesT>
+void compact_mesh(const Eigen::MatrixXd& height_map, const BoundsT& bounds, int nbr_threads, VerticesT& V, FacesT& F)
+{
+    using VertexScalar = typename VerticesT::Scalar;
+    using FaceScalar = typename FacesT::Scalar;
+
+    int rows = height_map.rows();
+    int cols = height_map.cols();
+    double res = (bounds(1, 0) - bounds(0, 0))/double(cols);
+
+    auto valid = [&](int y, int x) {
+        return y >= 0 && y < rows && x >= 0 && x < cols && height_map(y, x) != 0;
+    };
+    // the faces emitted at vertex (y, x)
+    auto has_upper = [&](int y, int x) {
+        return valid(y, x) && valid(y, x-1) && valid(y-1, x);
+    };
+    auto has_lower = [&](int y, int x) {
+        return valid(y, x) && valid(y, x+1) && valid(y+1, x);
+    };
+
+    // index of the used vertices within their row, -1 for the others
+    vector<int> row_indices(size_t(rows)*size_t(cols), -1);
+    vector<int> vertex_offsets(rows + 1, 0);
+    vector<int> face_offsets(rows + 1, 0);
+    std_data::parallel_for(rows, nbr_threads, [&](int y) {
+        int nbr_vertices = 0;
+        int nbr_faces = 0;
+        for (int x = 0; x < cols; ++x) {
+            if (height_map(y, x) == 0) {
+                continue;
+            }
+            bool upper = has_upper(y, x);
+            bool lower = has_lower(y, x);
+            nbr_faces += int(upper) + int(lower);
+            if (upper || lower || has_upper(y, x+1) || has_upper(y+1, x) || has_lower(y, x-1) || has_lower(y-1, x)) {
+                row_indices[size_t(y)*size_t(cols) + x] = nbr_vertices++;
+            }
+        }
+        vertex_offsets[y + 1] = nbr_vertices;
+        face_offsets[y + 1] = nbr_faces;
+    });
+    for (int y = 0; y < rows; ++y) {
+        vertex_offsets[y + 1] += vertex_offsets[y];
+        face_offsets[y + 1] += face_offsets[y];
+    }
+
+    auto vertex = [&](int y, int x) {
+        return FaceScalar(vertex_offsets[y] + row_indices[size_t(y)*size_t(cols) + x]);
+    };
+
+    V.resize(vertex_offsets[rows], 3);
+    F.resize(face_offsets[rows], 3);
+    std_data::parallel_for(rows, nbr_threads, [&](int y) {
+        int face_counter = face_offsets[y];
+        for (int x = 0; x < cols; ++x) {
+            if (row_indices[size_t(y)*size_t(cols) + x] == -1) {
+                continue;
+            }
+            V.row(vertex(y, x)) << VertexScalar((double(x)+.5)*res), VertexScalar((double(y)+.5)*res), VertexScalar(height_map(y, x));
+            if (has_upper(y, x)) {
+                F.row(face_counter) << vertex(y, x), vertex(y, x-1), vertex(y-1, x);
+                ++face_counter;
+            }
+            if (has_lower(y, x)) {
+                F.row(face_counter) << vertex(y, x), vertex(y, x+1), vertex(y+1, x);
+                ++face_counter;
+            }
+        }
+    });
+}
+
+} // namespace
+
+pair<Eigen::MatrixXd, Eigen::MatrixXi> compact_mesh_from_height_map(const Eigen::MatrixXd& height_map, const BoundsT& bounds, int nbr_threads)
+{
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    compact_mesh(height_map, bounds, nbr_threads, V, F);
+    return make_pair(V, F);
+}
+
+pair<VerticesfT, FacesiT> compact_float_mesh_from_height_map(const Eigen::MatrixXd& height_map, const BoundsT& bounds, int nbr_threads)
+{
+    VerticesfT V;
+    FacesiT F;
+    compact_mesh(height_map, bounds, nbr_threads, V, F);
+    return make_pair(V, F);
+}
+
+pair<Eigen::MatrixXd, Eigen::MatrixXi> mesh_from_height_map(const SparseRaster& height_map)
+{
+    const int tile_size = SparseRaster::tile_size;
+    int rows = height_map.get_rows();
+    int cols = height_map.get_cols();
+    int tile_cols = (cols + tile_size - 1)/tile_size;
+    double res = height_map.get_resolution();
+
+    // vertex index of every cell in the allocated tiles, -1 for cells without data
+    vector<pair<int, int> > tiles = height_map.get_tiles();
+    vector<vector<int> > tile_vertices(size_t((rows + tile_size - 1)/tile_size)*size_t(tile_cols));
+    int nbr_vertices = 0;
+    for (const pair<int, int>& t : tiles) {
+        SparseRaster::ConstTileMaskT mask = height_map.tile_mask(t.first, t.second);
+        vector<int>& vertices = tile_vertices[size_t(t.first/tile_size)*size_t(tile_cols) + t.second/tile_size];
+        vertices.assign(tile_size*tile_size, -1);
+        for (int cell = 0; cell < tile_size*tile_size; ++cell) {
+            if (mask(cell/tile_size, cell%tile_size)) {
+                vertices[cell] = nbr_vertices++;
+            }
+        }
+    }
+    auto vertex = [&](int y, int x) {
+        if (y < 0 || y >= rows || x < 0 || x >= cols) {
+            return -1;
+        }
+        const vector<int>& vertices = tile_vertices[size_t(y/tile_size)*size_t(tile_cols) + x/tile_size];
+        return vertices.empty()? -1 : vertices[(y%tile_size)*tile_size + x%tile_size];
+    };
+
+    Eigen::MatrixXd V(nbr_vertices, 3);
+    Eigen::MatrixXi F(2*nbr_vertices, 3);
+    int face_counter = 0;
+    for (const pair<int, int>& t : tiles) {
+        SparseRaster::ConstTileValuesT values = height_map.tile_values(t.first, t.second);
+        for (int cell = 0; cell < tile_size*tile_size; ++cell) {
+            int y = t.first + cell/tile_size;
+            int x = t.second + cell%tile_size;
+            int v = vertex(y, x);
+            if (v == -1) {
+                continue;
+            }
+            V.row(v) << (double(x)+.5)*res, (double(y)+.5)*res, values(cell/tile_size, cell%tile_size);
+            int left = vertex(y, x-1);
+            int down = vertex(y-1, x);
+            if (left != -1 && down != -1) {
+                F.row(face_counter) << v, left, down;
+                ++face_counter;
+            }
+            int right = vertex(y, x+1);
+            int up = vertex(y+1, x);
+            if (right != -1 && up != -1) {
+                F.row(face_counter) << v, right, up;
+                ++face_counter;
+            }
+        }
+    }
+    F.conservativeResize(face_counter, 3);
+
+    return make_pair(V, F);
+}
+
 tuple<Eigen::MatrixXd, Eigen::MatrixXi, BoundsT> mesh_from_pings(const mbes_ping::PingsT& pings, double res)
 {
     Eigen::MatrixXd height_map;
@@ -132,8 +132,8 @@ void PatchDraper::handle_patches()
     Eigen::Vector3d origin_port;
     Eigen::Vector3d origin_stbd;
     tie(origin_port, origin_stbd) = get_port_stbd_sensor_origins(pings[i]);
-    Eigen::VectorXd times_left = compute_times(origin_port, hits_left);
-    Eigen::VectorXd times_right = compute_times(origin_stbd, hits_right);
+    Eigen::VectorXd times_left = compute_times(pings[i], origin_port, hits_left);
+    Eigen::VectorXd times_right = compute_times(pings[i], origin_stbd, hits_right);
 
     // compute the ground truth intensities
     Eigen::VectorXd intensities_left = compute_intensities(times_left, pings[i].port);
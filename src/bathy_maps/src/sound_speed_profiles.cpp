@@ -0,0 +1,129 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/sound_speed_profiles.h>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace csv_data;
+
+SoundSpeedProfiles::SoundSpeedProfiles(const csv_asvp_sound_speed::EntriesT& casts,
+                                       double time_scale, double distance_scale)
+    : time_scale(1000.*time_scale), distance_scale(distance_scale)
+{
+    for (const csv_asvp_sound_speed& cast : casts) {
+        if (cast.dbars.rows() == 0) {
+            continue;
+        }
+
+        // sort the samples from the top and down
+        vector<int> order(cast.dbars.rows());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return cast.dbars(a) < cast.dbars(b); });
+
+        profile p;
+        p.time_stamp = cast.time_stamp_;
+        p.lat = cast.lat_;
+        p.lon = cast.long_;
+        p.heights.resize(order.size());
+        p.speeds.resize(order.size());
+        for (int i = 0; i < int(order.size()); ++i) {
+            p.heights(i) = -cast.dbars(order[i]);
+            p.speeds(i) = cast.vels(order[i]);
+        }
+        p.harmonic_means.resize(order.size());
+        double slowness_sum = 0.;
+        for (int i = int(order.size())-1; i >= 0; --i) {
+            slowness_sum += 1./p.speeds(i);
+            p.harmonic_means(i) = double(order.size()-i)/slowness_sum;
+        }
+        profiles.push_back(p);
+    }
+
+    if (profiles.empty()) {
+        // no casts, use a constant nominal speed
+        profile p;
+        p.time_stamp = 0;
+        p.lat = p.lon = 0.;
+        p.heights = Eigen::VectorXd::Zero(1);
+        p.speeds = Eigen::VectorXd::Constant(1, 1500.);
+        p.harmonic_means = p.speeds;
+        profiles.push_back(p);
+    }
+
+    stable_sort(profiles.begin(), profiles.end(), [](const profile& a, const profile& b) {
+        return a.time_stamp < b.time_stamp;
+    });
+}
+
+double SoundSpeedProfiles::profile_cost(const profile& p, long long time_stamp, double lat, double lon) const
+{
+    // equirectangular approximation, the casts are never far apart
+    const double earth_radius = 6371000.;
+    double dlat = M_PI/180.*(p.lat - lat);
+    double dlon = M_PI/180.*(p.lon - lon)*cos(M_PI/180.*.5*(p.lat + lat));
+    double distance = earth_radius*sqrt(dlat*dlat + dlon*dlon);
+    return fabs(double(p.time_stamp - time_stamp))/time_scale + distance/distance_scale;
+}
+
+int SoundSpeedProfiles::select_profile(long long time_stamp, double lat, double lon) const
+{
+    // search outwards in time from the ping, the time part of
+    // the cost alone is a lower bound for the casts further away
+    int first_after = lower_bound(profiles.begin(), profiles.end(), time_stamp, [](const profile& p, long long t) {
+        return p.time_stamp < t;
+    }) - profiles.begin();
+
+    int best = -1;
+    double best_cost = numeric_limits<double>::infinity();
+    for (int i = first_after; i < int(profiles.size()); ++i) {
+        if (double(profiles[i].time_stamp - time_stamp)/time_scale >= best_cost) {
+            break;
+        }
+        double cost = profile_cost(profiles[i], time_stamp, lat, lon);
+        if (cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    for (int i = first_after-1; i >= 0; --i) {
+        if (double(time_stamp - profiles[i].time_stamp)/time_scale >= best_cost) {
+            break;
+        }
+        double cost = profile_cost(profiles[i], time_stamp, lat, lon);
+        if (cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+sound_speed_layers SoundSpeedProfiles::layers_below(int profile_index, double sensor_height) const
+{
+    const profile& p = profiles[profile_index];
+    int nbr_samples = p.heights.rows();
+
+    // first sample below the sensor, or the last sample if the sensor is below all of them
+    int i = upper_bound(p.heights.data(), p.heights.data() + nbr_samples, sensor_height, greater<double>()) - p.heights.data();
+    i = min(i, nbr_samples-1);
+
+    return sound_speed_layers(p.speeds.data() + i, p.heights.data() + i, nbr_samples - i, p.harmonic_means(i));
+}
+
+sound_speed_layers SoundSpeedProfiles::layers_below(const std_data::sss_ping& ping, double sensor_height) const
+{
+    return layers_below(select_profile(ping.time_stamp_, ping.lat_, ping.long_), sensor_height);
+}
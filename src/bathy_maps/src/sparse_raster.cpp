@@ -0,0 +1,207 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/sparse_raster.h>
+#include <iostream>
+#include <utility>
+
+using namespace std;
+
+template <typename ValueT>
+const int SparseRasterT<ValueT>::tile_size;
+
+template <typename ValueT>
+SparseRasterT<ValueT>::SparseRasterT(int rows, int cols, const BoundsT& bounds, ValueT nodata)
+    : rows(max(rows, 0)), cols(max(cols, 0)), bounds(bounds), nodata(nodata)
+{
+    tile_rows = (this->rows + tile_size - 1)/tile_size;
+    tile_cols = (this->cols + tile_size - 1)/tile_size;
+    tiles.resize(size_t(tile_rows)*size_t(tile_cols));
+}
+
+template <typename ValueT>
+SparseRasterT<ValueT>::SparseRasterT(const SparseRasterT& other)
+    : rows(other.rows), cols(other.cols), bounds(other.bounds), nodata(other.nodata),
+      tile_rows(other.tile_rows), tile_cols(other.tile_cols)
+{
+    tiles.resize(other.tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (other.tiles[i]) {
+            tiles[i].reset(new tile(*other.tiles[i]));
+        }
+    }
+}
+
+template <typename ValueT>
+SparseRasterT<ValueT>& SparseRasterT<ValueT>::operator=(const SparseRasterT& other)
+{
+    if (this != &other) {
+        SparseRasterT copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename ValueT>
+SparseRasterT<ValueT> SparseRasterT<ValueT>::from_dense(const Eigen::MatrixXd& dense, const BoundsT& bounds, ValueT nodata)
+{
+    SparseRasterT raster(dense.rows(), dense.cols(), bounds, nodata);
+    for (int row = 0; row < dense.rows(); ++row) {
+        for (int col = 0; col < dense.cols(); ++col) {
+            if (ValueT(dense(row, col)) != nodata) {
+                raster.set(row, col, dense(row, col));
+            }
+        }
+    }
+    return raster;
+}
+
+template <typename ValueT>
+Eigen::MatrixXd SparseRasterT<ValueT>::to_dense() const
+{
+    Eigen::MatrixXd dense = Eigen::MatrixXd::Constant(rows, cols, nodata);
+    for (const pair<int, int>& t : get_tiles()) {
+        ConstTileValuesT values = tile_values(t.first, t.second);
+        ConstTileMaskT mask = tile_mask(t.first, t.second);
+        int tile_rows = min(tile_size, rows - t.first);
+        int tile_cols = min(tile_size, cols - t.second);
+        for (int i = 0; i < tile_rows; ++i) {
+            for (int j = 0; j < tile_cols; ++j) {
+                if (mask(i, j)) {
+                    dense(t.first + i, t.second + j) = values(i, j);
+                }
+            }
+        }
+    }
+    return dense;
+}
+
+template <typename ValueT>
+typename SparseRasterT<ValueT>::tile& SparseRasterT<ValueT>::get_tile(int row, int col)
+{
+    unique_ptr<tile>& t = tiles[size_t(row/tile_size)*size_t(tile_cols) + col/tile_size];
+    if (!t) {
+        t.reset(new tile);
+        t->values.assign(tile_size*tile_size, nodata);
+        t->mask.assign(tile_size*tile_size, 0);
+    }
+    return *t;
+}
+
+template <typename ValueT>
+const typename SparseRasterT<ValueT>::tile* SparseRasterT<ValueT>::find_tile(int row, int col) const
+{
+    if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        return nullptr;
+    }
+    return tiles[size_t(row/tile_size)*size_t(tile_cols) + col/tile_size].get();
+}
+
+template <typename ValueT>
+bool SparseRasterT<ValueT>::is_valid(int row, int col) const
+{
+    const tile* t = find_tile(row, col);
+    return t != nullptr && t->mask[(row%tile_size)*tile_size + col%tile_size] != 0;
+}
+
+template <typename ValueT>
+ValueT SparseRasterT<ValueT>::get(int row, int col) const
+{
+    const tile* t = find_tile(row, col);
+    return t != nullptr? t->values[(row%tile_size)*tile_size + col%tile_size] : nodata;
+}
+
+template <typename ValueT>
+void SparseRasterT<ValueT>::set(int row, int col, ValueT value)
+{
+    if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        cout << "Cell " << row << ", " << col << " is outside the raster, not setting" << endl;
+        return;
+    }
+    tile& t = get_tile(row, col);
+    int cell = (row%tile_size)*tile_size + col%tile_size;
+    t.values[cell] = value;
+    t.mask[cell] = 1;
+}
+
+template <typename ValueT>
+void SparseRasterT<ValueT>::add(int row, int col, ValueT value)
+{
+    if (row < 0 || row >= rows || col < 0 || col >= cols) {
+        cout << "Cell " << row << ", " << col << " is outside the raster, not adding" << endl;
+        return;
+    }
+    tile& t = get_tile(row, col);
+    int cell = (row%tile_size)*tile_size + col%tile_size;
+    if (t.mask[cell] == 0) {
+        t.values[cell] = 0;
+        t.mask[cell] = 1;
+    }
+    t.values[cell] += value;
+}
+
+template <typename ValueT>
+vector<pair<int, int> > SparseRasterT<ValueT>::get_tiles() const
+{
+    vector<pair<int, int> > allocated;
+    for (int i = 0; i < tile_rows; ++i) {
+        for (int j = 0; j < tile_cols; ++j) {
+            if (tiles[size_t(i)*size_t(tile_cols) + j]) {
+                allocated.push_back(make_pair(i*tile_size, j*tile_size));
+            }
+        }
+    }
+    return allocated;
+}
+
+template <typename ValueT>
+int SparseRasterT<ValueT>::nbr_tiles() const
+{
+    int count = 0;
+    for (const unique_ptr<tile>& t : tiles) {
+        count += t? 1 : 0;
+    }
+    return count;
+}
+
+template <typename ValueT>
+size_t SparseRasterT<ValueT>::memory_bytes() const
+{
+    size_t tile_bytes = tile_size*tile_size*(sizeof(ValueT) + sizeof(unsigned char)) + sizeof(tile);
+    return tiles.size()*sizeof(unique_ptr<tile>) + size_t(nbr_tiles())*tile_bytes;
+}
+
+template <typename ValueT>
+typename SparseRasterT<ValueT>::TileValuesT SparseRasterT<ValueT>::tile_values(int row, int col)
+{
+    return TileValuesT(get_tile(row, col).values.data(), tile_size, tile_size);
+}
+
+template <typename ValueT>
+typename SparseRasterT<ValueT>::ConstTileValuesT SparseRasterT<ValueT>::tile_values(int row, int col) const
+{
+    return ConstTileValuesT(find_tile(row, col)->values.data(), tile_size, tile_size);
+}
+
+template <typename ValueT>
+typename SparseRasterT<ValueT>::TileMaskT SparseRasterT<ValueT>::tile_mask(int row, int col)
+{
+    return TileMaskT(get_tile(row, col).mask.data(), tile_size, tile_size);
+}
+
+template <typename ValueT>
+typename SparseRasterT<ValueT>::ConstTileMaskT SparseRasterT<ValueT>::tile_mask(int row, int col) const
+{
+    return ConstTileMaskT(find_tile(row, col)->mask.data(), tile_size, tile_size);
+}
+
+template class SparseRasterT<float>;
+template class SparseRasterT<double>;
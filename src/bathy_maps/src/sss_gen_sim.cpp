@@ -432,8 +432,8 @@ bool SSSGenSim::callback_pre_draw(igl::opengl::glfw::Viewer& viewer)
     Eigen::Vector3d origin_port;
     Eigen::Vector3d origin_stbd;
     tie(origin_port, origin_stbd) = get_port_stbd_sensor_origins(pings[i]);
-    Eigen::VectorXd times_left = compute_times(origin_port, hits_left);
-    Eigen::VectorXd times_right = compute_times(origin_stbd, hits_right);
+    Eigen::VectorXd times_left = compute_times(pings[i], origin_port, hits_left);
+    Eigen::VectorXd times_right = compute_times(pings[i], origin_stbd, hits_right);
 
     // compute the intensity values for vis
     Eigen::VectorXd gt_intensities_left = compute_intensities(times_left, pings[i].port);
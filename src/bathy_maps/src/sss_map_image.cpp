@@ -17,16 +17,13 @@
 using namespace std;
 
 sss_map_image_builder::sss_map_image_builder(const sss_map_image::BoundsT& bounds, double resolution, int nbr_pings) : 
-    bounds(bounds), resolution(resolution), waterfall_width(2*nbr_pings), waterfall_counter(0)
+    bounds(bounds), resolution(resolution),
+    image_rows(resolution*(bounds(1, 1) - bounds(0, 1))), image_cols(resolution*(bounds(1, 0) - bounds(0, 0))),
+    sss_map_image_sums(image_rows, image_cols, bounds), sss_map_image_counts(image_rows, image_cols, bounds),
+    waterfall_width(2*nbr_pings), waterfall_counter(0)
 {
     global_origin = Eigen::Vector3d(bounds(0, 0), bounds(0, 1), 0.);
 
-    image_cols = resolution*(bounds(1, 0) - bounds(0, 0));
-    image_rows = resolution*(bounds(1, 1) - bounds(0, 1));
-
-    sss_map_image_counts = Eigen::MatrixXd::Zero(image_rows, image_cols);
-    sss_map_image_sums = Eigen::MatrixXd::Zero(image_rows, image_cols);
-
     sss_waterfall_image = Eigen::MatrixXd::Zero(2000, waterfall_width);
     sss_waterfall_cross_track = Eigen::MatrixXd::Zero(2000, waterfall_width);
     sss_waterfall_depth = Eigen::MatrixXd::Zero(2000, waterfall_width);
@@ -45,7 +42,7 @@ size_t sss_map_image_builder::get_waterfall_bins()
 
 bool sss_map_image_builder::empty()
 {
-    return sss_map_image_counts.sum() == 0;
+    return sss_map_image_counts.empty();
 }
 
 Eigen::MatrixXd sss_map_image_builder::downsample_cols(const Eigen::MatrixXd& M, int new_cols)
@@ -79,9 +76,25 @@ sss_map_image sss_map_image_builder::finish()
 {
     sss_map_image map_image;
     map_image.bounds = bounds;
-    if (sss_map_image_counts.sum() > 0) {
-        sss_map_image_counts.array() += (sss_map_image_counts.array() == 0).cast<double>();
-        map_image.sss_map_image_.array() = sss_map_image_sums.array() / sss_map_image_counts.array();
+    if (!sss_map_image_counts.empty()) {
+        map_image.sss_map_image_ = Eigen::MatrixXd::Zero(image_rows, image_cols);
+        // the sums and counts are written together, so they have the same tiles
+        const SparseRasterd& image_sums = sss_map_image_sums;
+        const SparseRasterd& image_counts = sss_map_image_counts;
+        for (const pair<int, int>& t : image_counts.get_tiles()) {
+            SparseRasterd::ConstTileValuesT sums = image_sums.tile_values(t.first, t.second);
+            SparseRasterd::ConstTileValuesT counts = image_counts.tile_values(t.first, t.second);
+            SparseRasterd::ConstTileMaskT mask = image_counts.tile_mask(t.first, t.second);
+            int tile_rows = min(SparseRasterd::tile_size, image_rows - t.first);
+            int tile_cols = min(SparseRasterd::tile_size, image_cols - t.second);
+            for (int i = 0; i < tile_rows; ++i) {
+                for (int j = 0; j < tile_cols; ++j) {
+                    if (mask(i, j)) {
+                        map_image.sss_map_image_(t.first + i, t.second + j) = sums(i, j) / counts(i, j);
+                    }
+                }
+            }
+        }
     }
     map_image.sss_ping_duration = sss_ping_duration;
     map_image.pos = poss;
@@ -162,8 +175,8 @@ void sss_map_image_builder::add_hits(const Eigen::MatrixXd& hits, const Eigen::V
         int x = int(points(i, 0));
         int y = int(points(i, 1));
         if (x >= 0 && x < image_cols && y >= 0 && y < image_rows) {
-            sss_map_image_sums(y, x) += intensities(i);
-            sss_map_image_counts(y, x) += 1.;
+            sss_map_image_sums.add(y, x, intensities(i));
+            sss_map_image_counts.add(y, x, 1.);
             ++inside_image;
         }
     }
@@ -211,8 +224,8 @@ void sss_map_image_builder::add_hits(const Eigen::MatrixXd& hits, const Eigen::V
         int x = int(points(i, 0));
         int y = int(points(i, 1));
         if (x >= 0 && x < image_cols && y >= 0 && y < image_rows) {
-            sss_map_image_sums(y, x) += intensities(i);
-            sss_map_image_counts(y, x) += 1.;
+            sss_map_image_sums.add(y, x, intensities(i));
+            sss_map_image_counts.add(y, x, 1.);
             ++inside_image;
         }
     }
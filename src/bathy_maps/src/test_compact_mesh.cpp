@@ -0,0 +1,71 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/mesh_map.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+// the compact meshes of a diagonal survey strip with holes should have the faces of
+// mesh_from_height_map, with remapped but identical vertices, and no unused vertices
+int main(int argc, char** argv)
+{
+    const int rows = 300;
+    const int cols = 400;
+
+    // zero is missing data
+    mt19937 generator(3);
+    uniform_real_distribution<double> uniform(0., 1.);
+    Eigen::MatrixXd height_map = Eigen::MatrixXd::Zero(rows, cols);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            if (fabs(double(y) - .7*double(x)) < 30. && uniform(generator) > .02) {
+                height_map(y, x) = -20. - uniform(generator);
+            }
+        }
+    }
+    mesh_map::BoundsT bounds;
+    bounds << 0., 0., .5*double(cols), .5*double(rows);
+
+    Eigen::MatrixXd V, V_compact;
+    Eigen::MatrixXi F, F_compact;
+    mesh_map::VerticesfT V_float;
+    mesh_map::FacesiT F_float;
+    tie(V, F) = mesh_map::mesh_from_height_map(height_map, bounds);
+    tie(V_compact, F_compact) = mesh_map::compact_mesh_from_height_map(height_map, bounds, 4);
+    tie(V_float, F_float) = mesh_map::compact_float_mesh_from_height_map(height_map, bounds, 4);
+
+    if (F_compact.rows() != F.rows() || F_float.rows() != F.rows() || V_float.rows() != V_compact.rows()) {
+        cout << "Compact meshes have " << F_compact.rows() << " and " << F_float.rows() << " faces, expected " << F.rows() << endl;
+        return 1;
+    }
+
+    vector<bool> used(V_compact.rows(), false);
+    for (int i = 0; i < F.rows(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            used[F_compact(i, j)] = true;
+            if (F_float(i, j) != F_compact(i, j) || V.row(F(i, j)) != V_compact.row(F_compact(i, j)) ||
+                V.row(F(i, j)).cast<float>() != V_float.row(F_float(i, j))) {
+                cout << "Face " << i << " differs from mesh_from_height_map" << endl;
+                return 1;
+            }
+        }
+    }
+    if (find(used.begin(), used.end(), false) != used.end()) {
+        cout << "Compact mesh has unused vertices" << endl;
+        return 1;
+    }
+
+    return 0;
+}
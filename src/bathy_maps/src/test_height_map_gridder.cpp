@@ -0,0 +1,92 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bathy_maps/height_map_gridder.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+
+using namespace std;
+
+// grids random soundings with one and with eight threads, both should give identical
+// layers, and the exact layers should match brute force per cell statistics
+int main(int argc, char** argv)
+{
+    const int nbr_points = 200000;
+    const double res = 1.;
+
+    // a sloping seafloor with noise
+    mt19937 generator(3);
+    normal_distribution<double> noise(0., .3);
+    uniform_real_distribution<double> uniform(0., 1.);
+    Eigen::MatrixXd points(nbr_points, 3);
+    for (int i = 0; i < nbr_points; ++i) {
+        points(i, 0) = -50. + 300.*uniform(generator);
+        points(i, 1) = 1000. + 200.*uniform(generator);
+        points(i, 2) = -20. + .01*points(i, 0) + noise(generator);
+    }
+
+    // added in two batches, to also cover growing the grid
+    HeightMapGridder single(res, HeightMapGridder::ALL_LAYERS, 1);
+    HeightMapGridder multi(res, HeightMapGridder::ALL_LAYERS, 8);
+    for (HeightMapGridder* gridder : { &single, &multi }) {
+        gridder->add_points(points.topRows(nbr_points/2));
+        gridder->add_points(points.bottomRows(nbr_points - nbr_points/2));
+    }
+
+    int nbr_failed = 0;
+    const HeightMapGridder::Layers layers[] = { HeightMapGridder::MEAN, HeightMapGridder::MIN, HeightMapGridder::MAX,
+                                                HeightMapGridder::MEDIAN, HeightMapGridder::VARIANCE };
+    for (HeightMapGridder::Layers layer : layers) {
+        if (single.get_layer(layer) != multi.get_layer(layer)) {
+            cout << "Layer " << layer << " differs between 1 and 8 threads" << endl;
+            ++nbr_failed;
+        }
+    }
+
+    map<pair<int, int>, vector<double> > cells;
+    for (int i = 0; i < nbr_points; ++i) {
+        cells[make_pair(int(floor(points(i, 1)/res)), int(floor(points(i, 0)/res)))].push_back(points(i, 2));
+    }
+
+    Eigen::MatrixXd means = single.get_layer(HeightMapGridder::MEAN);
+    Eigen::MatrixXd mins = single.get_layer(HeightMapGridder::MIN);
+    Eigen::MatrixXd maxs = single.get_layer(HeightMapGridder::MAX);
+    Eigen::MatrixXd variances = single.get_layer(HeightMapGridder::VARIANCE);
+    int row0 = int(floor(single.get_bounds()(0, 1)/res));
+    int col0 = int(floor(single.get_bounds()(0, 0)/res));
+    for (auto& cell : cells) {
+        vector<double>& heights = cell.second;
+        int row = cell.first.first - row0;
+        int col = cell.first.second - col0;
+        double mean = 0.;
+        for (double height : heights) {
+            mean += height;
+        }
+        mean /= double(heights.size());
+        double variance = 0.;
+        for (double height : heights) {
+            variance += (height - mean)*(height - mean);
+        }
+        variance = heights.size() > 1? variance/double(heights.size() - 1) : variances(row, col);
+        // min and max are stored in float
+        if (fabs(means(row, col) - mean) > 1e-9 || fabs(variances(row, col) - variance) > 1e-9 ||
+            fabs(mins(row, col) - *min_element(heights.begin(), heights.end())) > 1e-4 ||
+            fabs(maxs(row, col) - *max_element(heights.begin(), heights.end())) > 1e-4) {
+            cout << "Cell " << row << ", " << col << " does not match the brute force statistics" << endl;
+            ++nbr_failed;
+        }
+    }
+
+    return nbr_failed == 0? 0 : 1;
+}
@@ -14,6 +14,7 @@
 
 #include <data_tools/navi_data.h>
 #include <data_tools/csv_data.h>
+#include <data_tools/datagram_index.h>
 #include <Eigen/Dense>
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem.hpp>
@@ -147,8 +148,41 @@ struct all_echosounder_depth {
 
 };
 
+// all datagram types that we know how to decode, demultiplexed in one pass over the files
+struct all_datagrams {
+
+    all_mbes_ping::PingsT mbes_pings;
+    all_nav_entry::EntriesT nav_entries;
+    all_nav_depth::EntriesT nav_depths;
+    all_nav_attitude::EntriesT nav_attitudes;
+    all_echosounder_depth::EntriesT echosounder_depths;
+
+	template <class Archive>
+    void serialize( Archive & ar )
+    {
+        ar(CEREAL_NVP(mbes_pings), CEREAL_NVP(nav_entries), CEREAL_NVP(nav_depths),
+           CEREAL_NVP(nav_attitudes), CEREAL_NVP(echosounder_depths));
+    }
+
+};
+
+// read all of the datagram types above with one sequential read of the file,
+// instead of one parse_file<T> call (and one pass over the file) per type
+all_datagrams parse_datagrams_file(const boost::filesystem::path& file);
+// parses the files with nbr_threads threads, or one thread per core if nbr_threads <= 0
+all_datagrams parse_datagrams_folder(const boost::filesystem::path& folder, int nbr_threads = 1);
+
+// index of all datagrams in the file, with the .all datagram codes (e.g. 88 for xyz88) as types
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file);
+
+// only decode the datagrams within [start_time, end_time] with one of the codes
+// in types (all decodable types if empty), seeking to them using the file index
+all_datagrams parse_datagrams_file(const boost::filesystem::path& file, long long start_time, long long end_time,
+                                   const std::vector<int>& types = std::vector<int>());
+
 std_data::mbes_ping::PingsT convert_matched_entries(all_mbes_ping::PingsT& pings, all_nav_entry::EntriesT& entries);
 std_data::mbes_ping::PingsT match_attitude(std_data::mbes_ping::PingsT& pings, all_nav_attitude::EntriesT& entries);
+void match_attitude_in_place(std_data::mbes_ping::PingsT& pings, all_nav_attitude::EntriesT& entries);
 csv_data::csv_asvp_sound_speed::EntriesT convert_sound_speeds(const all_mbes_ping::PingsT& pings);
 std_data::attitude_entry::EntriesT convert_attitudes(const all_nav_attitude::EntriesT& attitudes);
 
@@ -157,6 +191,12 @@ private:
 
     std::function<void(all_mbes_ping)> mbes_callback;
     std::function<void(all_nav_entry)> nav_entry_callback;
+    std::function<void(all_nav_depth)> nav_depth_callback;
+    std::function<void(all_nav_attitude)> nav_attitude_callback;
+    std::function<void(all_echosounder_depth)> echosounder_depth_callback;
+
+    // decode the datagram body following the type byte, returns false if no callback is set for the type
+    bool parse_datagram(std::istream& input, unsigned char data_type);
 
 public:
 
@@ -164,6 +204,14 @@ public:
 
     bool parse_packet(const std::string& packet_load);
 
+    // walk all the datagrams in the stream once, calling the callbacks for the types that have one set
+    // returns false at the first datagram that does not start with STX, which means the stream is corrupt
+    bool parse_stream(std::istream& input);
+
+    // seek to and parse only the datagrams in entries, as given by the file index
+    // returns false if a datagram does not start with STX and the type in its entry, i.e. the index is stale
+    bool parse_indexed_datagrams(std::istream& input, const std_data::datagram_index::EntriesT& entries);
+
     void set_mbes_callback(const std::function<void(all_mbes_ping)>& callback)
     {
         mbes_callback = callback;
@@ -174,6 +222,21 @@ public:
         nav_entry_callback = callback;
     }
 
+    void set_nav_depth_callback(const std::function<void(all_nav_depth)>& callback)
+    {
+        nav_depth_callback = callback;
+    }
+
+    void set_nav_attitude_callback(const std::function<void(all_nav_attitude)>& callback)
+    {
+        nav_attitude_callback = callback;
+    }
+
+    void set_echosounder_depth_callback(const std::function<void(all_echosounder_depth)>& callback)
+    {
+        echosounder_depth_callback = callback;
+    }
+
 };
 
 } // namespace all_data
@@ -198,6 +261,36 @@ all_data::all_nav_attitude::EntriesT parse_file(const boost::filesystem::path& f
 template <>
 all_data::all_echosounder_depth::EntriesT parse_file(const boost::filesystem::path& file);
 
+template <>
+all_data::all_mbes_ping::PingsT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+all_data::all_nav_entry::EntriesT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+all_data::all_nav_depth::EntriesT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+all_data::all_nav_attitude::EntriesT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+all_data::all_echosounder_depth::EntriesT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+void parse_file_batches<all_data::all_mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_data::all_mbes_ping>::CallbackT& callback);
+
+template <>
+void parse_file_batches<all_data::all_nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_data::all_nav_entry>::CallbackT& callback);
+
+template <>
+void parse_file_batches<all_data::all_nav_depth>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_data::all_nav_depth>::CallbackT& callback);
+
+template <>
+void parse_file_batches<all_data::all_nav_attitude>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_data::all_nav_attitude>::CallbackT& callback);
+
+template <>
+void parse_file_batches<all_data::all_echosounder_depth>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_data::all_echosounder_depth>::CallbackT& callback);
+
 }
 
 #endif // ALL_DATA_H
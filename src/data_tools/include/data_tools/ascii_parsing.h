@@ -0,0 +1,152 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASCII_PARSING_H
+#define ASCII_PARSING_H
+
+#include <cstdint>
+#include <cmath>
+
+// locale independent parsing of numbers directly from character buffers,
+// for the ascii formats where istringstream and stod dominate the parse time
+namespace ascii_parsing {
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool is_separator(char c)
+{
+    return c == ' ' || c == ',' || c == '\t' || c == ';' || c == '\r';
+}
+
+inline void skip_separators(const char*& p, const char* end)
+{
+    while (p != end && is_separator(*p)) {
+        ++p;
+    }
+}
+
+// parses numbers like -123.456e-7, returns false if p does not point to a number
+inline bool parse_number(const char*& p, const char* end, double& value)
+{
+    static const double exact_powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    // keep at most 19 significant digits, which always fit in 64 bits
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool found_digit = false;
+    for (; p != end && is_digit(*p); ++p) {
+        found_digit = true;
+        if (digits < 19) {
+            mantissa = 10*mantissa + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    if (p != end && *p == '.') {
+        ++p;
+        for (; p != end && is_digit(*p); ++p) {
+            found_digit = true;
+            if (digits < 19) {
+                mantissa = 10*mantissa + (*p - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    if (!found_digit) {
+        return false;
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q != end && (*q == '-' || *q == '+')) {
+            negative_exponent = *q == '-';
+            ++q;
+        }
+        if (q != end && is_digit(*q)) {
+            int e = 0;
+            for (; q != end && is_digit(*q); ++q) {
+                if (e < 10000) {
+                    e = 10*e + (*q - '0');
+                }
+            }
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // exact when both the mantissa and the power of ten are representable, as for typical coordinates
+    double v = double(mantissa);
+    if (mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        v = exponent < 0 ? v / exact_powers_of_ten[-exponent] : v * exact_powers_of_ten[exponent];
+    }
+    else if (exponent != 0) {
+        v *= std::pow(10.0, exponent);
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// parses an optionally signed integer, returns false if p does not point to one
+inline bool parse_int(const char*& p, const char* end, int& value)
+{
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p == end || !is_digit(*p)) {
+        return false;
+    }
+    int v = 0;
+    for (; p != end && is_digit(*p); ++p) {
+        v = 10*v + (*p - '0');
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+// parses exactly nbr_digits digits, as in fixed width date fields like 0612
+inline bool parse_digits(const char*& p, const char* end, int nbr_digits, int& value)
+{
+    if (end - p < nbr_digits) {
+        return false;
+    }
+    int v = 0;
+    for (int i = 0; i < nbr_digits; ++i, ++p) {
+        if (!is_digit(*p)) {
+            return false;
+        }
+        v = 10*v + (*p - '0');
+    }
+    value = v;
+    return true;
+}
+
+} // namespace ascii_parsing
+
+#endif // ASCII_PARSING_H
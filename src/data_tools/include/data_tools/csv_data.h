@@ -77,6 +77,7 @@ struct csv_asvp_sound_speed
 };
 
 std_data::sss_ping::PingsT convert_matched_entries(std_data::sss_ping::PingsT& pings, csv_data::csv_nav_entry::EntriesT& entries);
+void convert_matched_entries_in_place(std_data::sss_ping::PingsT& pings, csv_data::csv_nav_entry::EntriesT& entries);
 
 } // namespace csv_data
 
@@ -85,6 +86,9 @@ namespace std_data {
 template <>
 csv_data::csv_nav_entry::EntriesT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<csv_data::csv_nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<csv_data::csv_nav_entry>::CallbackT& callback);
+
 template <>
 csv_data::csv_asvp_sound_speed::EntriesT parse_file(const boost::filesystem::path& file);
 
@@ -0,0 +1,80 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DATAGRAM_INDEX_H
+#define DATAGRAM_INDEX_H
+
+#include <data_tools/std_data.h>
+#include <functional>
+
+namespace std_data {
+
+// location of one record within a .all, .xtf or .jsf file
+struct datagram_index_entry
+{
+    long long time_stamp_; // posix time stamp, from the last timed record if this type has no time
+    int type; // format specific datagram type code, e.g. 88 for .all xyz88
+    unsigned long long offset; // byte offset of the start of the record in the file
+    unsigned int length; // total number of bytes in the record
+
+	template <class Archive>
+    void serialize( Archive & ar )
+    {
+        ar(CEREAL_NVP(time_stamp_), CEREAL_NVP(type), CEREAL_NVP(offset), CEREAL_NVP(length));
+    }
+};
+
+struct datagram_index
+{
+    using EntriesT = std::vector<datagram_index_entry>;
+
+    unsigned long long file_size; // size of the indexed file, to check if the index is stale
+    long long file_time; // last write time of the indexed file
+    EntriesT entries; // all records, in file order
+
+	template <class Archive>
+    void serialize( Archive & ar )
+    {
+        ar(CEREAL_NVP(file_size), CEREAL_NVP(file_time), CEREAL_NVP(entries));
+    }
+
+    // records of one of types (any type if empty) with start_time <= time_stamp_ <= end_time, in file order
+    EntriesT filter(long long start_time, long long end_time, const std::vector<int>& types = std::vector<int>()) const;
+};
+
+using build_index_function = std::function<datagram_index(const boost::filesystem::path&)>;
+
+// the sidecar file next to the data file, e.g. data.all.index
+boost::filesystem::path datagram_index_path(const boost::filesystem::path& file);
+
+// reads the sidecar index if it is up to date with the file, otherwise
+// builds it with build_index and writes it next to the file. with rebuild,
+// the sidecar is always rebuilt, e.g. when it did not match the file contents
+datagram_index load_or_build_datagram_index(const boost::filesystem::path& file, const build_index_function& build_index, bool rebuild = false);
+
+// like parse_file, but only decodes the records with time stamps within [start_time, end_time],
+// seeking to them directly using the datagram index of the file
+template <typename T>
+std::vector<T, Eigen::aligned_allocator<T> > parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    std::vector<T, Eigen::aligned_allocator<T> > rtn;
+    return rtn;
+}
+
+template <typename T>
+std::vector<T, Eigen::aligned_allocator<T> > parse_file_time_range_from_str(const std::string& file, long long start_time, long long end_time)
+{
+    return parse_file_time_range<T>(boost::filesystem::path(file), start_time, end_time);
+}
+
+} // namespace std_data
+
+#endif // DATAGRAM_INDEX_H
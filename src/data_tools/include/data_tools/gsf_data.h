@@ -116,6 +116,9 @@ gsf_data::gsf_sound_speed::SpeedsT parse_file(const boost::filesystem::path& fil
 template <>
 gsf_data::gsf_mbes_ping::PingsT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<gsf_data::gsf_mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<gsf_data::gsf_mbes_ping>::CallbackT& callback);
+
 }
 
 #endif // GSF_DATA_H
@@ -13,6 +13,7 @@
 #define JSF_DATA_H
 
 #include <data_tools/std_data.h>
+#include <data_tools/datagram_index.h>
 //#include <data_tools/xtf_data.h>
 #include <libjsf/jsf.h>
 #include <Eigen/Dense>
@@ -106,6 +107,20 @@ void show_waterfall_image(const jsf_sss_ping::PingsT& pings);
 jsf_sss_ping::PingsT filter_frequency(const jsf_sss_ping::PingsT& pings, int desired_freq);
 std_data::sss_ping::PingsT convert_to_xtf_pings(const jsf_sss_ping::PingsT& pings);
 
+// same output as std_data::parse_file, but memory maps the file and decodes the messages
+// in parallel, using nbr_threads threads or one thread per core if nbr_threads <= 0
+template <typename T>
+std::vector<T, Eigen::aligned_allocator<T> > parse_mapped_file(const boost::filesystem::path& file, int nbr_threads = 0);
+
+template <>
+jsf_sss_ping::PingsT parse_mapped_file(const boost::filesystem::path& file, int nbr_threads);
+
+template <>
+jsf_dvl_ping::PingsT parse_mapped_file(const boost::filesystem::path& file, int nbr_threads);
+
+// index of all messages in the file, with the jsf message types (e.g. 80 for sonar data) as types
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file);
+
 
 } // namespace jsf_data
 
@@ -117,6 +132,18 @@ jsf_data::jsf_sss_ping::PingsT parse_file(const boost::filesystem::path& file);
 template <>
 jsf_data::jsf_dvl_ping::PingsT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<jsf_data::jsf_sss_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<jsf_data::jsf_sss_ping>::CallbackT& callback);
+
+template <>
+void parse_file_batches<jsf_data::jsf_dvl_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<jsf_data::jsf_dvl_ping>::CallbackT& callback);
+
+template <>
+jsf_data::jsf_sss_ping::PingsT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
+template <>
+jsf_data::jsf_dvl_ping::PingsT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
 }
 
 #endif // JSF_DATA_H
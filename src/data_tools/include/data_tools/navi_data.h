@@ -40,9 +40,15 @@ namespace std_data {
 template <>
 mbes_ping::PingsT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<mbes_ping>::CallbackT& callback);
+
 template <>
 nav_entry::EntriesT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<nav_entry>::CallbackT& callback);
+
 }
 
 #endif // NAVI_DATA_H
@@ -0,0 +1,109 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PING_CACHE_H
+#define PING_CACHE_H
+
+#include <data_tools/std_data.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+
+namespace std_data {
+
+// layout of a columnar mbes ping cache file. all sections start at 64 byte
+// aligned offsets from the start of the file and are stored in native byte order
+struct ping_cache_header
+{
+    char magic[8]; // "MBESPING"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t nbr_pings;
+    uint64_t nbr_beams;
+    uint64_t nbr_back_scatter;
+    uint64_t beam_offsets; // nbr_pings + 1 uint64, index of the first beam of each ping
+    uint64_t back_scatter_offsets; // nbr_pings + 1 uint64, index of the first back scatter value of each ping
+    uint64_t ids; // nbr_pings uint32
+    uint64_t time_stamps; // nbr_pings int64
+    uint64_t first_in_file; // nbr_pings uint8
+    uint64_t poses; // nbr_pings x 3 float64, row-major
+    uint64_t attitudes; // nbr_pings x 4 float64, row-major heading, heave, pitch, roll
+    uint64_t beams; // nbr_beams x 3 float64, row-major
+    uint64_t back_scatter; // nbr_back_scatter float64
+};
+
+// writes pings to a columnar cache file that can be opened with mapped_pings,
+// time_string_ is not stored and is recreated from time_stamp_ when needed
+void write_ping_cache(const mbes_ping::PingsT& pings, const boost::filesystem::path& path);
+
+// view of a single ping in a mapped_pings, the arrays point directly into the mapped file
+struct mbes_ping_view
+{
+    using BeamsT = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> >;
+
+    unsigned int id_;
+    long long time_stamp_;
+    double heading_;
+    double heave_;
+    double pitch_;
+    double roll_;
+    bool first_in_file_;
+    Eigen::Map<const Eigen::Vector3d> pos_;
+    BeamsT beams;
+    Eigen::Map<const Eigen::VectorXd> back_scatter;
+
+    std::string time_string() const;
+    mbes_ping to_ping() const; // copies the view into a regular mbes_ping
+};
+
+// read-only memory mapped ping cache, opening it only maps the file, so it is
+// instantaneous and the data is shared through the page cache between processes
+class mapped_pings
+{
+public:
+
+    template <typename T, int Cols>
+    using ColumnsT = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Cols, Cols == 1 ? Eigen::ColMajor : Eigen::RowMajor> >;
+
+    explicit mapped_pings(const boost::filesystem::path& path);
+
+    size_t size() const { return nbr_pings; }
+    bool empty() const { return nbr_pings == 0; }
+    mbes_ping_view operator[](size_t i) const;
+
+    // columns for all of the pings
+    ColumnsT<double, 3> beams() const;
+    ColumnsT<double, 1> back_scatter() const;
+    ColumnsT<uint64_t, 1> beam_offsets() const;
+    ColumnsT<long long, 1> time_stamps() const;
+    ColumnsT<double, 3> poses() const;
+    ColumnsT<double, 4> attitudes() const;
+
+    mbes_ping::PingsT to_pings() const; // copies all pings into a regular PingsT
+
+private:
+
+    template <typename T>
+    const T* section(uint64_t offset) const
+    {
+        return reinterpret_cast<const T*>(data + offset);
+    }
+
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    const char* data;
+    size_t nbr_pings;
+    ping_cache_header header;
+};
+
+} // namespace std_data
+
+#endif // PING_CACHE_H
@@ -0,0 +1,135 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SSS_STORE_H
+#define SSS_STORE_H
+
+#include <data_tools/std_data.h>
+#include <cstdint>
+#include <algorithm>
+
+namespace std_data {
+
+// the sidescan intensities are delta coded along range, zigzag mapped to unsigned
+// and written as little endian base 128 varints, so that the slowly varying 16 bit
+// samples mostly take one or two bytes. this is lossless for any int sample
+namespace sss_codec {
+
+inline void encode_samples(const std::vector<int>& samples, std::vector<uint8_t>& data)
+{
+    int32_t previous = 0;
+    for (int sample : samples) {
+        uint32_t delta = uint32_t(sample) - uint32_t(previous);
+        uint32_t zigzag = (delta << 1) ^ uint32_t(-int32_t(delta >> 31));
+        while (zigzag >= 0x80) {
+            data.push_back(uint8_t(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        data.push_back(uint8_t(zigzag));
+        previous = sample;
+    }
+}
+
+// decodes n samples starting at p into samples, returns the position after the last one,
+// or nullptr if the data ends at end or holds a varint longer than 32 bits before that
+inline const uint8_t* decode_samples(const uint8_t* p, const uint8_t* end, int* samples, size_t n)
+{
+    uint32_t previous = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (p == end) {
+            return nullptr;
+        }
+        uint32_t zigzag = *p & 0x7f;
+        int shift = 7;
+        while (*p++ & 0x80) {
+            if (p == end || shift > 28) {
+                return nullptr;
+            }
+            zigzag |= uint32_t(*p & 0x7f) << shift;
+            shift += 7;
+        }
+        previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+        samples[i] = int32_t(previous);
+    }
+    return p;
+}
+
+} // namespace sss_codec
+
+// a run of consecutive sss_pings with their intensities compressed together
+struct sss_ping_chunk
+{
+    sss_ping::PingsT pings; // the pings with empty port and stbd intensities
+    std::vector<uint32_t> port_sizes; // number of port samples of each ping
+    std::vector<uint32_t> stbd_sizes; // number of stbd samples of each ping
+    std::vector<uint8_t> data; // port followed by stbd samples of each ping in turn
+
+	template <class Archive>
+    void serialize( Archive & ar )
+    {
+        ar(CEREAL_NVP(pings), CEREAL_NVP(port_sizes), CEREAL_NVP(stbd_sizes), CEREAL_NVP(data));
+    }
+
+    static sss_ping_chunk compress(sss_ping::PingsT::const_iterator begin, sss_ping::PingsT::const_iterator end);
+    bool decompress(sss_ping::PingsT& decompressed) const; // false if the data is corrupt
+
+    // calls function(i, ping, port, stbd) for each of the first nbr_pings pings i in the chunk, with the
+    // intensities decoded into std::vector<int> buffers that are reused between the pings, without
+    // building any sss_ping. returns false if the data is corrupt, after calling function for the pings before
+    template <typename Function>
+    bool for_each_ping(const Function& function, size_t nbr_pings = size_t(-1)) const
+    {
+        std::vector<int> port;
+        std::vector<int> stbd;
+        const uint8_t* p = data.data();
+        const uint8_t* end = p + data.size();
+        for (size_t i = 0; i < std::min(nbr_pings, pings.size()); ++i) {
+            port.resize(port_sizes[i]);
+            stbd.resize(stbd_sizes[i]);
+            p = sss_codec::decode_samples(p, end, port.data(), port.size());
+            if (p == nullptr) {
+                return false;
+            }
+            p = sss_codec::decode_samples(p, end, stbd.data(), stbd.size());
+            if (p == nullptr) {
+                return false;
+            }
+            function(i, pings[i], port, stbd);
+        }
+        return true;
+    }
+};
+
+// sss_ping::PingsT stored as independently compressed chunks, which allows
+// random access to single pings and decompressing the chunks in parallel
+struct compressed_sss_pings
+{
+    int pings_per_chunk;
+    std::vector<sss_ping_chunk> chunks;
+
+	template <class Archive>
+    void serialize( Archive & ar )
+    {
+        ar(CEREAL_NVP(pings_per_chunk), CEREAL_NVP(chunks));
+    }
+
+    size_t size() const;
+    sss_ping ping(size_t i) const; // only decompresses the chunk containing ping i
+    // decompresses all chunks, returns false and no pings if any chunk is corrupt
+    bool decompress(sss_ping::PingsT& decompressed, int nbr_threads = 0) const;
+};
+
+// compresses pings in chunks of pings_per_chunk, using nbr_threads threads (one per core if 0)
+compressed_sss_pings compress_sss_pings(const sss_ping::PingsT& pings, int pings_per_chunk = 256, int nbr_threads = 0);
+
+} // namespace std_data
+
+#endif // SSS_STORE_H
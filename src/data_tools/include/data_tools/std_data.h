@@ -13,6 +13,11 @@
 #define DATA_STRUCTURES_H
 
 #include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <iterator>
+#include <functional>
 #include <Eigen/Dense>
 #include <eigen_cereal/eigen_cereal.h>
 #include <cereal/archives/binary.hpp>
@@ -182,6 +187,36 @@ struct pt_submaps
     }
 };
 
+// calls function(i) for all i in [0, n), spread over nbr_threads threads, or one thread per core if nbr_threads <= 0
+template <typename Function>
+void parallel_for(int n, int nbr_threads, const Function& function)
+{
+    if (nbr_threads <= 0) {
+        nbr_threads = std::max(int(std::thread::hardware_concurrency()), 1);
+    }
+    nbr_threads = std::min(nbr_threads, n);
+    if (nbr_threads <= 1) {
+        for (int i = 0; i < n; ++i) {
+            function(i);
+        }
+        return;
+    }
+
+    // the threads pick the next index when done, since the work per index may vary a lot
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int j = 0; j < nbr_threads; ++j) {
+        threads.emplace_back([&]() {
+            for (int i = next++; i < n; i = next++) {
+                function(i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
 template <typename T>
 std::vector<T, Eigen::aligned_allocator<T> > parse_file(const boost::filesystem::path& file)
 {
@@ -195,10 +230,33 @@ std::vector<T, Eigen::aligned_allocator<T> > parse_file_from_str(const std::stri
     return parse_file<T>(boost::filesystem::path(file));
 }
 
+// the files in folder, sorted by name so that the order does not depend on the file system
+std::vector<boost::filesystem::path> folder_files(const boost::filesystem::path& folder);
+
+// moves the elements of all the vectors in parts into one vector, keeping their order
+template <typename VectorT>
+VectorT concatenate(std::vector<VectorT>& parts)
+{
+    size_t size = 0;
+    for (const VectorT& part : parts) {
+        size += part.size();
+    }
+
+    VectorT rtn;
+    rtn.reserve(size);
+    for (VectorT& part : parts) {
+        rtn.insert(rtn.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+        VectorT().swap(part);
+    }
+
+    return rtn;
+}
+
+// parses the files in folder with nbr_threads threads, or one thread per core if nbr_threads <= 0,
+// the result is ordered by file name, same as when using one thread
 template <typename T>
-std::vector<T, Eigen::aligned_allocator<T> > parse_folder(const boost::filesystem::path& folder)
+std::vector<T, Eigen::aligned_allocator<T> > parse_folder(const boost::filesystem::path& folder, int nbr_threads = 1)
 {
-	
     std::vector<T, Eigen::aligned_allocator<T> > pings;
 
     if(!boost::filesystem::is_directory(folder)) {
@@ -206,22 +264,97 @@ std::vector<T, Eigen::aligned_allocator<T> > parse_folder(const boost::filesyste
         return pings;
     }
 
-    for (auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(folder), {})) {
-        std::cout << entry << "\n";
-	    if (boost::filesystem::is_directory(entry.path())) {
-		    continue;
-		}
-        std::vector<T, Eigen::aligned_allocator<T> > file_pings = parse_file<T>(entry.path());
-		pings.insert(pings.end(), file_pings.begin(), file_pings.end());
+    std::vector<boost::filesystem::path> files = folder_files(folder);
+    std::vector<std::vector<T, Eigen::aligned_allocator<T> > > file_pings(files.size());
+    parallel_for(files.size(), nbr_threads, [&](int i) {
+        file_pings[i] = parse_file<T>(files[i]);
+    });
+
+    return concatenate(file_pings);
+}
+
+template <typename T>
+std::vector<T, Eigen::aligned_allocator<T> > parse_folder_from_str(const std::string& folder, int nbr_threads = 1)
+{
+    return parse_folder<T>(boost::filesystem::path(folder), nbr_threads);
+}
+
+// collects entries into batches of at most batch_size and calls callback with each full
+// batch, call flush at the end to also get the last partial batch
+template <typename T>
+class batch_sink {
+public:
+
+    using EntriesT = std::vector<T, Eigen::aligned_allocator<T> >;
+    using CallbackT = std::function<void(EntriesT&)>;
+
+private:
+
+    int batch_size;
+    CallbackT callback;
+    EntriesT batch;
+
+public:
+
+    batch_sink(int batch_size, const CallbackT& callback) : batch_size(std::max(batch_size, 1)), callback(callback)
+    {
+        batch.reserve(this->batch_size);
+    }
+
+    void operator()(T&& entry)
+    {
+        batch.push_back(std::move(entry));
+        if (batch.size() >= size_t(batch_size)) {
+            flush();
+        }
     }
 
-    return pings;
+    void flush()
+    {
+        if (!batch.empty()) {
+            callback(batch);
+            batch.clear();
+        }
+    }
+};
+
+// like parse_file, but calls callback with batches of at most batch_size entries as they are
+// decoded, so that memory use is bounded by the batch size instead of the file size.
+// Formats without a streaming reader decode the whole file before calling back.
+template <typename T>
+void parse_file_batches(const boost::filesystem::path& file, int batch_size, const typename batch_sink<T>::CallbackT& callback)
+{
+    batch_sink<T> sink(batch_size, callback);
+    for (T& entry : parse_file<T>(file)) {
+        sink(std::move(entry));
+    }
+    sink.flush();
 }
 
 template <typename T>
-std::vector<T, Eigen::aligned_allocator<T> > parse_folder_from_str(const std::string& folder)
+void parse_file_batches_from_str(const std::string& file, int batch_size, const typename batch_sink<T>::CallbackT& callback)
 {
-    return parse_folder<T>(boost::filesystem::path(folder));
+    parse_file_batches<T>(boost::filesystem::path(file), batch_size, callback);
+}
+
+// calls parse_file_batches for each file in folder, in the same order as parse_folder
+template <typename T>
+void parse_folder_batches(const boost::filesystem::path& folder, int batch_size, const typename batch_sink<T>::CallbackT& callback)
+{
+    if(!boost::filesystem::is_directory(folder)) {
+        std::cout << folder << " is not a directory containing" << std::endl;
+        return;
+    }
+
+    for (const boost::filesystem::path& file : folder_files(folder)) {
+        parse_file_batches<T>(file, batch_size, callback);
+    }
+}
+
+template <typename T>
+void parse_folder_batches_from_str(const std::string& folder, int batch_size, const typename batch_sink<T>::CallbackT& callback)
+{
+    parse_folder_batches<T>(boost::filesystem::path(folder), batch_size, callback);
 }
 
 template <typename T>
@@ -249,7 +382,6 @@ T read_data_from_str(const std::string& path)
     return read_data<T>(boost::filesystem::path(path));
 }
 
-
 template <typename T>
 void write_data(T& data, const boost::filesystem::path& path)
 {
@@ -267,6 +399,14 @@ void write_data_from_str(T& data, const std::string& path)
     write_data<T>(data, boost::filesystem::path(path));
 }
 
+// sidescan pings are written with compressed intensities, see sss_store.h,
+// read_data also reads the plain archives written by earlier versions
+template <>
+sss_ping::PingsT read_data<sss_ping::PingsT>(const boost::filesystem::path& path);
+
+template <>
+void write_data<sss_ping::PingsT>(sss_ping::PingsT& data, const boost::filesystem::path& path);
+
 std::string time_string_from_time_stamp(long long time_stamp_);
 
 } // namespace std_data
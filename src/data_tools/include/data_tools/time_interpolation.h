@@ -0,0 +1,123 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TIME_INTERPOLATION_H
+#define TIME_INTERPOLATION_H
+
+#include <data_tools/std_data.h>
+
+namespace std_data {
+
+// the two samples of a time series to interpolate between for one query time
+struct interpolation_weight
+{
+    size_t previous; // index of the last sample at or before the query time
+    size_t next; // index of the first sample after the query time
+    double ratio; // 0 at previous, 1 at next
+
+    template <typename T>
+    T interpolate(const T& previous_value, const T& next_value) const
+    {
+        return previous_value + ratio*(next_value - previous_value);
+    }
+
+    // interpolates angles in radians along the shorter arc, as a slerp around a fixed axis
+    double interpolate_angle(double previous_value, double next_value) const
+    {
+        return previous_value + ratio*std::remainder(next_value - previous_value, 2.*M_PI);
+    }
+};
+
+template <typename EntriesT>
+std::vector<long long> extract_time_stamps(const EntriesT& entries)
+{
+    std::vector<long long> time_stamps;
+    time_stamps.reserve(entries.size());
+    for (const auto& entry : entries) {
+        time_stamps.push_back(entry.time_stamp_);
+    }
+    return time_stamps;
+}
+
+// finds the weights of each query time in the sorted, non-empty sample_times. query times
+// before the first or after the last sample get that sample for both previous and next.
+// increasing runs of queries are matched by walking forward, otherwise by binary search
+inline std::vector<interpolation_weight> compute_interpolation_weights(const std::vector<long long>& sample_times, const std::vector<long long>& query_times, int nbr_threads = 1)
+{
+    std::vector<interpolation_weight> weights(query_times.size());
+    if (sample_times.empty()) {
+        return weights;
+    }
+
+    const size_t block_size = 4096;
+    const size_t nbr_samples = sample_times.size();
+    int nbr_blocks = (query_times.size() + block_size - 1) / block_size;
+    parallel_for(nbr_blocks, nbr_threads, [&](int b) {
+        size_t begin = b*block_size;
+        size_t end = std::min(begin + block_size, query_times.size());
+        auto pos = sample_times.begin();
+        for (size_t i = begin; i < end; ++i) {
+            long long t = query_times[i];
+            if (i == begin || t < query_times[i - 1]) {
+                pos = std::upper_bound(sample_times.begin(), sample_times.end(), t);
+            }
+            else {
+                // the next sample is usually close, only search if it is not
+                int steps = 0;
+                for (; pos != sample_times.end() && *pos <= t && steps < 8; ++pos, ++steps);
+                if (pos != sample_times.end() && *pos <= t) {
+                    pos = std::upper_bound(pos, sample_times.end(), t);
+                }
+            }
+
+            size_t k = pos - sample_times.begin();
+            interpolation_weight& weight = weights[i];
+            if (k == 0 || k == nbr_samples) {
+                weight.previous = weight.next = k == 0 ? 0 : nbr_samples - 1;
+                weight.ratio = 0.;
+            }
+            else {
+                weight.previous = k - 1;
+                weight.next = k;
+                weight.ratio = double(t - sample_times[k - 1])/double(sample_times[k] - sample_times[k - 1]);
+            }
+        }
+    });
+
+    return weights;
+}
+
+// calls function(i, pings[i], weight) with the weight of each ping time stamp in the entries,
+// which have to be sorted by time stamp. the pings are updated in place using nbr_threads
+// threads (one per core if 0), so with more than one thread function must only modify pings[i]
+// and data owned by i
+template <typename PingsT, typename EntriesT, typename Function>
+void match_time_stamps(PingsT& pings, const EntriesT& entries, const Function& function, int nbr_threads = 1)
+{
+    if (pings.empty() || entries.empty()) {
+        return;
+    }
+
+    std::vector<interpolation_weight> weights = compute_interpolation_weights(extract_time_stamps(entries), extract_time_stamps(pings), nbr_threads);
+
+    const size_t block_size = 256;
+    int nbr_blocks = (pings.size() + block_size - 1) / block_size;
+    parallel_for(nbr_blocks, nbr_threads, [&](int b) {
+        size_t end = std::min((b + 1)*block_size, pings.size());
+        for (size_t i = b*block_size; i < end; ++i) {
+            function(i, pings[i], weights[i]);
+        }
+    });
+}
+
+} // namespace std_data
+
+#endif // TIME_INTERPOLATION_H
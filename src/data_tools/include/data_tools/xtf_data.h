@@ -13,6 +13,8 @@
 #define XTF_DATA_H
 
 #include <data_tools/navi_data.h>
+#include <data_tools/datagram_index.h>
+#include <data_tools/sss_store.h>
 #include <Eigen/Dense>
 #define BOOST_NO_CXX11_SCOPED_ENUMS
 #include <boost/filesystem.hpp>
@@ -54,10 +56,16 @@ struct xtf_sss_ping : public std_data::sss_ping {
 
 cv::Mat make_waterfall_image(const xtf_sss_ping::PingsT& pings);
 Eigen::MatrixXd make_eigen_waterfall_image(const xtf_sss_ping::PingsT& pings);
+// decodes the chunks straight into the image, using nbr_threads threads (one per core if 0)
+Eigen::MatrixXd make_eigen_waterfall_image(const std_data::compressed_sss_pings& pings, int nbr_threads = 0);
 void show_waterfall_image(const xtf_sss_ping::PingsT& pings);
 
 xtf_sss_ping::PingsT correct_sensor_offset(const xtf_sss_ping::PingsT& pings, const Eigen::Vector3d& sensor_offset);
 xtf_sss_ping::PingsT match_attitudes(const xtf_sss_ping::PingsT& pings, const std_data::attitude_entry::EntriesT& entries);
+void match_attitudes_in_place(xtf_sss_ping::PingsT& pings, const std_data::attitude_entry::EntriesT& entries);
+
+// index of all packets in the file, with the xtf header types (e.g. 0 for sonar) as types
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file);
 
 } // namespace xtf_data
 
@@ -66,6 +74,12 @@ namespace std_data {
 template <>
 xtf_data::xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file);
 
+template <>
+void parse_file_batches<xtf_data::xtf_sss_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<xtf_data::xtf_sss_ping>::CallbackT& callback);
+
+template <>
+xtf_data::xtf_sss_ping::PingsT parse_file_time_range(const boost::filesystem::path& file, long long start_time, long long end_time);
+
 }
 
 #endif // XTF_DATA_H
@@ -26,9 +26,18 @@ xyz_data::Points subsample_points(const xyz_data::Points& points, int skip);
 
 std::vector<xyz_data::Points> from_pings(const std_data::mbes_ping::PingsT& pings);
 
+// row-major Nx3 matrix with the same memory layout as Points
+using PointsMatrix = Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>;
+
 Eigen::MatrixXd to_matrix(const xyz_data::Points& points);
 xyz_data::Points from_matrix(const Eigen::MatrixXd& P);
 
+// zero-copy Nx3 view of points, only valid as long as points is not resized or destroyed
+Eigen::Map<const PointsMatrix> map_points(const xyz_data::Points& points);
+
+// memory maps an ascii .xyz file and parses newline-aligned chunks of it using nbr_threads threads (one per core if 0)
+xyz_data::Points parse_mapped_file(const boost::filesystem::path& file, int nbr_threads = 0);
+
 xyz_data::Points transform_points(const Eigen::Matrix4d& T, xyz_data::Points& points);
 
 } // namespace xyz_data
@@ -25,6 +25,13 @@ PACK(struct all_common_header {
     unsigned char data_type; // Type of datagram = X (58h, 88d)
 });
 
+// this follows the common header in all .all datagrams
+PACK(struct all_common_start {
+    unsigned short model_nbr; // EM model number (Example: EM 710 = 710)
+    unsigned int date; // Date = year*10000 + month*100 + day (Example: Sep 26, 2005 = 20050926)
+    unsigned int time; // Time since midnight in milliseconds (Example: 08:12:51.234 = 29570234)
+});
+
 PACK(struct all_common_end {
     // end of repeat cycle
 	unsigned char end_ident; // End identifier = ETX (Always 03h)
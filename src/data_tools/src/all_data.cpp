@@ -11,6 +11,7 @@
 
 #include <data_tools/all_data.h>
 #include <data_tools/lat_long_utm.h>
+#include <data_tools/time_interpolation.h>
 #include <liball/all.h>
 //#include <endian.h>
 #include <fstream>
@@ -123,10 +124,11 @@ ReturnType read_datagram(std::istream& input, const AllHeaderType& header)
 	return rtn;
 }
 
-template <typename ReturnType, typename AllHeaderType, int Code>
-vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_stream_impl(istream& input)
+// calls sink with each decoded datagram of type Code, in stream order
+template <typename ReturnType, typename AllHeaderType, int Code, typename SinkT>
+void parse_stream_impl(istream& input, SinkT& sink)
 {
-	vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
+    bool first_in_file = true;
 
     unsigned int nbr_bytes;
     unsigned char start_id;
@@ -153,6 +155,14 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_stream_impl(istr
 		//cout << "Number bytes: " << nbr_bytes << endl;
 		//cout << "Start id: " << int(start_id) << endl;
 		//cout << "Data type must be " << Code << endl;
+        if (input.fail()) {
+            break;
+        }
+        // a corrupt nbr_bytes puts us in the middle of some datagram, nothing after it can be trusted
+        if (start_id != 2) {
+            cout << "Start id not 2, stopping parse..." << endl;
+            break;
+        }
 		if (data_type == 80) {
 		    ++pos_counter;
 		}
@@ -161,12 +171,14 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_stream_impl(istr
 			AllHeaderType header;
 		    //cout << "Is a MB reading, code: " << int(data_type) << endl;
 		    input.read(reinterpret_cast<char*>(&header), sizeof(header));
-			returns.push_back(read_datagram<ReturnType, AllHeaderType>(input, header));
+			ReturnType entry = read_datagram<ReturnType, AllHeaderType>(input, header);
 		    //input.read(reinterpret_cast<char*>(&spare), sizeof(spare));
 		    input.read(reinterpret_cast<char*>(&end_ident), sizeof(end_ident));
 		    input.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
 			//cout << "End identifier: " << end_ident << endl;
-            returns.back().first_in_file_ = false;
+            entry.first_in_file_ = first_in_file;
+            first_in_file = false;
+            sink(std::move(entry));
 		}
 		else {
 		    //cout << "No MB reading, code: " << int(data_type) << endl;
@@ -181,20 +193,14 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_stream_impl(istr
     }
 	cout << "Got " << pos_counter << " position entries" << endl;
     */
-
-    if (!returns.empty()) {
-        returns[0].first_in_file_ = true;
-    }
-
-	return returns;
 }
 
-template <typename ReturnType, typename AllHeaderType, int Code>
-vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const boost::filesystem::path& path)
+template <typename ReturnType, typename AllHeaderType, int Code, typename SinkT>
+void parse_file_impl(const boost::filesystem::path& path, SinkT& sink)
 {
     if (boost::filesystem::extension(path) != ".all") {
         cout << "Not an .all file, skipping..." << endl;
-        return vector<ReturnType, Eigen::aligned_allocator<ReturnType> >(0);
+        return;
     }
 
     std::ifstream input;
@@ -205,7 +211,27 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const
     }
     //cout << "Opened " << path << " for reading..." << endl;
     
-    return parse_stream_impl<ReturnType, AllHeaderType, Code>(input);
+    parse_stream_impl<ReturnType, AllHeaderType, Code>(input, sink);
+}
+
+template <typename ReturnType, typename AllHeaderType, int Code>
+vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const boost::filesystem::path& path)
+{
+    vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
+    auto sink = [&returns](ReturnType&& entry) {
+        returns.push_back(std::move(entry));
+    };
+    parse_file_impl<ReturnType, AllHeaderType, Code>(path, sink);
+
+	return returns;
+}
+
+template <typename ReturnType, typename AllHeaderType, int Code>
+void parse_file_batches_impl(const boost::filesystem::path& path, int batch_size, const typename std_data::batch_sink<ReturnType>::CallbackT& callback)
+{
+    std_data::batch_sink<ReturnType> sink(batch_size, callback);
+    parse_file_impl<ReturnType, AllHeaderType, Code>(path, sink);
+    sink.flush();
 }
 
 pair<long long, string> parse_all_time(unsigned int date, unsigned int time)
@@ -353,7 +379,6 @@ all_echosounder_depth read_datagram<all_echosounder_depth, all_echosounder_depth
 mbes_ping::PingsT convert_matched_entries(all_mbes_ping::PingsT& pings, all_nav_entry::EntriesT& entries)
 {
     mbes_ping::PingsT new_pings;
-    new_pings.reserve(pings.size());
 
     std::stable_sort(entries.begin(), entries.end(), [](const all_nav_entry& entry1, const all_nav_entry& entry2) {
         return entry1.time_stamp_ < entry2.time_stamp_;
@@ -362,48 +387,27 @@ mbes_ping::PingsT convert_matched_entries(all_mbes_ping::PingsT& pings, all_nav_
         return ping1.time_stamp_ < ping2.time_stamp_;
     });
 
-    auto pos = entries.begin();
-    for (all_mbes_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const all_nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
+    new_pings.resize(pings.size());
+    match_time_stamps(pings, entries, [&](size_t k, const all_mbes_ping& ping, const interpolation_weight& weight) {
+        const all_nav_entry& previous = entries[weight.previous];
+        const all_nav_entry& next = entries[weight.next];
 
-        mbes_ping new_ping;
+        mbes_ping& new_ping = new_pings[k];
         new_ping.time_stamp_ = ping.time_stamp_;
         new_ping.time_string_ = ping.time_string_;
         new_ping.first_in_file_ = ping.first_in_file_;
         new_ping.heading_ = ping.heading_;
         new_ping.pitch_ = 0.;
         new_ping.roll_ = 0.;
-        if (pos == entries.end()) {
-            double easting, northing;
-            string utm_zone;
-            tie(northing, easting, utm_zone) = lat_long_utm::lat_long_to_UTM(entries.back().lat_, entries.back().long_);
-            new_ping.pos_ = Eigen::Vector3d(easting, northing, -ping.transducer_depth_);
-            //new_ping.pos_ = Eigen::Vector3d(easting, northing, -entries.back().depth_);
-        }
-        else {
-            if (pos == entries.begin()) {
-                double easting, northing;
-                string utm_zone;
-                tie(northing, easting, utm_zone) = lat_long_utm::lat_long_to_UTM(pos->lat_, pos->long_);
-                new_ping.pos_ = Eigen::Vector3d(easting, northing, -ping.transducer_depth_);
-                //new_ping.pos_ = Eigen::Vector3d(easting, northing, -pos->depth_);
-            }
-            else {
-                all_nav_entry& previous = *(pos - 1);
-                double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-                double lat = previous.lat_ + ratio*(pos->lat_ - previous.lat_);
-                double lon = previous.long_ + ratio*(pos->long_ - previous.long_);
-                double depth = previous.depth_ + ratio*(pos->depth_ - previous.depth_);
-                double easting, northing;
-                string utm_zone;
-                tie(northing, easting, utm_zone) = lat_long_utm::lat_long_to_UTM(lat, lon);
-                new_ping.pos_ = Eigen::Vector3d(easting, northing, -ping.transducer_depth_);
-                //cout << "Filtered depth: " << depth << ", transducer depth: " << ping.transducer_depth_ << endl;
-                //new_ping.pos_ = Eigen::Vector3d(easting, northing, -depth);
-            }
-        }
+
+        double lat = weight.interpolate(previous.lat_, next.lat_);
+        double lon = weight.interpolate(previous.long_, next.long_);
+        double easting, northing;
+        string utm_zone;
+        tie(northing, easting, utm_zone) = lat_long_utm::lat_long_to_UTM(lat, lon);
+        new_ping.pos_ = Eigen::Vector3d(easting, northing, -ping.transducer_depth_);
+        //double depth = weight.interpolate(previous.depth_, next.depth_);
+        //new_ping.pos_ = Eigen::Vector3d(easting, northing, -depth);
 
         new_ping.beams.reserve(ping.beams.size());
         new_ping.back_scatter.reserve(ping.beams.size());
@@ -422,14 +426,12 @@ mbes_ping::PingsT convert_matched_entries(all_mbes_ping::PingsT& pings, all_nav_
             new_ping.back_scatter.push_back(ping.reflectivities[i]);
             ++i;
         }
-
-        new_pings.push_back(new_ping);
-    }
+    });
 
     return new_pings;
 }
 
-mbes_ping::PingsT match_attitude(mbes_ping::PingsT& pings, all_nav_attitude::EntriesT& entries)
+void match_attitude_in_place(mbes_ping::PingsT& pings, all_nav_attitude::EntriesT& entries)
 {
     struct unfolded_attitude {
         long long time_stamp_; // posix time stamp
@@ -452,38 +454,16 @@ mbes_ping::PingsT match_attitude(mbes_ping::PingsT& pings, all_nav_attitude::Ent
         }
     }
 
-    mbes_ping::PingsT new_pings = pings;
-
-    std::stable_sort(entries.begin(), entries.end(), [](const all_nav_attitude& entry1, const all_nav_attitude& entry2) {
-        return entry1.time_stamp_ < entry2.time_stamp_;
+    std::stable_sort(attitudes.begin(), attitudes.end(), [](const unfolded_attitude& attitude1, const unfolded_attitude& attitude2) {
+        return attitude1.time_stamp_ < attitude2.time_stamp_;
     });
 
-    auto pos = attitudes.begin();
-    for (mbes_ping& ping : new_pings) {
-        pos = std::find_if(pos, attitudes.end(), [&](const unfolded_attitude& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
-
-        ping.pitch_ = 0.;
-        ping.roll_ = 0.;
-        double heave;
-        if (pos == attitudes.end()) {
-            ping.pitch_ = attitudes.back().pitch;
-            ping.roll_ = attitudes.back().roll;
-            heave = attitudes.back().heave;
-        }
-        else if (pos == attitudes.begin()) {
-                ping.pitch_ = pos->pitch;
-                ping.roll_ = pos->roll;
-                heave = pos->heave;
-        }
-        else {
-            unfolded_attitude& previous = *(pos - 1);
-            double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-            ping.pitch_ = previous.pitch + ratio*(pos->pitch - previous.pitch);
-            ping.roll_ = previous.roll + ratio*(pos->roll - previous.roll);
-            heave = previous.heave + ratio*(pos->heave - previous.heave);
-        }
+    match_time_stamps(pings, attitudes, [&](size_t k, mbes_ping& ping, const interpolation_weight& weight) {
+        const unfolded_attitude& previous = attitudes[weight.previous];
+        const unfolded_attitude& next = attitudes[weight.next];
+        ping.pitch_ = weight.interpolate(previous.pitch, next.pitch);
+        ping.roll_ = weight.interpolate(previous.roll, next.roll);
+        //double heave = weight.interpolate(previous.heave, next.heave);
         //ping.pitch_ *= -1.;
         //ping.roll_ *= -1.;
 
@@ -499,8 +479,13 @@ mbes_ping::PingsT match_attitude(mbes_ping::PingsT& pings, all_nav_attitude::Ent
             //Eigen::Matrix3d R = Rx*Ry*Rz;
             beam = ping.pos_ + R*beam; // + Eigen::Vector3d(0., 0., -heave);
         }
-    }
+    });
+}
 
+mbes_ping::PingsT match_attitude(mbes_ping::PingsT& pings, all_nav_attitude::EntriesT& entries)
+{
+    mbes_ping::PingsT new_pings = pings;
+    match_attitude_in_place(new_pings, entries);
     return new_pings;
 }
 
@@ -570,6 +555,40 @@ std_data::attitude_entry::EntriesT convert_attitudes(const all_nav_attitude::Ent
     return entries;
 }
 
+template <typename ReturnType, typename AllHeaderType>
+ReturnType read_header_and_datagram(std::istream& input)
+{
+    AllHeaderType header;
+    input.read(reinterpret_cast<char*>(&header), sizeof(header));
+    ReturnType rtn = read_datagram<ReturnType, AllHeaderType>(input, header);
+    rtn.first_in_file_ = false;
+    return rtn;
+}
+
+bool StreamParser::parse_datagram(std::istream& input, unsigned char data_type)
+{
+    if (data_type == 88 && mbes_callback) {
+        mbes_callback(read_header_and_datagram<all_mbes_ping, all_xyz88_datagram>(input));
+    }
+    else if (data_type == 80 && nav_entry_callback) {
+        nav_entry_callback(read_header_and_datagram<all_nav_entry, all_position_datagram>(input));
+    }
+    else if (data_type == 104 && nav_depth_callback) {
+        nav_depth_callback(read_header_and_datagram<all_nav_depth, all_depth_datagram>(input));
+    }
+    else if (data_type == 65 && nav_attitude_callback) {
+        nav_attitude_callback(read_header_and_datagram<all_nav_attitude, all_attitude_datagram>(input));
+    }
+    else if (data_type == 69 && echosounder_depth_callback) {
+        echosounder_depth_callback(read_header_and_datagram<all_echosounder_depth, all_echosounder_depth_datagram>(input));
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
 bool StreamParser::parse_packet(const std::string& packet_load)
 {
     std::istringstream input(packet_load);
@@ -585,17 +604,7 @@ bool StreamParser::parse_packet(const std::string& packet_load)
         return false;
     }
 
-    if (data_type == 88 && mbes_callback) {
-        all_xyz88_datagram header;
-        input.read(reinterpret_cast<char*>(&header), sizeof(header));
-        mbes_callback(read_datagram<all_mbes_ping, all_xyz88_datagram>(input, header));
-    }
-    else if (data_type == 80 && nav_entry_callback) {
-        all_position_datagram header;
-        input.read(reinterpret_cast<char*>(&header), sizeof(header));
-        nav_entry_callback(read_datagram<all_nav_entry, all_position_datagram>(input, header));
-    }
-    else {
+    if (!parse_datagram(input, data_type)) {
         cout << "No callback for datagram: " << data_type << endl;
         return false;
     }
@@ -614,6 +623,239 @@ bool StreamParser::parse_packet(const std::string& packet_load)
     return true;
 }
 
+bool StreamParser::parse_stream(std::istream& input)
+{
+    unsigned int nbr_bytes;
+    unsigned char start_id;
+    unsigned char data_type;
+
+    while (input.read(reinterpret_cast<char*>(&nbr_bytes), sizeof(nbr_bytes))) {
+        // nbr_bytes counts everything after itself, so we always seek to
+        // the next datagram from here, whether we decoded this one or not
+        std::streampos datagram_start = input.tellg();
+        input.read(reinterpret_cast<char*>(&start_id), sizeof(start_id));
+        input.read(reinterpret_cast<char*>(&data_type), sizeof(data_type));
+        if (input.fail()) {
+            break;
+        }
+        // a corrupt nbr_bytes puts us in the middle of some datagram, nothing after it can be trusted
+        if (start_id != 2) {
+            cout << "Start id not 2 at offset " << datagram_start - std::streamoff(sizeof(nbr_bytes)) << ", stopping parse..." << endl;
+            return false;
+        }
+        parse_datagram(input, data_type);
+        input.clear();
+        input.seekg(datagram_start + std::streamoff(nbr_bytes));
+    }
+
+    return !input.bad();
+}
+
+bool StreamParser::parse_indexed_datagrams(std::istream& input, const std_data::datagram_index::EntriesT& entries)
+{
+    unsigned char start_id;
+    unsigned char data_type;
+
+    for (const std_data::datagram_index_entry& entry : entries) {
+        // skip the nbr_bytes field, the index already knows the length
+        input.seekg(entry.offset + sizeof(unsigned int));
+        input.read(reinterpret_cast<char*>(&start_id), sizeof(start_id));
+        input.read(reinterpret_cast<char*>(&data_type), sizeof(data_type));
+        if (input.fail() || start_id != 2 || data_type != entry.type) {
+            cout << "Could not read datagram at offset " << entry.offset << ", is the index stale?" << endl;
+            return false;
+        }
+        parse_datagram(input, data_type);
+    }
+
+    return true;
+}
+
+template <typename EntriesT>
+void mark_first_in_file(EntriesT& entries)
+{
+    if (!entries.empty()) {
+        entries[0].first_in_file_ = true;
+    }
+}
+
+// moves one type of entries out of all the file bundles, in file order
+template <typename EntriesT>
+EntriesT concatenate_member(vector<all_datagrams>& file_datagrams, EntriesT all_datagrams::* member)
+{
+    vector<EntriesT> parts;
+    parts.reserve(file_datagrams.size());
+    for (all_datagrams& datagrams : file_datagrams) {
+        parts.push_back(std::move(datagrams.*member));
+    }
+    return std_data::concatenate(parts);
+}
+
+void set_bundle_callbacks(StreamParser& parser, all_datagrams& datagrams)
+{
+    parser.set_mbes_callback([&datagrams](all_mbes_ping ping) {
+        datagrams.mbes_pings.push_back(std::move(ping));
+    });
+    parser.set_nav_entry_callback([&datagrams](all_nav_entry entry) {
+        datagrams.nav_entries.push_back(std::move(entry));
+    });
+    parser.set_nav_depth_callback([&datagrams](all_nav_depth entry) {
+        datagrams.nav_depths.push_back(std::move(entry));
+    });
+    parser.set_nav_attitude_callback([&datagrams](all_nav_attitude entry) {
+        datagrams.nav_attitudes.push_back(std::move(entry));
+    });
+    parser.set_echosounder_depth_callback([&datagrams](all_echosounder_depth entry) {
+        datagrams.echosounder_depths.push_back(std::move(entry));
+    });
+}
+
+void mark_bundle_first_in_file(all_datagrams& datagrams)
+{
+    mark_first_in_file(datagrams.mbes_pings);
+    mark_first_in_file(datagrams.nav_entries);
+    mark_first_in_file(datagrams.nav_depths);
+    mark_first_in_file(datagrams.nav_attitudes);
+    mark_first_in_file(datagrams.echosounder_depths);
+}
+
+all_datagrams parse_datagrams_file(const boost::filesystem::path& file)
+{
+    all_datagrams rtn;
+
+    if (boost::filesystem::extension(file) != ".all") {
+        cout << "Not an .all file, skipping..." << endl;
+        return rtn;
+    }
+
+    std::ifstream input;
+	input.open(file.string(), std::ios::binary);
+	if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
+    }
+
+    StreamParser parser;
+    set_bundle_callbacks(parser, rtn);
+    parser.parse_stream(input);
+
+    mark_bundle_first_in_file(rtn);
+
+    return rtn;
+}
+
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file)
+{
+    std_data::datagram_index index;
+
+    std::ifstream input;
+	input.open(file.string(), std::ios::binary);
+	if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
+    }
+
+    const boost::gregorian::date epoch(1970, 1, 1);
+
+    all_common_header header;
+    all_common_start start;
+    long long time_stamp = 0;
+    unsigned long long offset = 0;
+    while (input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        input.read(reinterpret_cast<char*>(&start), sizeof(start));
+        if (input.fail()) {
+            break;
+        }
+        if (header.start_id != 2) {
+            cout << "Start id not 2 at offset " << offset << ", stopping index..." << endl;
+            break;
+        }
+
+        int year = start.date / 10000;
+        int month = (start.date / 100) % 100;
+        int day = start.date % 100;
+        if (year >= 1970 && year < 10000 && month >= 1 && month <= 12 && day >= 1 &&
+            day <= boost::gregorian::gregorian_calendar::end_of_month_day(year, month)) {
+            // avoids the string parsing in parse_all_time, this is called for every datagram
+            time_stamp = 86400000LL*(boost::gregorian::date(year, month, day) - epoch).days() + start.time;
+        }
+
+        std_data::datagram_index_entry entry;
+        entry.time_stamp_ = time_stamp;
+        entry.type = header.data_type;
+        entry.offset = offset;
+        entry.length = sizeof(header.bytes) + header.bytes; // bytes counts everything after itself
+        index.entries.push_back(entry);
+
+        offset += entry.length;
+        input.seekg(offset);
+    }
+
+    return index;
+}
+
+all_datagrams parse_datagrams_file(const boost::filesystem::path& file, long long start_time, long long end_time,
+                                   const std::vector<int>& types)
+{
+    all_datagrams rtn;
+
+    if (boost::filesystem::extension(file) != ".all") {
+        cout << "Not an .all file, skipping..." << endl;
+        return rtn;
+    }
+
+    std_data::datagram_index index = std_data::load_or_build_datagram_index(file, &build_datagram_index);
+
+    std::ifstream input;
+	input.open(file.string(), std::ios::binary);
+	if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
+    }
+
+    StreamParser parser;
+    set_bundle_callbacks(parser, rtn);
+    if (!parser.parse_indexed_datagrams(input, index.filter(start_time, end_time, types))) {
+        // size and time match, but the index is not of this file, e.g. copied along with another one
+        cout << "Index does not match " << file << ", rebuilding..." << endl;
+        rtn = all_datagrams();
+        index = std_data::load_or_build_datagram_index(file, &build_datagram_index, true);
+        input.clear();
+        if (!parser.parse_indexed_datagrams(input, index.filter(start_time, end_time, types))) {
+            cout << "ERROR: Cannot parse " << file << " with a fresh index..." << endl;
+            exit(0);
+        }
+    }
+
+    mark_bundle_first_in_file(rtn);
+
+    return rtn;
+}
+
+all_datagrams parse_datagrams_folder(const boost::filesystem::path& folder, int nbr_threads)
+{
+    all_datagrams rtn;
+
+    if (!boost::filesystem::is_directory(folder)) {
+        cout << folder << " is not a directory containing" << endl;
+        return rtn;
+    }
+
+    vector<boost::filesystem::path> files = std_data::folder_files(folder);
+    vector<all_datagrams> file_datagrams(files.size());
+    std_data::parallel_for(files.size(), nbr_threads, [&](int i) {
+        file_datagrams[i] = parse_datagrams_file(files[i]);
+    });
+
+    rtn.mbes_pings = concatenate_member(file_datagrams, &all_datagrams::mbes_pings);
+    rtn.nav_entries = concatenate_member(file_datagrams, &all_datagrams::nav_entries);
+    rtn.nav_depths = concatenate_member(file_datagrams, &all_datagrams::nav_depths);
+    rtn.nav_attitudes = concatenate_member(file_datagrams, &all_datagrams::nav_attitudes);
+    rtn.echosounder_depths = concatenate_member(file_datagrams, &all_datagrams::echosounder_depths);
+
+    return rtn;
+}
+
 } // namespace all_data
 
 namespace std_data {
@@ -650,4 +892,64 @@ all_echosounder_depth::EntriesT parse_file<all_echosounder_depth>(const boost::f
     return parse_file_impl<all_echosounder_depth, all_echosounder_depth_datagram, 69>(file);
 }
 
+template <>
+all_mbes_ping::PingsT parse_file_time_range<all_mbes_ping>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_datagrams_file(file, start_time, end_time, vector<int>{88}).mbes_pings;
+}
+
+template <>
+all_nav_entry::EntriesT parse_file_time_range<all_nav_entry>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_datagrams_file(file, start_time, end_time, vector<int>{80}).nav_entries;
+}
+
+template <>
+all_nav_depth::EntriesT parse_file_time_range<all_nav_depth>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_datagrams_file(file, start_time, end_time, vector<int>{104}).nav_depths;
+}
+
+template <>
+all_nav_attitude::EntriesT parse_file_time_range<all_nav_attitude>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_datagrams_file(file, start_time, end_time, vector<int>{65}).nav_attitudes;
+}
+
+template <>
+all_echosounder_depth::EntriesT parse_file_time_range<all_echosounder_depth>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_datagrams_file(file, start_time, end_time, vector<int>{69}).echosounder_depths;
+}
+
+template <>
+void parse_file_batches<all_mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_mbes_ping>::CallbackT& callback)
+{
+    parse_file_batches_impl<all_mbes_ping, all_xyz88_datagram, 88>(file, batch_size, callback);
+}
+
+template <>
+void parse_file_batches<all_nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_nav_entry>::CallbackT& callback)
+{
+    parse_file_batches_impl<all_nav_entry, all_position_datagram, 80>(file, batch_size, callback);
+}
+
+template <>
+void parse_file_batches<all_nav_depth>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_nav_depth>::CallbackT& callback)
+{
+    parse_file_batches_impl<all_nav_depth, all_depth_datagram, 104>(file, batch_size, callback);
+}
+
+template <>
+void parse_file_batches<all_nav_attitude>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_nav_attitude>::CallbackT& callback)
+{
+    parse_file_batches_impl<all_nav_attitude, all_attitude_datagram, 65>(file, batch_size, callback);
+}
+
+template <>
+void parse_file_batches<all_echosounder_depth>(const boost::filesystem::path& file, int batch_size, const batch_sink<all_echosounder_depth>::CallbackT& callback)
+{
+    parse_file_batches_impl<all_echosounder_depth, all_echosounder_depth_datagram, 69>(file, batch_size, callback);
+}
+
 } // namespace std_data
@@ -10,6 +10,7 @@
  */
 
 #include <data_tools/csv_data.h>
+#include <data_tools/time_interpolation.h>
 //#include <data_tools/xtf_data.h>
 
 #define BOOST_NO_CXX11_SCOPED_ENUMS
@@ -29,45 +30,26 @@ namespace csv_data {
 
 using namespace std_data;
 
-std_data::sss_ping::PingsT convert_matched_entries_pitch(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
+static void convert_matched_entries_pitch_in_place(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
 {
-    std_data::sss_ping::PingsT new_pings;
-
     std::stable_sort(entries.begin(), entries.end(), [](const csv_nav_entry& entry1, const csv_nav_entry& entry2) {
         return entry1.time_stamp_ < entry2.time_stamp_;
     });
 
-    auto pos = entries.begin();
-    for (std_data::sss_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const csv_nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
-
-        std_data::sss_ping new_ping = ping;
-        if (pos == entries.end()) {
-            new_ping.pitch_ = entries.back().pitch_;
-        }
-        else {
-            if (pos == entries.begin()) {
-                new_ping.pitch_ = pos->pitch_;
-            }
-            else {
-                csv_nav_entry& previous = *(pos - 1);
-                double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-                new_ping.pitch_ = previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_);
-            }
-        }
-
-        new_pings.push_back(new_ping);
-    }
+    match_time_stamps(pings, entries, [&](size_t i, std_data::sss_ping& ping, const interpolation_weight& weight) {
+        ping.pitch_ = weight.interpolate(entries[weight.previous].pitch_, entries[weight.next].pitch_);
+    });
+}
 
+std_data::sss_ping::PingsT convert_matched_entries_pitch(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
+{
+    std_data::sss_ping::PingsT new_pings = pings;
+    convert_matched_entries_pitch_in_place(new_pings, entries);
     return new_pings;
 }
 
-std_data::sss_ping::PingsT convert_matched_entries(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
+void convert_matched_entries_in_place(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
 {
-    std_data::sss_ping::PingsT new_pings;
-
     std::stable_sort(entries.begin(), entries.end(), [](const csv_nav_entry& entry1, const csv_nav_entry& entry2) {
         return entry1.time_stamp_ < entry2.time_stamp_;
     });
@@ -76,52 +58,41 @@ std_data::sss_ping::PingsT convert_matched_entries(std_data::sss_ping::PingsT& p
         return ping1.time_stamp_ < ping2.time_stamp_;
     });
 
-    auto pos = entries.begin();
-    int bcount = 0;
-    int ecount = 0;
-    int mcount = 0;
-    for (std_data::sss_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const csv_nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
-
-        std_data::sss_ping new_ping = ping;
-        if (pos == entries.end()) {
-            new_ping.roll_ = entries.back().roll_;
-            new_ping.pitch_ = entries.back().pitch_;
-            //new_ping.heading_ = entries.back().heading_;
-            new_ping.pos_ = entries.back().pos_;
-            ++ecount;
+    std::atomic<int> bcount(0);
+    std::atomic<int> ecount(0);
+    std::atomic<int> mcount(0);
+    match_time_stamps(pings, entries, [&](size_t i, std_data::sss_ping& ping, const interpolation_weight& weight) {
+        const csv_nav_entry& previous = entries[weight.previous];
+        const csv_nav_entry& next = entries[weight.next];
+        if (weight.previous != weight.next) {
+            ++mcount;
+        }
+        else if (ping.time_stamp_ < next.time_stamp_) {
+            ++bcount;
         }
         else {
-            if (pos == entries.begin()) {
-                new_ping.roll_ = pos->roll_;
-                new_ping.pitch_ = pos->pitch_;
-                //new_ping.heading_ = pos->heading_;
-                new_ping.pos_ = pos->pos_;
-                ++bcount;
-            }
-            else {
-                csv_nav_entry& previous = *(pos - 1);
-                double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-                new_ping.roll_ = previous.roll_ + ratio*(pos->roll_ - previous.roll_);
-                new_ping.pitch_ = previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_);
-                //new_ping.heading_ = previous.heading_ + ratio*(pos->heading_ - previous.heading_);
-                new_ping.pos_ = previous.pos_ + ratio*(pos->pos_ - previous.pos_);
-                ++mcount;
-            }
+            ++ecount;
         }
-        
-        //Eigen::Matrix3d Rz = Eigen::AngleAxisd(new_ping.heading_, Eigen::Vector3d::UnitZ()).matrix();
+
+        ping.roll_ = weight.interpolate(previous.roll_, next.roll_);
+        ping.pitch_ = weight.interpolate(previous.pitch_, next.pitch_);
+        //ping.heading_ = weight.interpolate_angle(previous.heading_, next.heading_);
+
+        //Eigen::Matrix3d Rz = Eigen::AngleAxisd(ping.heading_, Eigen::Vector3d::UnitZ()).matrix();
         // these are my estimated values for the
         // sidescan offset from the center of motion
-        //new_ping.pos_.array() += (2.*Rz.col(0) + -1.5*Rz.col(1)).array();
-        new_ping.pos_[2] = ping.pos_[2];
-
-        new_pings.push_back(new_ping);
-    }
+        //ping.pos_.array() += (2.*Rz.col(0) + -1.5*Rz.col(1)).array();
+        double z = ping.pos_[2];
+        ping.pos_ = weight.interpolate(previous.pos_, next.pos_);
+        ping.pos_[2] = z;
+    });
     cout << "Got " << bcount << " at beginning, " << ecount << " at end and " << mcount << " in the middle" << endl;
+}
 
+std_data::sss_ping::PingsT convert_matched_entries(std_data::sss_ping::PingsT& pings, csv_nav_entry::EntriesT& entries)
+{
+    std_data::sss_ping::PingsT new_pings = pings;
+    convert_matched_entries_in_place(new_pings, entries);
     return new_pings;
 }
 
@@ -161,11 +132,10 @@ using namespace csv_data;
   (time in Sec, distance in Meters, position in Meters, lat, long in Degrees, orientation angles and SD in Degrees, velocity in Meter/Sec, position SD in Meters)  
 */
 
-template <>
-csv_nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
+// calls sink with each entry in the file
+template <typename SinkT>
+void parse_csv_nav_impl(const boost::filesystem::path& file, SinkT& sink)
 {
-    csv_nav_entry::EntriesT entries;
-
     csv_nav_entry entry;
     double distance, x, y, z, x_std, y_std, z_std, vx, vy, vz;
     double roll, pitch, heading, roll_std, pitch_std, heading_std;
@@ -206,10 +176,27 @@ csv_nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
         time_ss << t;
         entry.time_string_ = time_ss.str();
 
-		entries.push_back(entry);
+        sink(std::move(entry));
     }
+}
 
-	return entries;
+template <>
+csv_nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
+{
+    csv_nav_entry::EntriesT entries;
+    auto sink = [&entries](csv_nav_entry&& entry) {
+        entries.push_back(std::move(entry));
+    };
+    parse_csv_nav_impl(file, sink);
+    return entries;
+}
+
+template <>
+void parse_file_batches<csv_nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<csv_nav_entry>::CallbackT& callback)
+{
+    batch_sink<csv_nav_entry> sink(batch_size, callback);
+    parse_csv_nav_impl(file, sink);
+    sink.flush();
 }
 
 template <>
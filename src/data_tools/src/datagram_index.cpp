@@ -0,0 +1,80 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <data_tools/datagram_index.h>
+
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+namespace std_data {
+
+datagram_index::EntriesT datagram_index::filter(long long start_time, long long end_time, const std::vector<int>& types) const
+{
+    EntriesT filtered;
+    for (const datagram_index_entry& entry : entries) {
+        if (entry.time_stamp_ < start_time || entry.time_stamp_ > end_time) {
+            continue;
+        }
+        if (!types.empty() && std::find(types.begin(), types.end(), entry.type) == types.end()) {
+            continue;
+        }
+        filtered.push_back(entry);
+    }
+    return filtered;
+}
+
+boost::filesystem::path datagram_index_path(const boost::filesystem::path& file)
+{
+    boost::filesystem::path index_path = file;
+    index_path += ".index";
+    return index_path;
+}
+
+datagram_index load_or_build_datagram_index(const boost::filesystem::path& file, const build_index_function& build_index, bool rebuild)
+{
+    unsigned long long file_size = boost::filesystem::file_size(file);
+    long long file_time = boost::filesystem::last_write_time(file);
+
+    boost::filesystem::path index_path = datagram_index_path(file);
+    if (!rebuild && boost::filesystem::exists(index_path)) {
+        // a truncated or corrupt sidecar, e.g. from a killed run, is rebuilt like an old one
+        try {
+            datagram_index index = read_data<datagram_index>(index_path);
+            if (index.file_size == file_size && index.file_time == file_time) {
+                return index;
+            }
+            cout << "Index " << index_path << " is out of date, rebuilding..." << endl;
+        }
+        catch (const std::exception& e) {
+            cout << "Could not read index " << index_path << " (" << e.what() << "), rebuilding..." << endl;
+        }
+    }
+
+    datagram_index index = build_index(file);
+    index.file_size = file_size;
+    index.file_time = file_time;
+
+    // not being able to write the sidecar, e.g. in a read-only folder, only costs a rebuild next time
+    std::ofstream os(index_path.string(), std::ofstream::binary);
+    if (os.good()) {
+		cereal::BinaryOutputArchive archive(os);
+        archive(index);
+    }
+    else {
+        cout << "Could not write index " << index_path << ", continuing without it..." << endl;
+    }
+
+    return index;
+}
+
+} // namespace std_data
@@ -16,6 +16,8 @@
 #undef BOOST_NO_CXX11_SCOPED_ENUMS
 #include <gsf.h>
 #include <data_tools/lat_long_utm.h>
+#include <data_tools/time_interpolation.h>
+#include <mutex>
 
 using namespace std;
 
@@ -34,23 +36,14 @@ void match_sound_speeds(gsf_mbes_ping::PingsT& pings, gsf_sound_speed::SpeedsT&
         return speed1.time_stamp_ < speed2.time_stamp_;
     });
 
-    auto pos = speeds.begin();
-    for (gsf_mbes_ping& ping : pings) {
-        pos = std::find_if(pos, speeds.end(), [&](const gsf_sound_speed& speed) {
-            return speed.time_stamp_ > ping.time_stamp_;
-        });
-        double ss;
-        if (pos == speeds.end()) {
-            ss = speeds.back().below_speed;
-        }
-        else {
-            ss = pos->below_speed;
-        }
+    // each ping uses the sound speed of the first entry after it
+    match_time_stamps(pings, speeds, [&](size_t, gsf_mbes_ping& ping, const interpolation_weight& weight) {
+        double ss = speeds[weight.next].below_speed;
         for (int i = 0; i < ping.travel_times.size(); ++i) {
             ping.distances.push_back(.5*ss*ping.travel_times[i]);
             //ping.distances.push_back(ss*ping.travel_times[i]);
         }
-    }
+    });
 
 }
 
@@ -62,65 +55,30 @@ mbes_ping::PingsT convert_matched_entries(gsf_mbes_ping::PingsT& pings, gsf_nav_
         return entry1.time_stamp_ < entry2.time_stamp_;
     });
 
-    auto pos = entries.begin();
-    for (gsf_mbes_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const gsf_nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
+    new_pings.resize(pings.size());
+    match_time_stamps(pings, entries, [&](size_t k, const gsf_mbes_ping& ping, const interpolation_weight& weight) {
+        const gsf_nav_entry& previous = entries[weight.previous];
+        const gsf_nav_entry& next = entries[weight.next];
 
-        mbes_ping new_ping;
+        mbes_ping& new_ping = new_pings[k];
         new_ping.time_stamp_ = ping.time_stamp_;
         new_ping.time_string_ = ping.time_string_;
         new_ping.first_in_file_ = ping.first_in_file_;
-        if (pos == entries.end()) {
-            new_ping.pos_ = entries.back().pos_;
-            new_ping.heading_ = entries.back().yaw_;
-            new_ping.pitch_ = entries.back().pitch_;
-            new_ping.roll_ = entries.back().roll_;
+        //if (ping.long_ == 0) {
+        new_ping.pos_ = weight.interpolate(previous.pos_, next.pos_);
+        /*}
+        else {
+            new_ping.pos_ = Eigen::Vector3d(ping.lat_, ping.long_, -ping.depth_);
+        }*/
+        if (ping.heading_ == 0) {
+            new_ping.heading_ = weight.interpolate_angle(previous.yaw_, next.yaw_);
+            new_ping.pitch_ = weight.interpolate(previous.pitch_, next.pitch_);
+            new_ping.roll_ = weight.interpolate(previous.roll_, next.roll_);
         }
         else {
-            if (pos == entries.begin()) {
-                //if (ping.long_ == 0) {
-                new_ping.pos_ = pos->pos_;
-                /*}
-                else {
-                    new_ping.pos_ = Eigen::Vector3d(ping.lat_, ping.long_, -ping.depth_);
-                }*/
-                if (ping.heading_ == 0) {
-                    new_ping.heading_ = pos->yaw_;
-                    new_ping.pitch_ = pos->pitch_;
-                    new_ping.roll_ = pos->roll_;
-                }
-                else {
-                    new_ping.heading_ = ping.heading_;
-                    new_ping.pitch_ = ping.pitch_;
-                    new_ping.roll_ = ping.roll_;
-                }
-            }
-            else {
-                gsf_nav_entry& previous = *(pos - 1);
-                double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-                //if (ping.long_ == 0) {
-                new_ping.pos_ = previous.pos_ + ratio*(pos->pos_ - previous.pos_);
-                /*}
-                else {
-                    new_ping.pos_ = Eigen::Vector3d(ping.lat_, ping.long_, -ping.depth_);
-                }*/
-                if (ping.heading_ == 0) {
-                    new_ping.heading_ = previous.yaw_ + ratio*(pos->yaw_ - previous.yaw_);
-                    new_ping.pitch_ = previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_);
-                    new_ping.roll_ = previous.roll_ + ratio*(pos->roll_ - previous.roll_);
-                }
-                else {
-                    new_ping.heading_ = ping.heading_;
-                    new_ping.pitch_ = ping.pitch_;
-                    new_ping.roll_ = ping.roll_;
-                    cout << "heading diff: " << previous.yaw_ + ratio*(pos->yaw_ - previous.yaw_) - new_ping.heading_ << endl;
-                    cout << "pitch diff: " << previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_) - new_ping.pitch_ << endl;
-                    cout << "roll diff: " << previous.roll_ + ratio*(pos->roll_ - previous.roll_) - new_ping.roll_ << endl;
-                }
-                //cout << "Ping timestamp: " << ping.time_string_ << ", pos time stamp: " << pos->time_string_ << endl;
-            }
+            new_ping.heading_ = ping.heading_;
+            new_ping.pitch_ = ping.pitch_;
+            new_ping.roll_ = ping.roll_;
         }
 
         //new_ping.heading_ = 0.5*M_PI-new_ping.heading_;
@@ -149,9 +107,7 @@ mbes_ping::PingsT convert_matched_entries(gsf_mbes_ping::PingsT& pings, gsf_nav_
             new_ping.beams.push_back(p + R*(sensor_p+beam_Rz*beam_Ry*beam_Rx*beam));
             //new_ping.beams.push_back(p + R*(sensor_p+beam));
         }
-
-        new_pings.push_back(new_ping);
-    }
+    });
 
     return new_pings;
 }
@@ -206,58 +162,25 @@ mbes_ping::PingsT convert_matched_entries(gsf_mbes_ping::PingsT& pings, csv_nav_
         return entry1.time_stamp_ < entry2.time_stamp_;
     });
 
-    auto pos = entries.begin();
-    for (gsf_mbes_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const csv_nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
+    new_pings.resize(pings.size());
+    match_time_stamps(pings, entries, [&](size_t i, const gsf_mbes_ping& ping, const interpolation_weight& weight) {
+        const csv_nav_entry& previous = entries[weight.previous];
+        const csv_nav_entry& next = entries[weight.next];
 
-        mbes_ping new_ping;
+        mbes_ping& new_ping = new_pings[i];
         new_ping.time_stamp_ = ping.time_stamp_;
         new_ping.time_string_ = ping.time_string_;
         new_ping.first_in_file_ = ping.first_in_file_;
-        //cout << "Ping has time: " << ping.time_string_ << ", time stamp: " << ping.time_stamp_ << endl;
-        if (pos == entries.end()) {
-            //cout << "Found only last entry with time: " << entries.back().time_string_ << ", time stamp: " << entries.back().time_stamp_ << endl;
-            new_ping.pos_ = entries.back().pos_;
-            new_ping.heading_ = entries.back().heading_;
-            new_ping.pitch_ = entries.back().pitch_;
-            new_ping.roll_ = entries.back().roll_;
+        new_ping.pos_ = weight.interpolate(previous.pos_, next.pos_);
+        if (ping.heading_ == 0) {
+            new_ping.heading_ = weight.interpolate_angle(previous.heading_, next.heading_);
+            new_ping.pitch_ = weight.interpolate(previous.pitch_, next.pitch_);
+            new_ping.roll_ = weight.interpolate(previous.roll_, next.roll_);
         }
         else {
-            if (pos == entries.begin()) {
-                //cout << "Found only first entry with time: " << pos->time_string_ << ", time stamp: " << pos->time_stamp_ << endl;
-                new_ping.pos_ = pos->pos_;
-                if (ping.heading_ == 0) {
-                    new_ping.heading_ = pos->heading_;
-                    new_ping.pitch_ = pos->pitch_;
-                    new_ping.roll_ = pos->roll_;
-                }
-                else {
-                    new_ping.heading_ = ping.heading_;
-                    new_ping.pitch_ = ping.pitch_;
-                    new_ping.roll_ = ping.roll_;
-                }
-            }
-            else {
-                //cout << "Found entry with time: " << pos->time_string_ << ", time stamp: " << pos->time_stamp_ << endl;
-                csv_nav_entry& previous = *(pos - 1);
-                double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-                new_ping.pos_ = previous.pos_ + ratio*(pos->pos_ - previous.pos_);
-                if (ping.heading_ == 0) {
-                    new_ping.heading_ = previous.heading_ + ratio*(pos->heading_ - previous.heading_);
-                    new_ping.pitch_ = previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_);
-                    new_ping.roll_ = previous.roll_ + ratio*(pos->roll_ - previous.roll_);
-                }
-                else {
-                    new_ping.heading_ = ping.heading_;
-                    new_ping.pitch_ = ping.pitch_;
-                    new_ping.roll_ = ping.roll_;
-                    //cout << "heading diff: " << previous.yaw_ + ratio*(pos->yaw_ - previous.yaw_) - new_ping.heading_ << endl;
-                    //cout << "pitch diff: " << previous.pitch_ + ratio*(pos->pitch_ - previous.pitch_) - new_ping.pitch_ << endl;
-                    //cout << "roll diff: " << previous.roll_ + ratio*(pos->roll_ - previous.roll_) - new_ping.roll_ << endl;
-                }
-            }
+            new_ping.heading_ = ping.heading_;
+            new_ping.pitch_ = ping.pitch_;
+            new_ping.roll_ = ping.roll_;
         }
 
         for (const Eigen::Vector3d& beam : ping.beams) {
@@ -270,9 +193,7 @@ mbes_ping::PingsT convert_matched_entries(gsf_mbes_ping::PingsT& pings, csv_nav_
 
             new_ping.beams.push_back(new_ping.pos_ + R*beam);
         }
-
-        new_pings.push_back(new_ping);
-    }
+    });
 
     return new_pings;
 }
@@ -389,25 +310,31 @@ gsf_nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
 	return entries;
 }
 
-// reads multibeam swaths from a .gsf file
-template <>
-gsf_mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
+// libgsf keeps global state, so calls into it are serialized when parsing folders in parallel
+static std::mutex gsf_mutex;
+
+// reads multibeam swaths from a .gsf file, calling sink with each of them
+template <typename SinkT>
+void parse_gsf_mbes_impl(const boost::filesystem::path& file, SinkT& sink)
 {
-    gsf_mbes_ping::PingsT pings;
+    bool first_in_file = true;
     if (boost::filesystem::extension(file) != ".gsf") {
-        return pings;
+        return;
     }
 
     if (!boost::filesystem::exists(file)) {
         cout << "File " << file << " does not exist, exiting..." << endl;
         exit(0);
     }
+    // held around the libgsf calls only, the sink runs unlocked
+    std::unique_lock<std::mutex> lock(gsf_mutex);
+
     int handle;
     //gsfOpen(file.string().c_str(), GSF_READONLY, &handle);
     if (gsfOpen(file.string().c_str(), GSF_READONLY, &handle) != 0 || handle < 0)
     {
         cout << "File " << file << " could not be opened!" << endl;
-        return pings;
+        return;
         //exit(0);
     }
     //cout << "Result: " << result << ", handle: " << handle << endl;
@@ -460,20 +387,36 @@ gsf_mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
             time_ss << t;
             ping.time_string_ = time_ss.str();
 
-            ping.first_in_file_ = false;
-            pings.push_back(ping);
+            ping.first_in_file_ = first_in_file;
+            first_in_file = false;
+            lock.unlock();
+            sink(std::move(ping));
+            lock.lock();
         }
     }
 
     gsfClose(handle);
+}
 
-    if (!pings.empty()) {
-        pings[0].first_in_file_ = true;
-    }
-
+template <>
+gsf_mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
+{
+    gsf_mbes_ping::PingsT pings;
+    auto sink = [&pings](gsf_mbes_ping&& ping) {
+        pings.push_back(std::move(ping));
+    };
+    parse_gsf_mbes_impl(file, sink);
     return pings;
 }
 
+template <>
+void parse_file_batches<gsf_mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<gsf_mbes_ping>::CallbackT& callback)
+{
+    batch_sink<gsf_mbes_ping> sink(batch_size, callback);
+    parse_gsf_mbes_impl(file, sink);
+    sink.flush();
+}
+
 /*
 % SOUND_SPEED_FILE VERSION 1
 % 
@@ -25,6 +25,9 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <bitset>
+#include <cstring>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <data_tools/lat_long_utm.h>
 
 # define SONAR_MESSAGE_HEADER_START 0X1601
@@ -82,14 +85,12 @@ void show_waterfall_image(const jsf_sss_ping::PingsT& pings)
 // skip data 
 void skip_data(ifstream& input, jsf_msg_header jsf_hdr)
 {
-    int nbr_bytes;
-    for (int i = 0; i < jsf_hdr.following_bytes; i++) {
-        input.read(reinterpret_cast<char*>(&nbr_bytes), sizeof(char));
-    }
+    input.seekg(jsf_hdr.following_bytes, ios::cur);
 }
 
 
-jsf_sss_ping_side process_side_scan_ping_side(ifstream& input,  jsf_msg_header& jsf_hdr,  jsf_sonar_data_msg_header& jsf_sonar_data_hdr)
+// data points to the samples following the sonar data header, size is the number of bytes available
+jsf_sss_ping_side process_side_scan_ping_side(const char* data, size_t size,  jsf_msg_header& jsf_hdr,  jsf_sonar_data_msg_header& jsf_sonar_data_hdr)
 {
     jsf_sss_ping_side ping_side;
 
@@ -100,8 +101,10 @@ jsf_sss_ping_side process_side_scan_ping_side(ifstream& input,  jsf_msg_header&
 
     if (jsf_sonar_data_hdr.data_format==0) {
         int16_t env_data;
-        for (int i = 0; i < jsf_sonar_data_hdr.spls_num_in_pkt; ++i) {
-            input.read(reinterpret_cast<char*>(&env_data), sizeof(env_data));
+        int nbr_samples = std::min(int(jsf_sonar_data_hdr.spls_num_in_pkt), int(size/sizeof(env_data)));
+        ping_side.pings.reserve(nbr_samples);
+        for (int i = 0; i < nbr_samples; ++i) {
+            memcpy(&env_data, data + i*sizeof(env_data), sizeof(env_data));
             ping_side.pings.push_back(ldexpf((float)env_data, -jsf_sonar_data_hdr.weighting_factor_n));
 
         }
@@ -109,40 +112,50 @@ jsf_sss_ping_side process_side_scan_ping_side(ifstream& input,  jsf_msg_header&
     else if (jsf_sonar_data_hdr.data_format==1) {
         cout << "Data format: " << jsf_sonar_data_hdr.data_format << "has real and imginary part, stored in pings and pings_phase respectively" << endl;
         int16_t analytic_sig_data[2];
-
-        for (int i = 0; i < jsf_sonar_data_hdr.spls_num_in_pkt; ++i) {
-            input.read(reinterpret_cast<char*>(&analytic_sig_data), sizeof(analytic_sig_data));
+        int nbr_samples = std::min(int(jsf_sonar_data_hdr.spls_num_in_pkt), int(size/sizeof(analytic_sig_data)));
+        ping_side.pings.reserve(nbr_samples);
+        ping_side.pings_phase.reserve(nbr_samples);
+        for (int i = 0; i < nbr_samples; ++i) {
+            memcpy(&analytic_sig_data, data + i*sizeof(analytic_sig_data), sizeof(analytic_sig_data));
             ping_side.pings.push_back(ldexpf((float)analytic_sig_data[0], -jsf_sonar_data_hdr.weighting_factor_n));
             ping_side.pings_phase.push_back(ldexpf((float)analytic_sig_data[1], -jsf_sonar_data_hdr.weighting_factor_n));
         }
     }
     else{
         cout << "Skip data format: " << jsf_sonar_data_hdr.data_format << endl;
-        for (int i = 0; i < jsf_hdr.following_bytes-sizeof(jsf_sonar_data_hdr); i++) {
-            int16_t nbr_bytes;
-            input.read(reinterpret_cast<char*>(&nbr_bytes), sizeof(char));
-        }
     }
     return ping_side;
  }
 
 
 
+// data points to the message data following header, size is the number of bytes available
 template <typename ReturnType, typename JsfHeaderType>
-ReturnType read_datagram(std::ifstream& input,  JsfHeaderType& header,  jsf_msg_header& jsf_hdr)
+ReturnType read_datagram(const char* data, size_t size,  JsfHeaderType& header,  jsf_msg_header& jsf_hdr)
 {
     ReturnType rtn;
 	return rtn;
 }
 
-template <typename ReturnType, typename JsfHeaderType, int Code>
-vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const boost::filesystem::path& path)
+// reads the rest of the message following jsf_hdr into buffer and decodes it
+template <typename ReturnType, typename JsfHeaderType>
+ReturnType read_message(std::ifstream& input,  jsf_msg_header& jsf_hdr, std::vector<char>& buffer)
+{
+    JsfHeaderType header;
+    input.read(reinterpret_cast<char*>(&header), sizeof(header));
+    buffer.resize(jsf_hdr.following_bytes > sizeof(header) ? jsf_hdr.following_bytes - sizeof(header) : 0);
+    input.read(buffer.data(), buffer.size());
+    return read_datagram<ReturnType, JsfHeaderType>(buffer.data(), buffer.size(), header, jsf_hdr);
+}
+
+// calls sink with each decoded message of type Code, in file order
+template <typename ReturnType, typename JsfHeaderType, int Code, typename SinkT>
+void parse_file_impl(const boost::filesystem::path& path, SinkT& sink)
 {
-    vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
     if (boost::filesystem::extension(path) != ".JSF" && boost::filesystem::extension(path) != ".jsf") {
         cout << "Not an .JSF file, skipping..." << endl;
         cout << "Extension: " << boost::filesystem::extension(path) << endl;
-        return returns;
+        return;
     }
 
     ifstream input;
@@ -150,8 +163,10 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const
     if (input.fail()) {
         cout << "ERROR: Cannot open the file..." << endl;
         exit(0);
-        return returns;
+        return;
     }
+    bool first_in_file = true;
+    std::vector<char> buffer;
     while (!input.eof()) {
         jsf_msg_header jsf_hdr;
         input.read(reinterpret_cast<char*>(&jsf_hdr),sizeof(jsf_hdr));
@@ -161,26 +176,130 @@ vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const
         }
 
         if (jsf_hdr.msg_type == Code) {
-            JsfHeaderType header;
-            input.read(reinterpret_cast<char*>(&header), sizeof(header));
-            returns.push_back(read_datagram<ReturnType, JsfHeaderType>(input, header, jsf_hdr));
-            returns.back().first_in_file_ = false;
+            ReturnType entry = read_message<ReturnType, JsfHeaderType>(input, jsf_hdr, buffer);
+            entry.first_in_file_ = first_in_file;
+            first_in_file = false;
+            sink(std::move(entry));
         }
         else {
             skip_data(input,jsf_hdr);
         }
     }
+}
+
+template <typename ReturnType, typename JsfHeaderType, int Code>
+vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_impl(const boost::filesystem::path& path)
+{
+    vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
+    auto sink = [&returns](ReturnType&& entry) {
+        returns.push_back(std::move(entry));
+    };
+    parse_file_impl<ReturnType, JsfHeaderType, Code>(path, sink);
+
+	return returns;
+}
+
+template <typename ReturnType, typename JsfHeaderType, int Code>
+vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_file_time_range_impl(const boost::filesystem::path& path, long long start_time, long long end_time)
+{
+    vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
+    if (boost::filesystem::extension(path) != ".JSF" && boost::filesystem::extension(path) != ".jsf") {
+        cout << "Not an .JSF file, skipping..." << endl;
+        cout << "Extension: " << boost::filesystem::extension(path) << endl;
+        return returns;
+    }
+
+    std_data::datagram_index index = std_data::load_or_build_datagram_index(path, &build_datagram_index);
+
+    ifstream input;
+    input.open(path.string(), ios::binary);
+    if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
+        return returns;
+    }
+    std::vector<char> buffer;
+    for (const std_data::datagram_index_entry& entry : index.filter(start_time, end_time, vector<int>{Code})) {
+        input.seekg(entry.offset);
+        jsf_msg_header jsf_hdr;
+        input.read(reinterpret_cast<char*>(&jsf_hdr), sizeof(jsf_hdr));
+        if (input.fail() || jsf_hdr.start_marker != SONAR_MESSAGE_HEADER_START) {
+            cout << "Could not read message at offset " << entry.offset << ", is the index stale?" << endl;
+            break;
+        }
+        returns.push_back(read_message<ReturnType, JsfHeaderType>(input, jsf_hdr, buffer));
+        returns.back().first_in_file_ = false;
+    }
 
     if (!returns.empty()) {
         returns[0].first_in_file_ = true;
     }
 
-	return returns;
-    
+    return returns;
+}
+
+template <typename ReturnType, typename JsfHeaderType, int Code>
+vector<ReturnType, Eigen::aligned_allocator<ReturnType> > parse_mapped_file_impl(const boost::filesystem::path& path, int nbr_threads)
+{
+    vector<ReturnType, Eigen::aligned_allocator<ReturnType> > returns;
+    if (boost::filesystem::extension(path) != ".JSF" && boost::filesystem::extension(path) != ".jsf") {
+        cout << "Not an .JSF file, skipping..." << endl;
+        cout << "Extension: " << boost::filesystem::extension(path) << endl;
+        return returns;
+    }
+
+    if (!boost::filesystem::exists(path) || boost::filesystem::file_size(path) == 0) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        return returns;
+    }
+
+    boost::interprocess::file_mapping mapping(path.string().c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+    const char* data = static_cast<const char*>(region.get_address());
+    size_t size = region.get_size();
+
+    // walk the message headers to find the offsets of the messages we want
+    vector<size_t> offsets;
+    size_t offset = 0;
+    jsf_msg_header jsf_hdr;
+    while (offset + sizeof(jsf_hdr) <= size) {
+        memcpy(&jsf_hdr, data + offset, sizeof(jsf_hdr));
+        if (jsf_hdr.start_marker != SONAR_MESSAGE_HEADER_START) {
+            cout << "Invalid file format! start marker: " << jsf_hdr.start_marker << endl;
+            break;
+        }
+        size_t next_offset = offset + sizeof(jsf_hdr) + jsf_hdr.following_bytes;
+        if (next_offset > size) {
+            cout << "Truncated message at offset " << offset << ", stopping..." << endl;
+            break;
+        }
+        if (jsf_hdr.msg_type == Code && jsf_hdr.following_bytes >= sizeof(JsfHeaderType)) {
+            offsets.push_back(offset);
+        }
+        offset = next_offset;
+    }
+
+    // the messages are independent once we know where they are
+    returns.resize(offsets.size());
+    std_data::parallel_for(offsets.size(), nbr_threads, [&](int i) {
+        const char* msg = data + offsets[i];
+        jsf_msg_header msg_hdr;
+        JsfHeaderType header;
+        memcpy(&msg_hdr, msg, sizeof(msg_hdr));
+        memcpy(&header, msg + sizeof(msg_hdr), sizeof(header));
+        returns[i] = read_datagram<ReturnType, JsfHeaderType>(msg + sizeof(msg_hdr) + sizeof(header), msg_hdr.following_bytes - sizeof(header), header, msg_hdr);
+        returns[i].first_in_file_ = false;
+    });
+
+    if (!returns.empty()) {
+        returns[0].first_in_file_ = true;
+    }
+
+    return returns;
 }
 
 template <>
-jsf_sss_ping read_datagram<jsf_sss_ping, jsf_sonar_data_msg_header>(std::ifstream& input,  jsf_sonar_data_msg_header& jsf_sonar_data_hdr,  jsf_msg_header& jsf_hdr)
+jsf_sss_ping read_datagram<jsf_sss_ping, jsf_sonar_data_msg_header>(const char* data, size_t size,  jsf_sonar_data_msg_header& jsf_sonar_data_hdr,  jsf_msg_header& jsf_hdr)
 {
     jsf_sss_ping ping;
     jsf_sss_ping_side ping_side;
@@ -199,7 +318,7 @@ jsf_sss_ping read_datagram<jsf_sss_ping, jsf_sonar_data_msg_header>(std::ifstrea
     //cout << "UTM ZONE: " << utm_zone << endl;
     ping.utm_zone = utm_zone;
     ping.pos_ = Eigen::Vector3d(easting, northing, -0.001*jsf_sonar_data_hdr.depth_in_mm);
-    ping_side = process_side_scan_ping_side(input, jsf_hdr, jsf_sonar_data_hdr);
+    ping_side = process_side_scan_ping_side(data, size, jsf_hdr, jsf_sonar_data_hdr);
 
     //cout << "Coord units: " << jsf_sonar_data_hdr.coord_units << endl;
 
@@ -232,7 +351,7 @@ jsf_sss_ping read_datagram<jsf_sss_ping, jsf_sonar_data_msg_header>(std::ifstrea
 }
 
 template <>
-jsf_dvl_ping read_datagram<jsf_dvl_ping, jsf_dvl_msg_header>(std::ifstream& input,  jsf_dvl_msg_header& jsf_dvl_msg,  jsf_msg_header& jsf_hdr)
+jsf_dvl_ping read_datagram<jsf_dvl_ping, jsf_dvl_msg_header>(const char* data, size_t size,  jsf_dvl_msg_header& jsf_dvl_msg,  jsf_msg_header& jsf_hdr)
 {
     jsf_dvl_ping ping;
     const boost::posix_time::ptime epoch = boost::posix_time::time_from_string("1970-01-01 00:00:00.000");
@@ -324,6 +443,55 @@ jsf_dvl_ping read_datagram<jsf_dvl_ping, jsf_dvl_msg_header>(std::ifstream& inpu
 
 }
 
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file)
+{
+    std_data::datagram_index index;
+
+    ifstream input;
+    input.open(file.string(), ios::binary);
+    if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
+    }
+
+    jsf_msg_header jsf_hdr;
+    long long time_stamp = 0;
+    unsigned long long offset = 0;
+    while (input.read(reinterpret_cast<char*>(&jsf_hdr), sizeof(jsf_hdr))) {
+        if (jsf_hdr.start_marker != SONAR_MESSAGE_HEADER_START) {
+            cout << "Invalid file format! start marker: " << jsf_hdr.start_marker << endl;
+            break;
+        }
+
+        // only read the time from the message types that we decode
+        if (jsf_hdr.msg_type == SONAR_DATA_TYPE) {
+            jsf_sonar_data_msg_header header;
+            if (input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+                time_stamp = 1000LL*header.ping_time_in_sec + header.today_in_ms%1000;
+            }
+        }
+        else if (jsf_hdr.msg_type == DVL_DATA_TYPE) {
+            jsf_dvl_msg_header header;
+            if (input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+                time_stamp = 1000LL*header.time_in_sec + header.ms_in_cur_sec;
+            }
+        }
+
+        std_data::datagram_index_entry entry;
+        entry.time_stamp_ = time_stamp;
+        entry.type = jsf_hdr.msg_type;
+        entry.offset = offset;
+        entry.length = sizeof(jsf_hdr) + jsf_hdr.following_bytes;
+        index.entries.push_back(entry);
+
+        offset += entry.length;
+        input.clear();
+        input.seekg(offset);
+    }
+
+    return index;
+}
+
 std_data::sss_ping::PingsT convert_to_xtf_pings(const jsf_sss_ping::PingsT& pings)
 {
     std_data::sss_ping::PingsT converted;
@@ -363,6 +531,81 @@ std_data::sss_ping::PingsT convert_to_xtf_pings(const jsf_sss_ping::PingsT& ping
 }
 
 
+// the port and starboard sides come in separate messages, this merges
+// consecutive pairs of them into one ping before passing them on to sink
+template <typename SinkT>
+class ping_side_merger {
+private:
+
+    SinkT& sink;
+    jsf_sss_ping::PingsT pending;
+    bool started;
+    bool stopped;
+
+public:
+
+    ping_side_merger(SinkT& sink) : sink(sink), started(false), stopped(false) {}
+
+    void operator()(jsf_sss_ping&& ping)
+    {
+        if (stopped) {
+            return;
+        }
+        pending.push_back(std::move(ping));
+        if (!started) {
+            // the first pair starts where two consecutive sides have the same time
+            if (pending.size() < 3) {
+                return;
+            }
+            if ((pending[0].time_stamp_ - pending[1].time_stamp_) >= 2) {
+                pending.erase(pending.begin());
+            }
+            started = true;
+        }
+        while (pending.size() >= 2) {
+            jsf_sss_ping fixed_ping = std::move(pending[0]);
+            if (fixed_ping.port.pings.size() != 0 && pending[1].stbd.pings.size() != 0) {
+                fixed_ping.stbd = std::move(pending[1].stbd);
+            }
+            else if (fixed_ping.stbd.pings.size() != 0 && pending[1].port.pings.size() != 0) {
+                fixed_ping.port = std::move(pending[1].port);
+            }
+            else {
+                cout << "Invalid data format! Channel numbers are not 0 and 1!" << endl;
+                stopped = true;
+                return;
+            }
+            pending.erase(pending.begin(), pending.begin() + 2);
+            sink(std::move(fixed_ping));
+        }
+    }
+};
+
+jsf_sss_ping::PingsT merge_ping_sides(jsf_sss_ping::PingsT pings)
+{
+    jsf_sss_ping::PingsT fixed_pings;
+    auto sink = [&fixed_pings](jsf_sss_ping&& ping) {
+        fixed_pings.push_back(std::move(ping));
+    };
+    ping_side_merger<decltype(sink)> merger(sink);
+    for (jsf_sss_ping& ping : pings) {
+        merger(std::move(ping));
+    }
+    return fixed_pings;
+}
+
+template <>
+jsf_sss_ping::PingsT parse_mapped_file<jsf_sss_ping>(const boost::filesystem::path& file, int nbr_threads)
+{
+    return merge_ping_sides(parse_mapped_file_impl<jsf_sss_ping, jsf_sonar_data_msg_header, 80>(file, nbr_threads));
+}
+
+template <>
+jsf_dvl_ping::PingsT parse_mapped_file<jsf_dvl_ping>(const boost::filesystem::path& file, int nbr_threads)
+{
+    return parse_mapped_file_impl<jsf_dvl_ping, jsf_dvl_msg_header, 2080>(file, nbr_threads);
+}
+
 } // namespace jsf_data
 
 
@@ -374,34 +617,7 @@ using namespace jsf_data;
 template <>
 jsf_sss_ping::PingsT parse_file<jsf_sss_ping>(const boost::filesystem::path& file)
 {
-    jsf_sss_ping::PingsT pings = parse_file_impl<jsf_sss_ping, jsf_sonar_data_msg_header, 80>(file);
-    jsf_sss_ping::PingsT fixed_pings;
-    int start;
-    if ((pings[0].time_stamp_ - pings[1].time_stamp_) < 2) {
-        start = 0;
-    }
-    else if ((pings[1].time_stamp_ - pings[2].time_stamp_) < 2) {
-        start = 1;
-    }
-    for (int i = start; i < pings.size()-1; i+=2) {
-        jsf_sss_ping fixed_ping;
-        if (pings[i].port.pings.size() != 0 && pings[i+1].stbd.pings.size() != 0) {
-
-            fixed_ping = pings[i];
-            fixed_ping.stbd = pings[i+1].stbd;
-            fixed_pings.push_back(fixed_ping);
-        }
-        else if (pings[i].stbd.pings.size() != 0 && pings[i+1].port.pings.size() != 0) {
-            fixed_ping = pings[i];
-            fixed_ping.port = pings[i+1].port;
-            fixed_pings.push_back(fixed_ping);
-        }
-        else {
-            cout << "Invalid data format! Channel numbers are not 0 and 1!" << endl;
-            break;
-        }
-    }
-    return fixed_pings;
+    return merge_ping_sides(parse_file_impl<jsf_sss_ping, jsf_sonar_data_msg_header, 80>(file));
 }
 
 template <>
@@ -410,4 +626,33 @@ jsf_dvl_ping::PingsT parse_file<jsf_dvl_ping>(const boost::filesystem::path& fil
     return parse_file_impl<jsf_dvl_ping, jsf_dvl_msg_header, 2080>(file);
 }
 
+template <>
+void parse_file_batches<jsf_sss_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<jsf_sss_ping>::CallbackT& callback)
+{
+    batch_sink<jsf_sss_ping> sink(batch_size, callback);
+    ping_side_merger<batch_sink<jsf_sss_ping> > merger(sink);
+    parse_file_impl<jsf_sss_ping, jsf_sonar_data_msg_header, 80>(file, merger);
+    sink.flush();
+}
+
+template <>
+void parse_file_batches<jsf_dvl_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<jsf_dvl_ping>::CallbackT& callback)
+{
+    batch_sink<jsf_dvl_ping> sink(batch_size, callback);
+    parse_file_impl<jsf_dvl_ping, jsf_dvl_msg_header, 2080>(file, sink);
+    sink.flush();
+}
+
+template <>
+jsf_sss_ping::PingsT parse_file_time_range<jsf_sss_ping>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return merge_ping_sides(parse_file_time_range_impl<jsf_sss_ping, jsf_sonar_data_msg_header, 80>(file, start_time, end_time));
+}
+
+template <>
+jsf_dvl_ping::PingsT parse_file_time_range<jsf_dvl_ping>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    return parse_file_time_range_impl<jsf_dvl_ping, jsf_dvl_msg_header, 2080>(file, start_time, end_time);
+}
+
 } // namespace std_data
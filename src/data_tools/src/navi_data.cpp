@@ -12,6 +12,8 @@
 #include <data_tools/navi_data.h>
 #include <data_tools/colormap.h>
 #include <data_tools/transforms.h>
+#include <data_tools/ascii_parsing.h>
+#include <data_tools/time_interpolation.h>
 
 #include <fstream>
 #include <sstream>
@@ -52,20 +54,10 @@ void match_timestamps(mbes_ping::PingsT& pings, nav_entry::EntriesT& entries)
     }
     */
 
-    auto pos = entries.begin();
-    for (mbes_ping& ping : pings) {
-        pos = std::find_if(pos, entries.end(), [&](const nav_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
-        if (pos == entries.end()) {
-            //cout << "Ping " << ping.time_string_ << " closest to LAST Entry " << entries.back().time_string_ << endl;
-            ping.pos_ = entries.back().pos_;
-        }
-        else {
-            ping.pos_ = pos->pos_;
-            //cout << "Ping " << ping.time_string_ << " closest to Entry " << pos->time_string_ << endl;
-        }
-    }
+    // each ping gets the position of the first entry after it
+    match_time_stamps(pings, entries, [&](size_t i, mbes_ping& ping, const interpolation_weight& weight) {
+        ping.pos_ = entries[weight.next].pos_;
+    });
 }
 
 
@@ -442,6 +434,118 @@ tuple<ObsT, TransT, AngsT, MatchesT, BBsT, ObsT> create_submaps(const mbes_ping:
 
 namespace std_data {
 
+namespace {
+
+// calendar time as given in the NaviEdit exports, converted arithmetically
+// since a boost locale parse per ping dominates the parse time
+struct navi_time {
+    int year, month, day, hour, minute, second, microseconds;
+
+    // days since 1970-01-01 in the proleptic gregorian calendar
+    long long days_since_epoch() const
+    {
+        int y = year - (month <= 2);
+        long long era = (y >= 0 ? y : y - 399) / 400;
+        long long year_of_era = y - era*400;
+        long long day_of_year = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;
+        long long day_of_era = year_of_era*365 + year_of_era/4 - year_of_era/100 + day_of_year;
+        return era*146097 + day_of_era - 719468;
+    }
+
+    // milliseconds since epoch, truncated like boost::posix_time::time_duration::total_milliseconds
+    long long time_stamp() const
+    {
+        long long seconds = days_since_epoch()*86400LL + hour*3600LL + minute*60LL + second;
+        return 1000LL*seconds + microseconds/1000;
+    }
+
+    // same format as streaming a boost::posix_time::ptime, e.g. 2015-Jun-12 15:30:12.345000
+    string time_string() const
+    {
+        static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+        char buffer[64];
+        int n = snprintf(buffer, sizeof(buffer), "%04d-%s-%02d %02d:%02d:%02d", year, months[std::min(std::max(month, 1), 12) - 1], day, hour, minute, second);
+        if (microseconds != 0) {
+            snprintf(buffer + n, sizeof(buffer) - n, ".%06d", microseconds);
+        }
+        return string(buffer);
+    }
+};
+
+// parses seconds with an optional fraction like 12.345
+bool parse_seconds(const char*& p, const char* end, navi_time& t)
+{
+    if (!ascii_parsing::parse_int(p, end, t.second)) {
+        return false;
+    }
+    t.microseconds = 0;
+    if (p != end && *p == '.') {
+        ++p;
+        int scale = 100000;
+        for (; p != end && ascii_parsing::is_digit(*p); ++p) {
+            t.microseconds += scale*(*p - '0');
+            scale /= 10;
+        }
+    }
+    return true;
+}
+
+bool parse_char(const char*& p, const char* end, char c)
+{
+    if (p == end || *p != c) {
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+// parses "%Y %m%d%H%M %S%f", e.g. 2015 06121530 12.345
+bool parse_mbes_time(const char*& p, const char* end, navi_time& t)
+{
+    ascii_parsing::skip_separators(p, end);
+    if (!ascii_parsing::parse_int(p, end, t.year)) {
+        return false;
+    }
+    ascii_parsing::skip_separators(p, end);
+    if (!ascii_parsing::parse_digits(p, end, 2, t.month) || !ascii_parsing::parse_digits(p, end, 2, t.day) ||
+        !ascii_parsing::parse_digits(p, end, 2, t.hour) || !ascii_parsing::parse_digits(p, end, 2, t.minute)) {
+        return false;
+    }
+    ascii_parsing::skip_separators(p, end);
+    return parse_seconds(p, end, t);
+}
+
+// parses "%Y.%m.%d %H:%M:%S%f", e.g. 2015.06.12 15:30:12.345
+bool parse_nav_time(const char*& p, const char* end, navi_time& t)
+{
+    ascii_parsing::skip_separators(p, end);
+    if (!ascii_parsing::parse_int(p, end, t.year) || !parse_char(p, end, '.') ||
+        !ascii_parsing::parse_int(p, end, t.month) || !parse_char(p, end, '.') ||
+        !ascii_parsing::parse_int(p, end, t.day)) {
+        return false;
+    }
+    ascii_parsing::skip_separators(p, end);
+    if (!ascii_parsing::parse_int(p, end, t.hour) || !parse_char(p, end, ':') ||
+        !ascii_parsing::parse_int(p, end, t.minute) || !parse_char(p, end, ':')) {
+        return false;
+    }
+    return parse_seconds(p, end, t);
+}
+
+// parses the next separated numbers into values, returns false if there are fewer than n
+bool parse_numbers(const char*& p, const char* end, double* values, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        ascii_parsing::skip_separators(p, end);
+        if (!ascii_parsing::parse_number(p, end, values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
 // Extract space-separated numbers: Nav files
 // 0: Year
 // 1: Time (day, hour)
@@ -456,63 +560,80 @@ namespace std_data {
 // 10: Heave
 // 11: Pitch
 // 12: Roll
-template <>
-mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
+template <typename SinkT>
+void parse_navi_mbes_impl(const boost::filesystem::path& file, SinkT& sink)
 {
-    mbes_ping::PingsT pings;
+    bool first_in_file = true;
 
     string line;
     std::ifstream infile(file.string());
 
+    // the beams are collected in a buffer that keeps its capacity between pings,
+    // each ping then gets a single allocation of the right size
     mbes_ping ping;
-    string time;
+    decltype(ping.beams) beams;
+    navi_time t;
     int beam_id;
-    double tide, x, y, z;
-    string year_string, date_string, second_string;
-    const std::locale loc = std::locale(std::locale::classic(), new boost::posix_time::time_input_facet("%Y %m%d%H%M %S%f"));
-    const boost::posix_time::ptime epoch = boost::posix_time::time_from_string("1970-01-01 00:00:00.000");
+    double values[8]; // x, y, z, tide, heading, heave, pitch, roll
 
     std::getline(infile, line); // throw away first line as it contains description
-    int counter = 0;
     while (std::getline(infile, line))  // this does the checking!
     {
-        istringstream iss(line);
-
-        iss >> year_string >> date_string >> second_string >> ping.id_ >> beam_id >> x >> y >> z >> tide >> ping.heading_ >> ping.heave_ >> ping.pitch_ >> ping.roll_;
+        const char* p = line.data();
+        const char* end = p + line.size();
 
-        /*
-        if (beam_id != 255 && counter % 10 != 0) {
-            ++counter;
+        if (!parse_mbes_time(p, end, t)) {
+            continue;
+        }
+        int id;
+        ascii_parsing::skip_separators(p, end);
+        if (!ascii_parsing::parse_int(p, end, id)) {
+            continue;
+        }
+        ascii_parsing::skip_separators(p, end);
+        if (!ascii_parsing::parse_int(p, end, beam_id) || !parse_numbers(p, end, values, 8)) {
             continue;
         }
-        */
 
-        ping.beams.push_back(Vector3d(x, y, -z));
+        beams.push_back(Vector3d(values[0], values[1], -values[2]));
 
         if (beam_id == 255) {
-            ping.first_in_file_ = pings.empty();
-            std::istringstream is(year_string + " " + date_string + " " + second_string);
-            is.imbue(loc);
-            boost::posix_time::ptime t;
-            is >> t;
-            boost::posix_time::time_duration const diff = t - epoch;
-            ping.time_stamp_ = diff.total_milliseconds();
-            stringstream time_ss;
-            time_ss << t;
-            ping.time_string_ = time_ss.str();
-            //cout << year_string << " " << date_string << " " << second_string << endl;
-            //cout << t << endl;
-
-            pings.push_back(ping);
-            ping.beams.resize(0);
+            ping.id_ = id;
+            ping.heading_ = values[4];
+            ping.heave_ = values[5];
+            ping.pitch_ = values[6];
+            ping.roll_ = values[7];
+            ping.first_in_file_ = first_in_file;
+            first_in_file = false;
+            ping.time_stamp_ = t.time_stamp();
+            ping.time_string_ = t.time_string();
+            ping.beams.assign(beams.begin(), beams.end());
+
+            sink(std::move(ping));
+            beams.clear();
         }
-
-        ++counter;
     }
+}
 
+template <>
+mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
+{
+    mbes_ping::PingsT pings;
+    auto sink = [&pings](mbes_ping&& ping) {
+        pings.push_back(std::move(ping));
+    };
+    parse_navi_mbes_impl(file, sink);
     return pings;
 }
 
+template <>
+void parse_file_batches<mbes_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<mbes_ping>::CallbackT& callback)
+{
+    batch_sink<mbes_ping> sink(batch_size, callback);
+    parse_navi_mbes_impl(file, sink);
+    sink.flush();
+}
+
 // Extract space-separated numbers: Nav files
 // 0: Day
 // 1: Time
@@ -520,45 +641,52 @@ mbes_ping::PingsT parse_file(const boost::filesystem::path& file)
 // 3: Northing
 // 4: Depth (given in positive values!)
 // 5: Zeros
-template <>
-nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
+template <typename SinkT>
+void parse_navi_nav_impl(const boost::filesystem::path& file, SinkT& sink)
 {
-    nav_entry::EntriesT entries;
+    bool first_in_file = true;
 
     nav_entry entry;
-    double x, y, z;
-    string date_string, time_string;
-    const std::locale loc = std::locale(std::locale::classic(), new boost::posix_time::time_input_facet("%Y.%m.%d %H:%M:%S%f"));
-    const boost::posix_time::ptime epoch = boost::posix_time::time_from_string("1970-01-01 00:00:00.000");
+    navi_time t;
+    double values[3]; // x, y, z
 
     string line;
     std::ifstream infile(file.string());
     while (std::getline(infile, line))  // this does the checking!
     {
-        istringstream iss(line);
-
-        //iss >> entry.year_ >> entry.time_stamp_ >> x >> y >> z;
-        iss >> date_string >> time_string >> x >> y >> z;
-        entry.pos_ = Vector3d(x, y, -z);
-
-        std::istringstream is(date_string + " " + time_string);
-        is.imbue(loc);
-        boost::posix_time::ptime t;
-        is >> t;
-        boost::posix_time::time_duration const diff = t - epoch;
-        entry.time_stamp_ = diff.total_milliseconds();
-        stringstream time_ss;
-        time_ss << t;
-        entry.time_string_ = time_ss.str();
-
-        //cout << date_string << " " << time_string << endl;
-        //cout << t << endl;
-        //cout << ms << endl;
-        entry.first_in_file_ = entries.empty();
-
-        entries.push_back(entry);
+        const char* p = line.data();
+        const char* end = p + line.size();
+
+        if (!parse_nav_time(p, end, t) || !parse_numbers(p, end, values, 3)) {
+            continue;
+        }
+
+        entry.pos_ = Vector3d(values[0], values[1], -values[2]);
+        entry.time_stamp_ = t.time_stamp();
+        entry.time_string_ = t.time_string();
+        entry.first_in_file_ = first_in_file;
+        first_in_file = false;
+
+        sink(std::move(entry));
     }
+}
 
+template <>
+nav_entry::EntriesT parse_file(const boost::filesystem::path& file)
+{
+    nav_entry::EntriesT entries;
+    auto sink = [&entries](nav_entry&& entry) {
+        entries.push_back(std::move(entry));
+    };
+    parse_navi_nav_impl(file, sink);
     return entries;
 }
+
+template <>
+void parse_file_batches<nav_entry>(const boost::filesystem::path& file, int batch_size, const batch_sink<nav_entry>::CallbackT& callback)
+{
+    batch_sink<nav_entry> sink(batch_size, callback);
+    parse_navi_nav_impl(file, sink);
+    sink.flush();
+}
 } // namespace std_data
@@ -0,0 +1,287 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <data_tools/ping_cache.h>
+
+#include <fstream>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+namespace std_data {
+
+namespace {
+
+const char ping_cache_magic[8] = { 'M', 'B', 'E', 'S', 'P', 'I', 'N', 'G' };
+const uint32_t ping_cache_version = 1;
+const uint64_t ping_cache_alignment = 64;
+
+uint64_t align_offset(uint64_t offset)
+{
+    return (offset + ping_cache_alignment - 1) / ping_cache_alignment * ping_cache_alignment;
+}
+
+// pads the stream with zeros up to offset, the start of the next section
+void pad_to(std::ofstream& out, uint64_t offset)
+{
+    static const char zeros[ping_cache_alignment] = {};
+    uint64_t pos = out.tellp();
+    out.write(zeros, offset - pos);
+}
+
+// checks that count elements of elem_size starting at offset lie inside a mapping of size bytes
+bool section_fits(uint64_t offset, uint64_t count, uint64_t elem_size, uint64_t size)
+{
+    return offset <= size && count <= (size - offset) / elem_size;
+}
+
+// checks that an offset column starts at 0, never decreases and ends at total
+bool offsets_valid(const uint64_t* offsets, uint64_t nbr_pings, uint64_t total)
+{
+    if (offsets[0] != 0 || offsets[nbr_pings] != total) {
+        return false;
+    }
+    for (uint64_t i = 0; i < nbr_pings; ++i) {
+        if (offsets[i + 1] < offsets[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void write_value(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+void write_ping_cache(const mbes_ping::PingsT& pings, const boost::filesystem::path& path)
+{
+    ping_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ping_cache_magic, sizeof(header.magic));
+    header.version = ping_cache_version;
+    header.nbr_pings = pings.size();
+    for (const mbes_ping& ping : pings) {
+        header.nbr_beams += ping.beams.size();
+        header.nbr_back_scatter += ping.back_scatter.size();
+    }
+
+    uint64_t n = header.nbr_pings;
+    header.beam_offsets = align_offset(sizeof(header));
+    header.back_scatter_offsets = align_offset(header.beam_offsets + (n + 1)*sizeof(uint64_t));
+    header.ids = align_offset(header.back_scatter_offsets + (n + 1)*sizeof(uint64_t));
+    header.time_stamps = align_offset(header.ids + n*sizeof(uint32_t));
+    header.first_in_file = align_offset(header.time_stamps + n*sizeof(int64_t));
+    header.poses = align_offset(header.first_in_file + n*sizeof(uint8_t));
+    header.attitudes = align_offset(header.poses + 3*n*sizeof(double));
+    header.beams = align_offset(header.attitudes + 4*n*sizeof(double));
+    header.back_scatter = align_offset(header.beams + 3*header.nbr_beams*sizeof(double));
+
+    std::ofstream out(path.string(), std::ofstream::binary);
+    if (!out.is_open()) {
+        cout << "Could not open " << path << " for writing, exiting..." << endl;
+        exit(0);
+    }
+
+    write_value(out, header);
+
+    pad_to(out, header.beam_offsets);
+    uint64_t offset = 0;
+    for (const mbes_ping& ping : pings) {
+        write_value(out, offset);
+        offset += ping.beams.size();
+    }
+    write_value(out, offset);
+
+    pad_to(out, header.back_scatter_offsets);
+    offset = 0;
+    for (const mbes_ping& ping : pings) {
+        write_value(out, offset);
+        offset += ping.back_scatter.size();
+    }
+    write_value(out, offset);
+
+    pad_to(out, header.ids);
+    for (const mbes_ping& ping : pings) {
+        write_value(out, uint32_t(ping.id_));
+    }
+
+    pad_to(out, header.time_stamps);
+    for (const mbes_ping& ping : pings) {
+        write_value(out, int64_t(ping.time_stamp_));
+    }
+
+    pad_to(out, header.first_in_file);
+    for (const mbes_ping& ping : pings) {
+        write_value(out, uint8_t(ping.first_in_file_));
+    }
+
+    pad_to(out, header.poses);
+    for (const mbes_ping& ping : pings) {
+        out.write(reinterpret_cast<const char*>(ping.pos_.data()), 3*sizeof(double));
+    }
+
+    pad_to(out, header.attitudes);
+    for (const mbes_ping& ping : pings) {
+        const double attitude[] = { ping.heading_, ping.heave_, ping.pitch_, ping.roll_ };
+        out.write(reinterpret_cast<const char*>(attitude), sizeof(attitude));
+    }
+
+    // Vector3d is unpadded, so the beams of a ping can be written in one go
+    pad_to(out, header.beams);
+    for (const mbes_ping& ping : pings) {
+        if (!ping.beams.empty()) {
+            out.write(reinterpret_cast<const char*>(ping.beams[0].data()), 3*ping.beams.size()*sizeof(double));
+        }
+    }
+
+    pad_to(out, header.back_scatter);
+    for (const mbes_ping& ping : pings) {
+        if (!ping.back_scatter.empty()) {
+            out.write(reinterpret_cast<const char*>(ping.back_scatter.data()), ping.back_scatter.size()*sizeof(double));
+        }
+    }
+}
+
+std::string mbes_ping_view::time_string() const
+{
+    return time_string_from_time_stamp(time_stamp_);
+}
+
+mbes_ping mbes_ping_view::to_ping() const
+{
+    mbes_ping ping;
+    ping.id_ = id_;
+    ping.time_stamp_ = time_stamp_;
+    ping.time_string_ = time_string();
+    ping.heading_ = heading_;
+    ping.heave_ = heave_;
+    ping.pitch_ = pitch_;
+    ping.roll_ = roll_;
+    ping.first_in_file_ = first_in_file_;
+    ping.pos_ = pos_;
+    ping.beams.resize(beams.rows());
+    for (int i = 0; i < beams.rows(); ++i) {
+        ping.beams[i] = beams.row(i).transpose();
+    }
+    ping.back_scatter.assign(back_scatter.data(), back_scatter.data() + back_scatter.size());
+    return ping;
+}
+
+mapped_pings::mapped_pings(const boost::filesystem::path& path) : data(nullptr), nbr_pings(0)
+{
+    memset(&header, 0, sizeof(header));
+
+    if (!boost::filesystem::exists(path) || boost::filesystem::file_size(path) < sizeof(header)) {
+        cout << "ERROR: Cannot open ping cache " << path << endl;
+        return;
+    }
+
+    mapping = boost::interprocess::file_mapping(path.string().c_str(), boost::interprocess::read_only);
+    region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+    const char* mapped = static_cast<const char*>(region.get_address());
+    memcpy(&header, mapped, sizeof(header));
+
+    if (memcmp(header.magic, ping_cache_magic, sizeof(header.magic)) != 0 || header.version != ping_cache_version) {
+        cout << "ERROR: " << path << " is not a ping cache of version " << ping_cache_version << endl;
+        memset(&header, 0, sizeof(header));
+        return;
+    }
+    const uint64_t size = region.get_size();
+    const uint64_t n = header.nbr_pings;
+    if (n == std::numeric_limits<uint64_t>::max() ||
+        !section_fits(header.beam_offsets, n + 1, sizeof(uint64_t), size) ||
+        !section_fits(header.back_scatter_offsets, n + 1, sizeof(uint64_t), size) ||
+        !section_fits(header.ids, n, sizeof(uint32_t), size) ||
+        !section_fits(header.time_stamps, n, sizeof(int64_t), size) ||
+        !section_fits(header.first_in_file, n, sizeof(uint8_t), size) ||
+        !section_fits(header.poses, n, 3*sizeof(double), size) ||
+        !section_fits(header.attitudes, n, 4*sizeof(double), size) ||
+        !section_fits(header.beams, header.nbr_beams, 3*sizeof(double), size) ||
+        !section_fits(header.back_scatter, header.nbr_back_scatter, sizeof(double), size)) {
+        cout << "ERROR: Ping cache " << path << " is truncated" << endl;
+        memset(&header, 0, sizeof(header));
+        return;
+    }
+    // the views index the beams and back scatter through these, so they have to stay in range
+    if (!offsets_valid(reinterpret_cast<const uint64_t*>(mapped + header.beam_offsets), n, header.nbr_beams) ||
+        !offsets_valid(reinterpret_cast<const uint64_t*>(mapped + header.back_scatter_offsets), n, header.nbr_back_scatter)) {
+        cout << "ERROR: Ping cache " << path << " has inconsistent offsets" << endl;
+        memset(&header, 0, sizeof(header));
+        return;
+    }
+
+    data = mapped;
+    nbr_pings = header.nbr_pings;
+}
+
+mbes_ping_view mapped_pings::operator[](size_t i) const
+{
+    const uint64_t* beam_offsets = section<uint64_t>(header.beam_offsets);
+    const uint64_t* back_scatter_offsets = section<uint64_t>(header.back_scatter_offsets);
+    const double* attitude = section<double>(header.attitudes) + 4*i;
+
+    return mbes_ping_view {
+        section<uint32_t>(header.ids)[i],
+        section<int64_t>(header.time_stamps)[i],
+        attitude[0], attitude[1], attitude[2], attitude[3],
+        section<uint8_t>(header.first_in_file)[i] != 0,
+        Eigen::Map<const Eigen::Vector3d>(section<double>(header.poses) + 3*i),
+        mbes_ping_view::BeamsT(section<double>(header.beams) + 3*beam_offsets[i], beam_offsets[i + 1] - beam_offsets[i], 3),
+        Eigen::Map<const Eigen::VectorXd>(section<double>(header.back_scatter) + back_scatter_offsets[i], back_scatter_offsets[i + 1] - back_scatter_offsets[i])
+    };
+}
+
+mapped_pings::ColumnsT<double, 3> mapped_pings::beams() const
+{
+    return ColumnsT<double, 3>(section<double>(header.beams), header.nbr_beams, 3);
+}
+
+mapped_pings::ColumnsT<double, 1> mapped_pings::back_scatter() const
+{
+    return ColumnsT<double, 1>(section<double>(header.back_scatter), header.nbr_back_scatter, 1);
+}
+
+mapped_pings::ColumnsT<uint64_t, 1> mapped_pings::beam_offsets() const
+{
+    return ColumnsT<uint64_t, 1>(section<uint64_t>(header.beam_offsets), data != nullptr ? nbr_pings + 1 : 0, 1);
+}
+
+mapped_pings::ColumnsT<long long, 1> mapped_pings::time_stamps() const
+{
+    return ColumnsT<long long, 1>(section<long long>(header.time_stamps), nbr_pings, 1);
+}
+
+mapped_pings::ColumnsT<double, 3> mapped_pings::poses() const
+{
+    return ColumnsT<double, 3>(section<double>(header.poses), nbr_pings, 3);
+}
+
+mapped_pings::ColumnsT<double, 4> mapped_pings::attitudes() const
+{
+    return ColumnsT<double, 4>(section<double>(header.attitudes), nbr_pings, 4);
+}
+
+mbes_ping::PingsT mapped_pings::to_pings() const
+{
+    mbes_ping::PingsT pings;
+    pings.reserve(nbr_pings);
+    for (size_t i = 0; i < nbr_pings; ++i) {
+        pings.push_back((*this)[i].to_ping());
+    }
+    return pings;
+}
+
+} // namespace std_data
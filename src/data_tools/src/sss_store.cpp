@@ -0,0 +1,185 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <data_tools/sss_store.h>
+
+#include <cstring>
+
+using namespace std;
+
+namespace std_data {
+
+namespace {
+
+// written before the cereal archive, to tell compressed files from plain sss_ping::PingsT archives
+const char sss_store_magic[8] = { 'S', 'S', 'S', 'C', 'H', 'U', 'N', 'K' };
+
+} // namespace
+
+sss_ping_chunk sss_ping_chunk::compress(sss_ping::PingsT::const_iterator begin, sss_ping::PingsT::const_iterator end)
+{
+    sss_ping_chunk chunk;
+    chunk.pings.reserve(std::distance(begin, end));
+    for (auto iter = begin; iter != end; ++iter) {
+        chunk.port_sizes.push_back(iter->port.pings.size());
+        chunk.stbd_sizes.push_back(iter->stbd.pings.size());
+        sss_codec::encode_samples(iter->port.pings, chunk.data);
+        sss_codec::encode_samples(iter->stbd.pings, chunk.data);
+        chunk.pings.push_back(*iter);
+        chunk.pings.back().port.pings = std::vector<int>();
+        chunk.pings.back().stbd.pings = std::vector<int>();
+    }
+    chunk.data.shrink_to_fit();
+    return chunk;
+}
+
+bool sss_ping_chunk::decompress(sss_ping::PingsT& decompressed) const
+{
+    decompressed = pings;
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    for (size_t i = 0; i < decompressed.size() && p != nullptr; ++i) {
+        decompressed[i].port.pings.resize(port_sizes[i]);
+        decompressed[i].stbd.pings.resize(stbd_sizes[i]);
+        p = sss_codec::decode_samples(p, end, decompressed[i].port.pings.data(), port_sizes[i]);
+        if (p != nullptr) {
+            p = sss_codec::decode_samples(p, end, decompressed[i].stbd.pings.data(), stbd_sizes[i]);
+        }
+    }
+    if (p == nullptr) {
+        decompressed.clear();
+        return false;
+    }
+    return true;
+}
+
+size_t compressed_sss_pings::size() const
+{
+    size_t nbr_pings = 0;
+    for (const sss_ping_chunk& chunk : chunks) {
+        nbr_pings += chunk.pings.size();
+    }
+    return nbr_pings;
+}
+
+sss_ping compressed_sss_pings::ping(size_t i) const
+{
+    // all chunks but the last one are full
+    size_t c = pings_per_chunk > 0 ? i / pings_per_chunk : chunks.size();
+    size_t j = pings_per_chunk > 0 ? i % pings_per_chunk : 0;
+    if (i >= size() || c >= chunks.size() || j >= chunks[c].pings.size()) {
+        cout << "ERROR: Ping " << i << " out of range, there are " << size() << " pings" << endl;
+        return sss_ping();
+    }
+    sss_ping decompressed;
+    bool valid = chunks[c].for_each_ping([&](size_t k, const sss_ping& ping, const std::vector<int>& port, const std::vector<int>& stbd) {
+        if (k == j) {
+            decompressed = ping;
+            decompressed.port.pings = port;
+            decompressed.stbd.pings = stbd;
+        }
+    }, j + 1);
+    if (!valid) {
+        cout << "ERROR: Corrupt sss ping chunk, could not decompress ping " << i << endl;
+        return sss_ping();
+    }
+    return decompressed;
+}
+
+bool compressed_sss_pings::decompress(sss_ping::PingsT& decompressed, int nbr_threads) const
+{
+    std::vector<sss_ping::PingsT> parts(chunks.size());
+    std::vector<char> valid(chunks.size());
+    parallel_for(chunks.size(), nbr_threads, [&](int i) {
+        valid[i] = chunks[i].decompress(parts[i]);
+    });
+    if (std::find(valid.begin(), valid.end(), false) != valid.end()) {
+        decompressed.clear();
+        return false;
+    }
+    decompressed = concatenate(parts);
+    return true;
+}
+
+compressed_sss_pings compress_sss_pings(const sss_ping::PingsT& pings, int pings_per_chunk, int nbr_threads)
+{
+    compressed_sss_pings compressed;
+    compressed.pings_per_chunk = std::max(pings_per_chunk, 1);
+    int nbr_chunks = (pings.size() + compressed.pings_per_chunk - 1) / compressed.pings_per_chunk;
+    compressed.chunks.resize(nbr_chunks);
+    parallel_for(nbr_chunks, nbr_threads, [&](int i) {
+        auto begin = pings.begin() + i*compressed.pings_per_chunk;
+        auto end = pings.begin() + std::min(size_t(i + 1)*compressed.pings_per_chunk, pings.size());
+        compressed.chunks[i] = sss_ping_chunk::compress(begin, end);
+    });
+    return compressed;
+}
+
+template <>
+sss_ping::PingsT read_data<sss_ping::PingsT>(const boost::filesystem::path& path)
+{
+    if (!boost::filesystem::exists(path)) {
+        std::cout << "File " << path << " does not exist..." << std::endl;
+        exit(0);
+    }
+
+    std::ifstream is(path.string(), std::ifstream::binary);
+    char magic[sizeof(sss_store_magic)] = {};
+    is.read(magic, sizeof(magic));
+    if (!is || memcmp(magic, sss_store_magic, sizeof(magic)) != 0) {
+        // written as a plain archive by earlier versions
+        is.clear();
+        is.seekg(0);
+        sss_ping::PingsT rtn;
+        {
+            cereal::BinaryInputArchive archive(is);
+            archive(rtn);
+        }
+        return rtn;
+    }
+
+    compressed_sss_pings compressed;
+    {
+        cereal::BinaryInputArchive archive(is);
+        archive(compressed);
+    }
+    is.close();
+
+    for (const sss_ping_chunk& chunk : compressed.chunks) {
+        if (chunk.port_sizes.size() != chunk.pings.size() || chunk.stbd_sizes.size() != chunk.pings.size()) {
+            cout << "ERROR: Inconsistent sss ping chunk in " << path << ", exiting..." << endl;
+            exit(0);
+        }
+    }
+
+    sss_ping::PingsT rtn;
+    if (!compressed.decompress(rtn)) {
+        cout << "ERROR: Corrupt sss ping chunk in " << path << ", exiting..." << endl;
+        exit(0);
+    }
+    return rtn;
+}
+
+template <>
+void write_data<sss_ping::PingsT>(sss_ping::PingsT& data, const boost::filesystem::path& path)
+{
+    compressed_sss_pings compressed = compress_sss_pings(data);
+
+    std::ofstream os(path.string(), std::ofstream::binary);
+    os.write(sss_store_magic, sizeof(sss_store_magic));
+	{
+		cereal::BinaryOutputArchive archive(os);
+        archive(compressed);
+	}
+    os.close();
+}
+
+} // namespace std_data
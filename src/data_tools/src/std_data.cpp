@@ -22,15 +22,28 @@ namespace std_data {
 // instantiate all versions needed to read the structs
 template nav_entry::EntriesT read_data<nav_entry::EntriesT>(const boost::filesystem::path& path);
 template mbes_ping::PingsT read_data<mbes_ping::PingsT>(const boost::filesystem::path& path);
-template sss_ping::PingsT read_data<sss_ping::PingsT>(const boost::filesystem::path& path);
 template pt_submaps read_data<pt_submaps>(const boost::filesystem::path& path);
 
 // instantiate all versions needed to write the structs
 template void write_data<nav_entry::EntriesT>(nav_entry::EntriesT& data, const boost::filesystem::path& path);
 template void write_data<mbes_ping::PingsT>(mbes_ping::PingsT& data, const boost::filesystem::path& path);
-template void write_data<sss_ping::PingsT>(sss_ping::PingsT& data, const boost::filesystem::path& path);
 template void write_data<pt_submaps>(pt_submaps& data, const boost::filesystem::path& path);
 
+std::vector<boost::filesystem::path> folder_files(const boost::filesystem::path& folder)
+{
+    std::vector<boost::filesystem::path> files;
+    for (auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(folder), {})) {
+        if (DEBUG_OUTPUT) cout << entry << "\n";
+	    if (boost::filesystem::is_directory(entry.path())) {
+		    continue;
+		}
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    return files;
+}
+
 std::string time_string_from_time_stamp(long long time_stamp_)
 {
     // TODO: can this be a static variable instead? we could also use that in other libraries
@@ -10,6 +10,7 @@
  */
 
 #include <data_tools/xtf_data.h>
+#include <data_tools/time_interpolation.h>
 extern "C" {
 #include <libxtf/xtf_reader.h>
 }
@@ -80,6 +81,27 @@ Eigen::MatrixXd make_eigen_waterfall_image(const xtf_sss_ping::PingsT& pings)
     return swath_img;
 }
 
+Eigen::MatrixXd make_eigen_waterfall_image(const std_data::compressed_sss_pings& pings, int nbr_threads)
+{
+    int rows = pings.size();
+    const std_data::sss_ping_chunk& first = pings.chunks[0];
+    int port_cols = first.port_sizes[0];
+    int stbd_cols = first.stbd_sizes[0];
+    Eigen::MatrixXd swath_img = Eigen::MatrixXd::Zero(rows, port_cols + stbd_cols);
+    std_data::parallel_for(pings.chunks.size(), nbr_threads, [&](int c) {
+        int offset = c*pings.pings_per_chunk;
+        pings.chunks[c].for_each_ping([&](size_t i, const xtf_sss_ping& ping, const std::vector<int>& port, const std::vector<int>& stbd) {
+            for (int j = 0; j < std::min(int(port.size()), port_cols); ++j) {
+                swath_img(offset + i, stbd_cols + j) = double(port[j] + 4000.)/20000.;
+            }
+            for (int j = 0; j < std::min(int(stbd.size()), stbd_cols); ++j) {
+                swath_img(offset + i, stbd_cols - j - 1) = double(stbd[j] + 4000.)/20000.;
+            }
+        });
+    });
+    return swath_img;
+}
+
 void show_waterfall_image(const xtf_sss_ping::PingsT& pings)
 {
     cv::Mat waterfall_image = make_waterfall_image(pings);
@@ -207,18 +229,20 @@ xtf_sss_ping process_side_scan_ping(XTFPINGHEADER *PingHeader, XTFFILEHEADER *XT
 
       // Do whatever processing on the sidescan imagery here.
       //cout << "Processing a side scan ping!!" << endl;
-      cout << "Size of short: " << sizeof(short) << endl;
-      cout << "Channel number: " << int(ChannelNumber) << endl;
-      //cout << "Channel name: " << ChannelName << endl;
-      cout << "Bytes per sample: " << int(BytesPerSample) << endl;
-      cout << "Samples per chan: " << int(SamplesPerChan) << endl;
-      cout << "Ground range: " << int(ChanHeader->GroundRange) << endl; // seems to always be 0
-      cout << "Slant range: " << int(ChanHeader->SlantRange) << endl;
-      cout << "Time duration: " << ChanHeader->TimeDuration << endl;
-      cout << "SecondsPerPing: " << ChanHeader->SecondsPerPing << endl; // seems to always be 0
-      cout << "GAIN Code: " << ChanHeader->GainCode << endl;
-      cout << "Initial GAIN Code: " << ChanHeader->InitialGainCode << endl;
-      cout << "Weight: " << ChanHeader->Weight << endl;
+      if (DEBUG_OUTPUT) {
+          cout << "Size of short: " << sizeof(short) << endl;
+          cout << "Channel number: " << int(ChannelNumber) << endl;
+          //cout << "Channel name: " << ChannelName << endl;
+          cout << "Bytes per sample: " << int(BytesPerSample) << endl;
+          cout << "Samples per chan: " << int(SamplesPerChan) << endl;
+          cout << "Ground range: " << int(ChanHeader->GroundRange) << endl; // seems to always be 0
+          cout << "Slant range: " << int(ChanHeader->SlantRange) << endl;
+          cout << "Time duration: " << ChanHeader->TimeDuration << endl;
+          cout << "SecondsPerPing: " << ChanHeader->SecondsPerPing << endl; // seems to always be 0
+          cout << "GAIN Code: " << ChanHeader->GainCode << endl;
+          cout << "Initial GAIN Code: " << ChanHeader->InitialGainCode << endl;
+          cout << "Weight: " << ChanHeader->Weight << endl;
+      }
 
       // skip past the imagery;
       Ptr += BytesThisChannel;
@@ -229,7 +253,9 @@ xtf_sss_ping process_side_scan_ping(XTFPINGHEADER *PingHeader, XTFFILEHEADER *XT
    return ping;
 }
 
-xtf_sss_ping::PingsT read_xtf_file(int infl, XTFFILEHEADER* XTFFileHeader, unsigned char* buffer)
+// calls sink with each sidescan ping in the file
+template <typename SinkT>
+void read_xtf_file(int infl, XTFFILEHEADER* XTFFileHeader, unsigned char* buffer, SinkT& sink)
 {
     /***************************************************************************************/
     // Given a handle to on open .XTF file, read through the file and
@@ -239,9 +265,9 @@ xtf_sss_ping::PingsT read_xtf_file(int infl, XTFFILEHEADER* XTFFileHeader, unsig
     // Read the XTF file header
     //
 
-    xtf_sss_ping::PingsT pings;
+    bool first_in_file = true;
     if (ReadXTFHeader(infl, XTFFileHeader, buffer) == FALSE) {
-        return pings;
+        return;
     }
 
     ProcessXTFHeader(infl, XTFFileHeader, buffer);
@@ -266,37 +292,36 @@ xtf_sss_ping::PingsT read_xtf_file(int infl, XTFFILEHEADER* XTFFileHeader, unsig
         }
 
         xtf_sss_ping ping = process_side_scan_ping((XTFPINGHEADER*)PingHeader, XTFFileHeader);
-        ping.first_in_file_ = false;
-        pings.push_back(ping);
-        cout << "SONAR "
-             << int(PingHeader->Year) << " "
-             << int(PingHeader->Month) << " "
-             << int(PingHeader->Day) << " "
-             << int(PingHeader->Hour) << " "
-             << int(PingHeader->Minute) << " "
-             << int(PingHeader->Second) << " "
-             << int(PingHeader->HSeconds) << " "
-             << "Sound vel=" << PingHeader->SoundVelocity << " "
-             << "Computed sound vel=" << PingHeader->ComputedSoundVelocity << " "
-             << "Y=" << PingHeader->SensorYcoordinate << " "
-             << "X=" << PingHeader->SensorXcoordinate << " "
-             << "altitude=" << PingHeader->SensorPrimaryAltitude << " "
-             << "depth=" << PingHeader->SensorDepth << " "
-             << "pitch=" << PingHeader->SensorPitch << " "
-             << "roll=" << PingHeader->SensorRoll << " "
-             << "heading=" << PingHeader->SensorHeading << " "  // [h] Fish heading in degrees
-             << "heave=" << PingHeader->Heave << " "            // Sensor heave at start of ping. 
-                           // Positive value means sensor moved up.
-             << "yaw=" << PingHeader->Yaw << endl;              // Sensor yaw.  Positive means turn to right.
-        cout << "Tilt angle 0: " << XTFFileHeader->ChanInfo[0].TiltAngle << endl;        // Typically 30 degrees
-        cout << "Beam width 0: " << XTFFileHeader->ChanInfo[0].BeamWidth << endl;        // 3dB beam width, Typically 50 degrees
-        cout << "Tilt angle 1: " << XTFFileHeader->ChanInfo[1].TiltAngle << endl;        // Typically 30 degrees
-        cout << "Beam width 1: " << XTFFileHeader->ChanInfo[1].BeamWidth << endl;        // 3dB beam width, Typically 50 degrees
-        cout << ping.time_string_ << endl;
-    }
-
-    if (!pings.empty()) {
-        pings[0].first_in_file_ = true;
+        ping.first_in_file_ = first_in_file;
+        first_in_file = false;
+        if (DEBUG_OUTPUT) {
+            cout << "SONAR "
+                 << int(PingHeader->Year) << " "
+                 << int(PingHeader->Month) << " "
+                 << int(PingHeader->Day) << " "
+                 << int(PingHeader->Hour) << " "
+                 << int(PingHeader->Minute) << " "
+                 << int(PingHeader->Second) << " "
+                 << int(PingHeader->HSeconds) << " "
+                 << "Sound vel=" << PingHeader->SoundVelocity << " "
+                 << "Computed sound vel=" << PingHeader->ComputedSoundVelocity << " "
+                 << "Y=" << PingHeader->SensorYcoordinate << " "
+                 << "X=" << PingHeader->SensorXcoordinate << " "
+                 << "altitude=" << PingHeader->SensorPrimaryAltitude << " "
+                 << "depth=" << PingHeader->SensorDepth << " "
+                 << "pitch=" << PingHeader->SensorPitch << " "
+                 << "roll=" << PingHeader->SensorRoll << " "
+                 << "heading=" << PingHeader->SensorHeading << " "  // [h] Fish heading in degrees
+                 << "heave=" << PingHeader->Heave << " "            // Sensor heave at start of ping. 
+                               // Positive value means sensor moved up.
+                 << "yaw=" << PingHeader->Yaw << endl;              // Sensor yaw.  Positive means turn to right.
+            cout << "Tilt angle 0: " << XTFFileHeader->ChanInfo[0].TiltAngle << endl;        // Typically 30 degrees
+            cout << "Beam width 0: " << XTFFileHeader->ChanInfo[0].BeamWidth << endl;        // 3dB beam width, Typically 50 degrees
+            cout << "Tilt angle 1: " << XTFFileHeader->ChanInfo[1].TiltAngle << endl;        // Typically 30 degrees
+            cout << "Beam width 1: " << XTFFileHeader->ChanInfo[1].BeamWidth << endl;        // 3dB beam width, Typically 50 degrees
+            cout << ping.time_string_ << endl;
+        }
+        sink(std::move(ping));
     }
 
     if (amt == 0xFFFF) {
@@ -304,8 +329,6 @@ xtf_sss_ping::PingsT read_xtf_file(int infl, XTFFILEHEADER* XTFFileHeader, unsig
     }
 
     cout << "Done!" << endl;
-
-    return pings;
 }
 
 xtf_sss_ping::PingsT correct_sensor_offset(const xtf_sss_ping::PingsT& pings, const Eigen::Vector3d& sensor_offset)
@@ -322,49 +345,94 @@ xtf_sss_ping::PingsT correct_sensor_offset(const xtf_sss_ping::PingsT& pings, co
     return new_pings;
 }
 
+void match_attitudes_in_place(xtf_sss_ping::PingsT& pings, const std_data::attitude_entry::EntriesT& entries)
+{
+    std_data::match_time_stamps(pings, entries, [&](size_t i, xtf_sss_ping& ping, const std_data::interpolation_weight& weight) {
+        ping.pitch_ = weight.interpolate(entries[weight.previous].pitch, entries[weight.next].pitch);
+        ping.roll_ = weight.interpolate(entries[weight.previous].roll, entries[weight.next].roll);
+    });
+}
+
 xtf_sss_ping::PingsT match_attitudes(const xtf_sss_ping::PingsT& pings, const std_data::attitude_entry::EntriesT& entries)
 {
     xtf_sss_ping::PingsT new_pings = pings;
+    match_attitudes_in_place(new_pings, entries);
+    return new_pings;
+}
 
-    auto pos = entries.begin();
-    for (xtf_sss_ping& ping : new_pings) {
-        pos = std::find_if(pos, entries.end(), [&](const std_data::attitude_entry& entry) {
-            return entry.time_stamp_ > ping.time_stamp_;
-        });
+// the data starts after the file header and any extra channel infos, in 1024 byte blocks
+unsigned long long data_offset(const XTFFILEHEADER& XTFFileHeader)
+{
+    unsigned long long offset = sizeof(XTFFILEHEADER);
+    unsigned int Cnt = XTFFileHeader.NumberOfSonarChannels + XTFFileHeader.NumberOfBathymetryChannels;
+    if (Cnt > 6) {
+        offset += 1024*(((Cnt - 6)*sizeof(CHANINFO) + 1023)/1024);
+    }
+    return offset;
+}
 
-        ping.pitch_ = 0.;
-        ping.roll_ = 0.;
-        double heave;
-        if (pos == entries.end()) {
-            ping.pitch_ = entries.back().pitch;
-            ping.roll_ = entries.back().roll;
-        }
-        else if (pos == entries.begin()) {
-                ping.pitch_ = pos->pitch;
-                ping.roll_ = pos->roll;
-        }
-        else {
-            const std_data::attitude_entry& previous = *(pos - 1);
-            double ratio = double(ping.time_stamp_ - previous.time_stamp_)/double(pos->time_stamp_ - previous.time_stamp_);
-            ping.pitch_ = previous.pitch + ratio*(pos->pitch - previous.pitch);
-            ping.roll_ = previous.roll + ratio*(pos->roll - previous.roll);
-        }
+std_data::datagram_index build_datagram_index(const boost::filesystem::path& file)
+{
+    std_data::datagram_index index;
+
+    std::ifstream input;
+    input.open(file.string(), std::ios::binary);
+    if (input.fail()) {
+        cout << "ERROR: Cannot open the file..." << endl;
+        exit(0);
     }
 
-    return new_pings;
-}
+    XTFFILEHEADER XTFFileHeader;
+    input.read(reinterpret_cast<char*>(&XTFFileHeader), sizeof(XTFFileHeader));
+    if (input.fail() || XTFFileHeader.FileFormat != FMT_XTF) {
+        cout << "Bad header ID, " << file << " is not an XTF format file!" << endl;
+        return index;
+    }
 
-} // namespace xtf_data
+    const boost::gregorian::date epoch(1970, 1, 1);
+
+    // all packets are at least 64 bytes, and the first 64 bytes
+    // of the sonar and bathy ping headers contain the time
+    XTFPINGHEADER PingHeader;
+    const unsigned int min_packet_size = 64;
+    long long time_stamp = 0;
+    unsigned long long offset = data_offset(XTFFileHeader);
+    input.seekg(offset);
+    while (input.read(reinterpret_cast<char*>(&PingHeader), min_packet_size)) {
+        if (PingHeader.MagicNumber != 0xFACE || PingHeader.NumBytesThisRecord < min_packet_size) {
+            cout << "Bad packet at offset " << offset << ", stopping index..." << endl;
+            break;
+        }
 
-namespace std_data {
+        if (PingHeader.HeaderType == XTF_HEADER_SONAR || PingHeader.HeaderType == XTF_HEADER_HIDDEN_SONAR ||
+            PingHeader.HeaderType == XTF_HEADER_BATHY) {
+            int year = PingHeader.Year;
+            int month = PingHeader.Month;
+            int day = PingHeader.Day;
+            if (year >= 1970 && year < 10000 && month >= 1 && month <= 12 && day >= 1 &&
+                day <= boost::gregorian::gregorian_calendar::end_of_month_day(year, month)) {
+                time_stamp = 86400000LL*(boost::gregorian::date(year, month, day) - epoch).days() +
+                             1000LL*(3600*PingHeader.Hour + 60*PingHeader.Minute + PingHeader.Second) + 10*PingHeader.HSeconds;
+            }
+        }
 
-using namespace xtf_data;
+        std_data::datagram_index_entry entry;
+        entry.time_stamp_ = time_stamp;
+        entry.type = PingHeader.HeaderType;
+        entry.offset = offset;
+        entry.length = PingHeader.NumBytesThisRecord;
+        index.entries.push_back(entry);
 
-template <>
-xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
-{
-   xtf_sss_ping::PingsT pings;
+        offset += entry.length;
+        input.seekg(offset);
+    }
 
+    return index;
+}
+
+template <typename SinkT>
+void parse_file_impl(const boost::filesystem::path& file, SinkT& sink)
+{
    // quick sanity check to make sure the compiler didn't
    // screw up the data structure sizes by changing alignment.
    if (
@@ -384,7 +452,7 @@ xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
             sizeof(XTFBATHHEADER)       << " " <<
             sizeof(XTFRAWSERIALHEADER)  << " " <<
             sizeof(XTFPINGCHANHEADER)   << endl;
-         return pings;
+         return;
    }
 
 #ifdef _MSC_VER
@@ -394,7 +462,7 @@ xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
 #endif
    if (infl <= 0) {
        cout << "Error: Can't open " << file.string() << " for reading!" << endl;
-       return pings;
+       return;
    }
 
    //
@@ -405,14 +473,14 @@ xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
    if (buffer == NULL) {
        cout << "Can't allocate memory!" << endl;
        exit(-1);
-       return pings;
+       return;
    }
 
    //
    // Allocate memory for storing XTF header
    //
    XTFFILEHEADER XTFFileHeader; // = (XTFFILEHEADER*)malloc((WORD)sizeof(XTFFILEHEADER));
-   pings = read_xtf_file(infl, &XTFFileHeader, buffer);
+   read_xtf_file(infl, &XTFFileHeader, buffer, sink);
 
    if (infl > 0) {
        close(infl);
@@ -422,8 +490,69 @@ xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
        free(buffer);
        buffer = NULL;
    }
+}
+
+} // namespace xtf_data
+
+namespace std_data {
+
+using namespace xtf_data;
+
+template <>
+xtf_sss_ping::PingsT parse_file(const boost::filesystem::path& file)
+{
+    xtf_sss_ping::PingsT pings;
+    auto sink = [&pings](xtf_sss_ping&& ping) {
+        pings.push_back(std::move(ping));
+    };
+    parse_file_impl(file, sink);
+    return pings;
+}
+
+template <>
+void parse_file_batches<xtf_sss_ping>(const boost::filesystem::path& file, int batch_size, const batch_sink<xtf_sss_ping>::CallbackT& callback)
+{
+    batch_sink<xtf_sss_ping> sink(batch_size, callback);
+    parse_file_impl(file, sink);
+    sink.flush();
+}
+
+template <>
+xtf_sss_ping::PingsT parse_file_time_range<xtf_sss_ping>(const boost::filesystem::path& file, long long start_time, long long end_time)
+{
+    xtf_sss_ping::PingsT pings;
+
+    std_data::datagram_index index = load_or_build_datagram_index(file, &build_datagram_index);
+
+    std::ifstream input;
+    input.open(file.string(), std::ios::binary);
+    if (input.fail()) {
+        cout << "Error: Can't open " << file.string() << " for reading!" << endl;
+        return pings;
+    }
 
-   return pings;
+    XTFFILEHEADER XTFFileHeader;
+    input.read(reinterpret_cast<char*>(&XTFFileHeader), sizeof(XTFFileHeader));
+
+    std::vector<unsigned char> buffer;
+    for (const datagram_index_entry& entry : index.filter(start_time, end_time, vector<int>{XTF_HEADER_SONAR})) {
+        buffer.resize(entry.length);
+        input.seekg(entry.offset);
+        input.read(reinterpret_cast<char*>(buffer.data()), entry.length);
+        if (input.fail()) {
+            cout << "Could not read packet at offset " << entry.offset << ", is the index stale?" << endl;
+            break;
+        }
+        xtf_sss_ping ping = process_side_scan_ping((XTFPINGHEADER*)buffer.data(), &XTFFileHeader);
+        ping.first_in_file_ = false;
+        pings.push_back(ping);
+    }
+
+    if (!pings.empty()) {
+        pings[0].first_in_file_ = true;
+    }
+
+    return pings;
 }
 
 } // namespace std_data
@@ -11,6 +11,10 @@
 
 #include <data_tools/xyz_data.h>
 #include <data_tools/lat_long_utm.h>
+#include <data_tools/ascii_parsing.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
 
 using namespace std;
 
@@ -71,79 +75,134 @@ xyz_data::Points from_matrix(const Eigen::MatrixXd& P)
 
 Eigen::MatrixXd to_matrix(const Points& points)
 {
-    Eigen::MatrixXd P(points.size(), 3);
-    int counter = 0;
-    for (const Eigen::Vector3d& p : points) {
-        P.row(counter) = p.transpose();
-        ++counter;
+    return map_points(points);
+}
+
+Eigen::Map<const PointsMatrix> map_points(const xyz_data::Points& points)
+{
+    // the aligned_allocator does not pad Vector3d, so the points are stored as consecutive rows
+    static_assert(sizeof(Eigen::Vector3d) == 3*sizeof(double), "Vector3d is expected to be unpadded");
+    const double* data = points.empty() ? nullptr : points[0].data();
+    return Eigen::Map<const PointsMatrix>(data, points.size(), 3);
+}
+
+namespace {
+
+// upper bound on the number of lines in [begin, end)
+size_t count_lines(const char* begin, const char* end)
+{
+    size_t lines = 0;
+    const char* p = begin;
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        ++lines;
+        if (line_end == nullptr) {
+            break;
+        }
+        p = line_end + 1;
     }
-    return P;
+    return lines;
 }
 
-} // namespace xyz_data
+// parses the lines in [begin, end) with three numbers separated by spaces, tabs or commas,
+// other lines (e.g. headers) are skipped. returns the number of points written to out
+size_t parse_lines(const char* begin, const char* end, Eigen::Vector3d* out)
+{
+    size_t n = 0;
+    const char* p = begin;
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        Eigen::Vector3d& point = out[n];
+        int j = 0;
+        for (; j < 3; ++j) {
+            ascii_parsing::skip_separators(p, line_end);
+            if (!ascii_parsing::parse_number(p, line_end, point[j])) {
+                break;
+            }
+        }
+        n += j == 3;
+        p = line_end + 1;
+    }
+    return n;
+}
 
-namespace std_data {
+} // namespace
 
-template <>
-xyz_data::Points parse_file(const boost::filesystem::path& file)
+xyz_data::Points parse_mapped_file(const boost::filesystem::path& file, int nbr_threads)
 {
     xyz_data::Points cloud;
-    cloud.reserve(1000000);
-    string line;
-    std::ifstream infile(file.string());
-    if (!std::getline(infile, line)) {
+
+    if (!boost::filesystem::exists(file) || boost::filesystem::file_size(file) == 0) {
         cout << "File " << file << " did not contain any information!" << endl;
         return cloud;
     }
-    char separator = ' ';
-    if (line.find(',') != string::npos) {
-        separator = ',';
-    }
 
-    cout << "Using separator: " << separator << endl;
-
-    //size_t i = 0;
-    size_t counter = 0;
-    Eigen::Vector3d p;
-    while (std::getline(infile, line))  // this does the checking!
-    {
-        /*
-        if (i < 10) {
-            ++i;
-            continue;
+    boost::interprocess::file_mapping mapping(file.string().c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+    const char* data = static_cast<const char*>(region.get_address());
+    size_t size = region.get_size();
+
+    // split the file into chunks of roughly 16MB, each ending right after a newline
+    const size_t chunk_size = 1 << 24;
+    size_t nbr_chunks = (size + chunk_size - 1) / chunk_size;
+    vector<size_t> bounds(1, 0);
+    for (size_t i = 1; i < nbr_chunks; ++i) {
+        size_t bound = std::max(i*size/nbr_chunks, bounds.back());
+        const char* newline = static_cast<const char*>(memchr(data + bound, '\n', size - bound));
+        if (newline == nullptr) {
+            break;
         }
-        else {
-            i = 0;
+        if (size_t(newline - data) + 1 > bounds.back()) {
+            bounds.push_back(newline - data + 1);
         }
-        */
-        if (line.empty() || line[0] == '\n') {// || !isdigit(line[0])) {
-            continue;
-        }
-        istringstream iss(line);
-		if (separator == ' ') {
-            iss >> p(0) >> p(1) >> p(2);
-        }
-        else {
-            //std::getline(iss, p(0), separator);
-            //std::getline(iss, p(1), separator);
-            //std::getline(iss, p(2), separator);
-            for (int j = 0; j < 3; ++j) {
-                std::getline(iss, line, separator);
-                p[j] = std::stod(line.c_str());
-            }
-        }
-        if (counter >= cloud.capacity()) {
-            cout << "Reserving space: " << cloud.size() + 1000000 << endl;
-            cloud.reserve(cloud.size() + 1000000);
-        }
-        if (counter % 1000 == 0) {
-            cout << "Point: " << p.transpose() << endl;
+    }
+    if (bounds.back() < size) {
+        bounds.push_back(size);
+    }
+    nbr_chunks = bounds.size() - 1;
+
+    // reserve one point per line, then parse all chunks straight into their part of the buffer
+    vector<size_t> offsets(nbr_chunks + 1, 0);
+    std_data::parallel_for(nbr_chunks, nbr_threads, [&](int i) {
+        offsets[i + 1] = count_lines(data + bounds[i], data + bounds[i + 1]);
+    });
+    for (size_t i = 0; i < nbr_chunks; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    cloud.resize(offsets.back());
+    vector<size_t> counts(nbr_chunks);
+    std_data::parallel_for(nbr_chunks, nbr_threads, [&](int i) {
+        counts[i] = parse_lines(data + bounds[i], data + bounds[i + 1], &cloud[offsets[i]]);
+    });
+
+    // close the gaps left by empty or malformed lines
+    size_t nbr_points = 0;
+    for (size_t i = 0; i < nbr_chunks; ++i) {
+        if (nbr_points != offsets[i]) {
+            std::move(cloud.begin() + offsets[i], cloud.begin() + offsets[i] + counts[i], cloud.begin() + nbr_points);
         }
-        cloud.push_back(p);
-        ++counter;
+        nbr_points += counts[i];
     }
+    cloud.resize(nbr_points);
+
+    if (DEBUG_OUTPUT) cout << "Parsed " << nbr_points << " points from " << file << endl;
 
     return cloud;
 }
 
+} // namespace xyz_data
+
+namespace std_data {
+
+template <>
+xyz_data::Points parse_file(const boost::filesystem::path& file)
+{
+    // parse_folder already spreads the files over threads, so use only one here
+    return xyz_data::parse_mapped_file(file, 1);
+}
+
 } // namespace std_data
@@ -53,14 +53,27 @@ def run_draping(args):
     d = draw_map.BathyMapImage(height_map, bounds)
 
     draping_results = [] # results list
+    if args.compact: # stream float32 results to file instead of keeping them
+        writer = base_draper.DrapingResultWriter(args.output)
+        left = base_draper.compact_ping_draping_result()
+        right = base_draper.compact_ping_draping_result()
 
     for i, ping in enumerate(xtf_pings):
-        left, right = draper.project_ping(ping, waterfall_bins) # project
-        draping_results.append((left, right)) # store result
+        if args.compact:
+            draper.project_ping_compact(ping, waterfall_bins, left, right) # project
+            writer.write(left, right) # store result
+        else:
+            left, right = draper.project_ping(ping, waterfall_bins) # project
+            draping_results.append((left, right)) # store result
 
         # the rest is basically just for visualizing the images
-        model = np.concatenate([np.flip(left.time_bin_model_intensities), right.time_bin_model_intensities])
-        normals = np.concatenate([np.flip(left.time_bin_normals, axis=0), right.time_bin_normals], axis=0)
+        left_model, left_normals = left.time_bin_model_intensities, left.time_bin_normals
+        right_model, right_normals = right.time_bin_model_intensities, right.time_bin_normals
+        if args.compact: # only the first nbr_bins rows of the reused buffers are valid
+            left_model, left_normals = left_model[:left.nbr_bins], left_normals[:left.nbr_bins]
+            right_model, right_normals = right_model[:right.nbr_bins], right_normals[:right.nbr_bins]
+        model = np.concatenate([np.flip(left_model), right_model])
+        normals = np.concatenate([np.flip(left_normals, axis=0), right_normals], axis=0)
         meas = np.concatenate([np.flip(base_draper.compute_bin_intensities(ping.port, waterfall_bins)),
                                        base_draper.compute_bin_intensities(ping.stbd, waterfall_bins)])
         meas_im[1:, :] = meas_im[:-1, :]
@@ -80,7 +93,10 @@ def run_draping(args):
             cv2.imshow("Normal image", normals_im)
             cv2.waitKey(1)
 
-    base_draper.write_data(draping_results, args.output) # save results
+    if args.compact:
+        writer.close()
+    else:
+        base_draper.write_data(draping_results, args.output) # save results
 
 if __name__ == '__main__':
 
@@ -101,6 +117,8 @@ if __name__ == '__main__':
                         help='Offset of the physical sensor wrt vehicle')
     parser.add_argument('--output', '-o', action="store", dest="output", type=str, default="draping_results.cereal",
                         help='Produce output file with ping_draping_result::ResultsT')
+    parser.add_argument('--compact', action="store_true", dest="compact",
+                        help='Stream float32 results to the output with DrapingResultWriter instead of .cereal')
     args = parser.parse_args()
 
     run_draping(args)
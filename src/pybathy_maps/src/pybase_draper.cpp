@@ -11,6 +11,7 @@
 
 #include <bathy_maps/base_draper.h>
 #include <bathy_maps/view_draper.h>
+#include <bathy_maps/compact_draping_result.h>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
@@ -35,19 +36,65 @@ PYBIND11_MODULE(base_draper, m) {
         .def_readwrite("time_bin_model_intensities", &ping_draping_result::time_bin_model_intensities, "Model intensities corresponding to the real intensities")
         .def_static("read_data", &read_data_from_str<ping_draping_result::ResultsT>, "Read ping_draping_result::ResultsT from .cereal file");
 
+    using CompactT = compact_ping_draping_result;
+    py::class_<CompactT>(m, "compact_ping_draping_result", "Class for representing the draping result of a sidescan ping side in float32, with reusable buffers")
+        .def(py::init<>())
+        .def_readwrite("sensor_origin", &CompactT::sensor_origin, "Origin of sensor when capturing ping")
+        .def_readonly("nbr_hits", &CompactT::nbr_hits, "Number of valid rows of the hit buffers")
+        .def_readonly("nbr_bins", &CompactT::nbr_bins, "Number of valid rows of the time bin buffers")
+        .def_property_readonly("hits_points", [](const CompactT& r) { return CompactT::PointsT(r.hits_points.topRows(r.nbr_hits)); }, "3D positions of hits, see hits_inds for corresponding sidescan index")
+        .def_property_readonly("hits_inds", [](const CompactT& r) { return Eigen::VectorXi(r.hits_inds.head(r.nbr_hits)); }, "Ping time index of the hits")
+        .def_property_readonly("hits_times", [](const CompactT& r) { return Eigen::VectorXf(r.hits_times.head(r.nbr_hits)); }, "Two way travel times of the hits")
+        .def_property_readonly("hits_intensities", [](const CompactT& r) { return Eigen::VectorXf(r.hits_intensities.head(r.nbr_hits)); }, "Downsampled intensities from sidescan")
+        .def_property_readonly("time_bin_points", [](const CompactT& r) { return CompactT::PointsT(r.time_bin_points.topRows(r.nbr_bins)); }, "Depths corresponding to the ping intensities")
+        .def_property_readonly("time_bin_normals", [](const CompactT& r) { return CompactT::PointsT(r.time_bin_normals.topRows(r.nbr_bins)); }, "Normals corresponding to the ping intensities")
+        .def_property_readonly("time_bin_model_intensities", [](const CompactT& r) { return Eigen::VectorXf(r.time_bin_model_intensities.head(r.nbr_bins)); }, "Model intensities corresponding to the real intensities")
+        .def("assign", static_cast<void (CompactT::*)(const ping_draping_result&)>(&CompactT::assign), "Convert a ping_draping_result into this result")
+        .def("to_result", &CompactT::to_result, "Convert to a ping_draping_result");
+
+    py::class_<DrapingResultWriter>(m, "DrapingResultWriter", "Class for streaming compact draping results to a binary file, one ping at a time")
+        .def(py::init<const std::string&>())
+        .def("write", &DrapingResultWriter::write, "Write the port and starboard results of one ping")
+        .def("close", &DrapingResultWriter::close, "Close the file");
+
+    py::class_<DrapingResultReader>(m, "DrapingResultReader", "Class for reading the files of DrapingResultWriter, one ping at a time")
+        .def(py::init<const std::string&>())
+        .def("read", &DrapingResultReader::read, "Read the next port and starboard results into the arguments, returns False at the end of the file")
+        .def("close", &DrapingResultReader::close, "Close the file");
+
+    py::class_<mbes_simulation_result>(m, "mbes_simulation_result", "Class for representing the multibeam hits of a whole trajectory")
+        .def(py::init<>())
+        .def_readwrite("hits", &mbes_simulation_result::hits, "Hit points, beam j of pose i at row i*nbr_beams + j, reshape to (N, nbr_beams, 3)")
+        .def_readwrite("valid", &mbes_simulation_result::valid, "N x nbr_beams mask of the beams that hit the mesh");
+
     py::class_<BaseDraper>(m, "BaseDraper", "Class for draping the whole data set of sidescan pings onto a bathymetry mesh")
         // Methods inherited from BaseDraper:
         .def(py::init<const Eigen::MatrixXd&, const Eigen::MatrixXi&,
                       const BaseDraper::BoundsT&,
                       const csv_asvp_sound_speed::EntriesT&>())
-        .def("project_ping", &BaseDraper::project_ping, "Project a ping onto the mesh and get intermediate draping results. Provide the desired downsampling of the ping as the second parameter")
+        .def("project_ping", static_cast<sss_draping_result (BaseDraper::*)(const std_data::sss_ping&, int)>(&BaseDraper::project_ping), "Project a ping onto the mesh and get intermediate draping results. Provide the desired downsampling of the ping as the second parameter")
+        .def("project_ping_compact", static_cast<void (BaseDraper::*)(const std_data::sss_ping&, int, compact_ping_draping_result&, compact_ping_draping_result&)>(&BaseDraper::project_ping_compact),
+             "Project a ping onto the mesh and write float32 results into the given left and right compact_ping_draping_result, reusing their buffers")
         .def("project_mbes", &BaseDraper::project_mbes, "Project multibeam ping onto mesh, given vertices V, faces F, bounds, position, rotation matrix, number beams and opening angle, returns matrix of points")
         .def("project_altimeter", &BaseDraper::project_altimeter, "Project single altimeter beam straight down, returns depth")
+        .def_static("mbes_beam_dirs", &BaseDraper::mbes_beam_dirs, "Get the beam directions in the sensor frame used by project_mbes, given number of beams and opening angle")
+        .def("project_mbes_trajectory", &BaseDraper::project_mbes_trajectory, py::call_guard<py::gil_scoped_release>(),
+             "Project multibeam pings from all positions (N x 3) and rotations onto the mesh, given the beam directions. Returns mbes_simulation_result",
+             py::arg("positions"), py::arg("rotations"), py::arg("beam_dirs"), py::arg("nbr_threads") = 0)
+        .def("project_mbes_pings", &BaseDraper::project_mbes_pings, py::call_guard<py::gil_scoped_release>(),
+             "Project multibeam pings from the poses of mbes_ping::PingsT onto the mesh, given the beam directions. Returns mbes_simulation_result",
+             py::arg("pings"), py::arg("beam_dirs"), py::arg("nbr_threads") = 0)
+        .def("project_altimeters", &BaseDraper::project_altimeters, py::call_guard<py::gil_scoped_release>(),
+             "Project altimeter beams straight down from all positions (N x 3), returns depths, zero where there is no hit",
+             py::arg("positions"), py::arg("nbr_threads") = 0)
         .def("set_sidescan_yaw", &BaseDraper::set_sidescan_yaw, "Set yaw correction of sidescan with respect to nav frame")
         .def("set_sidescan_port_stbd_offsets", &BaseDraper::set_sidescan_port_stbd_offsets, "Set offsets of sidescan port and stbd sides with respect to nav frame")
         .def("set_tracing_map_size", &BaseDraper::set_tracing_map_size, "Set size of slice of map where we do ray tracing. Smaller makes it faster but you might cut off valid sidescan angles")
         .def("set_intensity_multiplier", &BaseDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with when displaying on top of mesh")
-        .def("set_ray_tracing_enabled", &BaseDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences");
+        .def("set_ray_tracing_enabled", &BaseDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &BaseDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &BaseDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &BaseDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables");
 
     py::class_<ViewDraper>(m, "ViewDraper", "Base class for draping sidescan pings onto a bathymetry mesh")
         .def(py::init<const Eigen::MatrixXd&, const Eigen::MatrixXi&,
@@ -61,6 +108,9 @@ PYBIND11_MODULE(base_draper, m) {
         .def("set_tracing_map_size", &ViewDraper::set_tracing_map_size, "Set size of slice of map where we do ray tracing. Smaller makes it faster but you might cut off valid sidescan angles")
         .def("set_intensity_multiplier", &ViewDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with when displaying on top of mesh")
         .def("set_ray_tracing_enabled", &ViewDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &ViewDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &ViewDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &ViewDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
         .def("set_vehicle_mesh", &ViewDraper::set_vehicle_mesh, "Provide the viewer with a vehicle model, purely for visualization")
         .def("set_callback", &ViewDraper::set_callback, "Set the function to be called when one ping has been draped")
         .def("show", &ViewDraper::show, "Start the draping, and show the visualizer");
@@ -24,10 +24,12 @@ PYBIND11_MODULE(draw_map, m) {
     py::class_<BathyMapImage>(m, "BathyMapImage", "Class for constructing mesh from multibeam data")
         .def(py::init<const mbes_ping::PingsT&, int, int>(), "Constructor, takes mbes_ping::PingsT and height and width of height map")
         .def(py::init<const Eigen::MatrixXd&, const Eigen::Matrix2d&>(), "Constructor, takes pre-computed height map matrix and bounds")
+        .def(py::init<const SparseRaster&>(), "Constructor, takes a mesh_map.SparseRaster height map")
         .def("draw_track", (void (BathyMapImage::*)(const mbes_ping::PingsT&) ) &BathyMapImage::draw_track, "Draw vehicle track from mbes_ping::PingsT")
         .def("draw_track", (void (BathyMapImage::*)(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >&) ) &BathyMapImage::draw_track, "Draw vehicle track from list of Vector3d")
         .def("draw_height_map", (void (BathyMapImage::*)(const mbes_ping::PingsT&) ) &BathyMapImage::draw_height_map, "Draw height map from mbes_ping::PingsT")
         .def("draw_height_map", (void (BathyMapImage::*)(const Eigen::MatrixXd&) ) &BathyMapImage::draw_height_map, "Draw height map from pre-computed height map matrix")
+        .def("draw_height_map", (void (BathyMapImage::*)(const SparseRaster&) ) &BathyMapImage::draw_height_map, "Draw height map from the cells with data of a mesh_map.SparseRaster")
         .def("draw_indices", &BathyMapImage::draw_indices, "Draw indices of the pings within the map, from mbes_ping::PingsT")
         .def("draw_back_scatter_map", &BathyMapImage::draw_back_scatter_map, "Draw back scatter map from mbes_ping::PingsT")
         .def("draw_targets", &BathyMapImage::draw_targets, "Draw point targets from dict of points")
@@ -10,6 +10,7 @@
  */
 
 #include <bathy_maps/map_draper.h>
+#include <bathy_maps/batch_draper.h>
 #include <bathy_maps/base_draper.h>
 #include <bathy_maps/sss_meas_data.h>
 
@@ -25,6 +26,8 @@ namespace py = pybind11;
 
 using MapImageDraper = MapDraper<sss_map_image_builder>;
 using MeasDataDraper = MapDraper<sss_meas_data_builder>;
+using BatchMapImageDraper = BatchDraper<sss_map_image_builder>;
+using BatchMeasDataDraper = BatchDraper<sss_meas_data_builder>;
 
 PYBIND11_MODULE(map_draper, m) {
     m.doc() = "Functions for draping a mesh with sidescan data"; // optional module docstring
@@ -64,6 +67,9 @@ PYBIND11_MODULE(map_draper, m) {
         .def("set_tracing_map_size", &MapImageDraper::set_tracing_map_size, "Set size of slice of map where we do ray tracing. Smaller makes it faster but you might cut off valid sidescan angles")
         .def("set_intensity_multiplier", &MapImageDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with when displaying on top of mesh")
         .def("set_ray_tracing_enabled", &MapImageDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &MapImageDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &MapImageDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &MapImageDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
         .def("set_vehicle_mesh", &MapImageDraper::set_vehicle_mesh, "Provide the viewer with a vehicle model, purely for visualization")
         .def("show", &MapImageDraper::show, "Start the draping, and show the visualizer")
         // Methods unique to MapImageDraper:
@@ -83,6 +89,9 @@ PYBIND11_MODULE(map_draper, m) {
         .def("set_tracing_map_size", &MeasDataDraper::set_tracing_map_size, "Set size of slice of map where we do ray tracing. Smaller makes it faster but you might cut off valid sidescan angles")
         .def("set_intensity_multiplier", &MeasDataDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with when displaying on top of mesh")
         .def("set_ray_tracing_enabled", &MeasDataDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &MeasDataDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &MeasDataDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &MeasDataDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
         .def("set_vehicle_mesh", &MeasDataDraper::set_vehicle_mesh, "Provide the viewer with a vehicle model, purely for visualization")
         .def("show", &MeasDataDraper::show, "Start the draping, and show the visualizer")
         // Methods unique to MeasDataDraper:
@@ -92,7 +101,50 @@ PYBIND11_MODULE(map_draper, m) {
         .def("set_close_when_done", &MeasDataDraper::set_close_when_done, "Set if the draper should close when done draping")
         .def("get_images", &MeasDataDraper::get_images, "Get all the sss_map_image::ImagesT that have been gathered so far");
 
+    py::class_<BatchMapImageDraper>(m, "BatchMapDraper", "Class for draping the whole data set of sidescan pings onto a bathymetry mesh without a viewer, using several threads")
+        .def(py::init<const Eigen::MatrixXd&, const Eigen::MatrixXi&,
+                      const std_data::sss_ping::PingsT&, const BatchMapImageDraper::BoundsT&,
+                      const csv_asvp_sound_speed::EntriesT&>())
+        .def("set_sidescan_yaw", &BatchMapImageDraper::set_sidescan_yaw, "Set yaw correction of sidescan with respect to nav frame")
+        .def("set_sidescan_port_stbd_offsets", &BatchMapImageDraper::set_sidescan_port_stbd_offsets, "Set offsets of sidescan port and stbd sides with respect to nav frame")
+        .def("set_intensity_multiplier", &BatchMapImageDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with")
+        .def("set_ray_tracing_enabled", &BatchMapImageDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &BatchMapImageDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &BatchMapImageDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &BatchMapImageDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
+        .def("set_resolution", &BatchMapImageDraper::set_resolution, "Set the resolution of the gathered maps, default is ~3.75")
+        .def("set_nbr_threads", &BatchMapImageDraper::set_nbr_threads, "Set the number of draping threads, default 0 is one per core")
+        .def("set_store_map_images", &BatchMapImageDraper::set_store_map_images, "Set if the draper should save and return map images at the end")
+        .def("set_image_callback", &BatchMapImageDraper::set_image_callback, "Set the function to be called when an entire sidescan map is done")
+        .def("set_progress_callback", &BatchMapImageDraper::set_progress_callback, "Set the function to be called with (nbr pings done, nbr pings) after each ping")
+        .def("set_ping_observer", &BatchMapImageDraper::set_ping_observer, "Set the function to be called with (ping, left, right draping results) for each draped ping, in order")
+        .def("cancel", &BatchMapImageDraper::cancel, "Stop a running drape, the images finished so far are returned")
+        .def("drape", &BatchMapImageDraper::drape, py::call_guard<py::gil_scoped_release>(), "Drape all pings and return the sss_map_image::ImagesT");
+
+    py::class_<BatchMeasDataDraper>(m, "BatchMeasDataDraper", "Class for draping the whole data set of sidescan pings onto a bathymetry mesh without a viewer, using several threads")
+        .def(py::init<const Eigen::MatrixXd&, const Eigen::MatrixXi&,
+                      const std_data::sss_ping::PingsT&, const BatchMeasDataDraper::BoundsT&,
+                      const csv_asvp_sound_speed::EntriesT&>())
+        .def("set_sidescan_yaw", &BatchMeasDataDraper::set_sidescan_yaw, "Set yaw correction of sidescan with respect to nav frame")
+        .def("set_sidescan_port_stbd_offsets", &BatchMeasDataDraper::set_sidescan_port_stbd_offsets, "Set offsets of sidescan port and stbd sides with respect to nav frame")
+        .def("set_intensity_multiplier", &BatchMeasDataDraper::set_intensity_multiplier, "Set a value to multiply the sidescan intensity with")
+        .def("set_ray_tracing_enabled", &BatchMeasDataDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &BatchMeasDataDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &BatchMeasDataDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &BatchMeasDataDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
+        .def("set_resolution", &BatchMeasDataDraper::set_resolution, "Set the resolution of the gathered maps, default is ~3.75")
+        .def("set_nbr_threads", &BatchMeasDataDraper::set_nbr_threads, "Set the number of draping threads, default 0 is one per core")
+        .def("set_store_map_images", &BatchMeasDataDraper::set_store_map_images, "Set if the draper should save and return map images at the end")
+        .def("set_image_callback", &BatchMeasDataDraper::set_image_callback, "Set the function to be called when an entire sidescan map is done")
+        .def("set_progress_callback", &BatchMeasDataDraper::set_progress_callback, "Set the function to be called with (nbr pings done, nbr pings) after each ping")
+        .def("set_ping_observer", &BatchMeasDataDraper::set_ping_observer, "Set the function to be called with (ping, left, right draping results) for each draped ping, in order")
+        .def("cancel", &BatchMeasDataDraper::cancel, "Stop a running drape, the images finished so far are returned")
+        .def("drape", &BatchMeasDataDraper::drape, py::call_guard<py::gil_scoped_release>(), "Drape all pings and return the sss_meas_data::ImagesT");
+
     m.def("drape_maps", &drape_maps, "Overlay sss_ping::PingsT sidescan data on a mesh and get sss_map_image::ViewsT");
+    m.def("batch_drape_maps", &batch_drape_maps, "Overlay sss_ping::PingsT sidescan data on a mesh without a viewer and get sss_map_image::ImagesT",
+          py::arg("V"), py::arg("F"), py::arg("bounds"), py::arg("pings"), py::arg("sound_speeds"), py::arg("sensor_yaw"),
+          py::arg("resolution"), py::arg("save_callback"), py::arg("nbr_threads") = 0, py::call_guard<py::gil_scoped_release>());
     m.def("color_jet_from_mesh", &color_jet_from_mesh, "Get a jet color scheme from a vertex matrix");
     m.def("get_vehicle_mesh", &get_vehicle_mesh, "Get vertices, faces, and colors for vehicle");
     m.def("convert_maps_to_patches", &convert_maps_to_patches, "Convert sss_map_image::ImagesT to sss_patch_views::ViewsT");
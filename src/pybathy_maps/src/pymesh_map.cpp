@@ -11,6 +11,8 @@
 
 #include <bathy_maps/draw_map.h>
 #include <bathy_maps/mesh_map.h>
+#include <bathy_maps/height_map_gridder.h>
+#include <bathy_maps/dem_pyramid.h>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
@@ -22,7 +24,73 @@ PYBIND11_MODULE(mesh_map, m) {
     m.doc() = "Data structure for constructing and viewing a bathymetry mesh and for draping the mesh with sidescan data"; // optional module docstring
     //py::class_<bathy_map_mesh>(m, "bathy_map_mesh", "Class for constructing mesh from multibeam data")
     //.def(py::init<>(), "Constructor")
-    m.def("mesh_from_height_map", &mesh_map::mesh_from_height_map, "Construct mesh from height map");
+    py::class_<SparseRaster>(m, "SparseRaster", "Class for float rasters with nodata cells, stored in tiles that are allocated on first write")
+        .def(py::init<int, int, const SparseRaster::BoundsT&, float>(), "Constructor, taking rows, cols, bounds and the nodata value",
+             py::arg("rows"), py::arg("cols"), py::arg("bounds"), py::arg("nodata") = 0.f)
+        .def_static("from_dense", &SparseRaster::from_dense, "Construct from a dense matrix, skipping the nodata cells",
+                    py::arg("dense"), py::arg("bounds"), py::arg("nodata") = 0.f)
+        .def("to_dense", &SparseRaster::to_dense, "Get the dense matrix, cells without data are nodata")
+        .def("get_bounds", &SparseRaster::get_bounds, "Get the bounds of the raster")
+        .def("is_valid", &SparseRaster::is_valid, "Check if a cell has data")
+        .def("get", &SparseRaster::get, "Get the value of a cell")
+        .def("set", &SparseRaster::set, "Set the value of a cell")
+        .def("nbr_tiles", &SparseRaster::nbr_tiles, "Get the number of allocated tiles")
+        .def("memory_bytes", &SparseRaster::memory_bytes, "Get the size of the raster in memory");
+
+    py::class_<DemPyramid> pyramid(m, "DemPyramid", "Class for getting height maps and meshes at several resolutions from one grid");
+    py::enum_<DemPyramid::Reduction>(pyramid, "Reduction")
+        .value("MEAN", DemPyramid::MEAN)
+        .value("MIN", DemPyramid::MIN)
+        .value("MAX", DemPyramid::MAX)
+        .export_values();
+    pyramid
+        .def(py::init<const SparseRaster&, DemPyramid::Reduction, int>(), "Constructor, taking the finest SparseRaster height map, the reduction and the max number of levels (until one tile if 0)",
+             py::arg("height_map"), py::arg("reduction") = DemPyramid::MEAN, py::arg("max_levels") = 0)
+        .def(py::init<const Eigen::MatrixXd&, const DemPyramid::BoundsT&, float, DemPyramid::Reduction, int>(), "Constructor, taking the finest height map, its bounds and the value of the empty cells",
+             py::arg("height_map"), py::arg("bounds"), py::arg("nodata") = 0.f, py::arg("reduction") = DemPyramid::MEAN, py::arg("max_levels") = 0)
+        .def("nbr_levels", &DemPyramid::nbr_levels, "Get the number of levels")
+        .def("get_level", &DemPyramid::get_level, py::return_value_policy::reference_internal, "Get the SparseRaster of a level, 0 is the finest")
+        .def("get_resolution", &DemPyramid::get_resolution, "Get the cell size of a level")
+        .def("level_for_resolution", &DemPyramid::level_for_resolution, "Get the coarsest level with a cell size of at most res")
+        .def("get_height_map", &DemPyramid::get_height_map, py::call_guard<py::gil_scoped_release>(), "Get the height map and its bounds within bounds at a resolution")
+        .def("get_sparse_height_map", &DemPyramid::get_sparse_height_map, py::call_guard<py::gil_scoped_release>(), "Get the SparseRaster height map within bounds at a resolution")
+        .def("get_mesh", &DemPyramid::get_mesh, py::call_guard<py::gil_scoped_release>(), "Get the mesh V, F and its bounds within bounds at a resolution");
+
+    py::class_<HeightMapGridder> gridder(m, "HeightMapGridder", "Class for gridding soundings into height map layers in batches or ping by ping, using several threads");
+    py::enum_<HeightMapGridder::Layers>(gridder, "Layers", py::arithmetic())
+        .value("MEAN", HeightMapGridder::MEAN)
+        .value("MIN", HeightMapGridder::MIN)
+        .value("MAX", HeightMapGridder::MAX)
+        .value("MEDIAN", HeightMapGridder::MEDIAN)
+        .value("VARIANCE", HeightMapGridder::VARIANCE)
+        .value("ALL_LAYERS", HeightMapGridder::ALL_LAYERS)
+        .export_values();
+    gridder
+        .def(py::init<double, int, int>(), "Constructor, taking resolution, sum of the layers to accumulate and number of threads (one per core if 0)",
+             py::arg("res"), py::arg("layers") = int(HeightMapGridder::MEAN), py::arg("nbr_threads") = 0)
+        .def(py::init<const HeightMapGridder::BoundsT&, double, int, int>(), "Constructor, only keeping soundings within bounds",
+             py::arg("bounds"), py::arg("res"), py::arg("layers") = int(HeightMapGridder::MEAN), py::arg("nbr_threads") = 0)
+        .def("add_points", &HeightMapGridder::add_points, py::call_guard<py::gil_scoped_release>(), "Add a batch of N x 3 points")
+        .def("add_pings", &HeightMapGridder::add_pings, py::call_guard<py::gil_scoped_release>(), "Add the beams of a batch of mbes_ping::PingsT")
+        .def("add_ping", &HeightMapGridder::add_ping, py::call_guard<py::gil_scoped_release>(), "Add the beams of one mbes_ping as it arrives")
+        .def("get_bounds", &HeightMapGridder::get_bounds, "Get the bounds of the height map layers")
+        .def("get_layer", static_cast<Eigen::MatrixXd (HeightMapGridder::*)(HeightMapGridder::Layers) const>(&HeightMapGridder::get_layer),
+             "Get a height map layer, empty cells are zero")
+        .def("get_layer", static_cast<Eigen::MatrixXd (HeightMapGridder::*)(HeightMapGridder::Layers, const HeightMapGridder::BoundsT&) const>(&HeightMapGridder::get_layer),
+             "Get the cells of a height map layer within bounds")
+        .def("get_counts", &HeightMapGridder::get_counts, "Get the number of soundings in each cell")
+        .def("get_sparse_layer", &HeightMapGridder::get_sparse_layer, "Get a height map layer as a SparseRaster")
+        .def("get_dirty_bounds", &HeightMapGridder::get_dirty_bounds, "Get the bounds of the tiles changed since the last clear_dirty")
+        .def("clear_dirty", &HeightMapGridder::clear_dirty, "Clear the changed tiles");
+
+    m.def("mesh_from_height_map", (std::pair<Eigen::MatrixXd, Eigen::MatrixXi> (*)(const Eigen::MatrixXd&, const mesh_map::BoundsT&)) &mesh_map::mesh_from_height_map, "Construct mesh from height map");
+    m.def("mesh_from_height_map", (std::pair<Eigen::MatrixXd, Eigen::MatrixXi> (*)(const SparseRaster&)) &mesh_map::mesh_from_height_map, "Construct mesh from the cells with data of a SparseRaster height map");
+    m.def("compact_mesh_from_height_map", &mesh_map::compact_mesh_from_height_map, py::call_guard<py::gil_scoped_release>(),
+          "Construct mesh from height map with only the vertices used by faces, using several threads (one per core if 0)",
+          py::arg("height_map"), py::arg("bounds"), py::arg("nbr_threads") = 0);
+    m.def("compact_float_mesh_from_height_map", &mesh_map::compact_float_mesh_from_height_map, py::call_guard<py::gil_scoped_release>(),
+          "Same as compact_mesh_from_height_map, but with float32 vertices and int32 faces",
+          py::arg("height_map"), py::arg("bounds"), py::arg("nbr_threads") = 0);
     m.def("height_map_from_pings", &mesh_map::height_map_from_pings, "Construct height map from mbes_ping::PingsT");
     m.def("height_map_from_cloud", &mesh_map::height_map_from_cloud, "Construct height map from vector<Eigen::Vector3d>");
     m.def("height_map_from_dtm_cloud", &mesh_map::height_map_from_dtm_cloud, "Construct height map from vector<Eigen::Vector3d>");
@@ -43,6 +43,9 @@ PYBIND11_MODULE(patch_draper, m) {
         .def("set_sidescan_port_stbd_offsets", &PatchDraper::set_sidescan_port_stbd_offsets, "Set offsets of sidescan port and stbd sides with respect to nav frame")
         .def("set_tracing_map_size", &PatchDraper::set_tracing_map_size, "Set size of slice of map where we do ray tracing. Smaller makes it faster but you might cut off valid sidescan angles")
         .def("set_ray_tracing_enabled", &PatchDraper::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &PatchDraper::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &PatchDraper::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &PatchDraper::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
         .def("set_vehicle_mesh", &PatchDraper::set_vehicle_mesh, "Provide the viewer with a vehicle model, purely for visualization")
         .def("show", &PatchDraper::show, "Start the draping, and show the visualizer")
         // Methods unique to PatchDraper:
@@ -33,6 +33,9 @@ PYBIND11_MODULE(sss_gen_sim, m) {
         .def("set_sidescan_yaw", &SSSGenSim::set_sidescan_yaw, "Set yaw correction of sidescan with respect to nav frame")
         .def("set_sidescan_port_stbd_offsets", &SSSGenSim::set_sidescan_port_stbd_offsets, "Set offsets of sidescan port and stbd sides with respect to nav frame")
         .def("set_ray_tracing_enabled", &SSSGenSim::set_ray_tracing_enabled, "Set if ray tracing through water layers should be enabled. Takes more time but is recommended if there are large speed differences")
+        .def("set_tracing_height_map", &SSSGenSim::set_tracing_height_map, "Trace directly on the height map that the mesh was created from, instead of building a BVH of the mesh")
+        .def("set_nbr_sss_lines", &SSSGenSim::set_nbr_sss_lines, "Set the number of rays traced per sidescan side, default 500")
+        .def("set_adaptive_rays_per_sample", &SSSGenSim::set_adaptive_rays_per_sample, "Pick the number of rays from the sidescan sample resolution, with the given rays per sample. 0 disables")
         .def("set_vehicle_mesh", &SSSGenSim::set_vehicle_mesh, "Provide the viewer with a vehicle model, purely for visualization")
         .def("show", &SSSGenSim::show, "Start the draping, and show the visualizer")
         .def("draw_sim_waterfall", &SSSGenSim::draw_sim_waterfall, "Get the simulated waterfall from the incidence image")
@@ -36,7 +36,9 @@ PYBIND11_MODULE(all_data, m) {
         .def_readwrite("beams", &all_mbes_ping::beams, "Positions of hist in sensor coordinates")
         .def_readwrite("first_in_file_", &all_mbes_ping::first_in_file_, "Is first measurement in file?")
         .def_static("parse_file", &parse_file_from_str<all_mbes_ping>, "Parse all_mbes_ping from .all file")
-        .def_static("parse_folder", &parse_folder_from_str<all_mbes_ping>, "Parse all_mbes_ping from folder of .all files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<all_mbes_ping>, "Parse all_mbes_ping within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<all_mbes_ping>, "Parse all_mbes_ping from folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<all_mbes_ping>, "Parse all_mbes_ping from folder of .all files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<all_mbes_ping::PingsT>, "Read all_mbes_ping::PingsT from .cereal file");
 
     py::class_<all_nav_entry>(m, "all_nav_entry", "Class for the all nav entry")
@@ -51,7 +53,9 @@ PYBIND11_MODULE(all_data, m) {
         .def_readwrite("course_over_ground_", &all_nav_entry::course_over_ground_, "TODO")
         .def_readwrite("first_in_file_", &all_nav_entry::first_in_file_, "Is first measurement in file?")
         .def_static("parse_file", &parse_file_from_str<all_nav_entry>, "Parse all_nav_entry from .all file")
-        .def_static("parse_folder", &parse_folder_from_str<all_nav_entry>, "Parse all_nav_entry from folder of .all files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<all_nav_entry>, "Parse all_nav_entry within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<all_nav_entry>, "Parse all_nav_entry from folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<all_nav_entry>, "Parse all_nav_entry from folder of .all files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<all_nav_entry::EntriesT>, "Read all_nav_entry::EntriesT from .cereal file");
 
     py::class_<all_nav_depth>(m, "all_nav_depth", "Class for the all nav depth entry")
@@ -63,7 +67,9 @@ PYBIND11_MODULE(all_data, m) {
         .def_readwrite("height_type", &all_nav_depth::height_type, "TODO")
         .def_readwrite("first_in_file_", &all_nav_depth::first_in_file_, "Is first measurement in file?")
         .def_static("parse_file", &parse_file_from_str<all_nav_depth>, "Parse all_nav_depth from .all file")
-        .def_static("parse_folder", &parse_folder_from_str<all_nav_depth>, "Parse all_nav_depth from folder of .all files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<all_nav_depth>, "Parse all_nav_depth within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<all_nav_depth>, "Parse all_nav_depth from folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<all_nav_depth>, "Parse all_nav_depth from folder of .all files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<all_nav_depth::EntriesT>, "Read all_nav_depth::EntriesT from .cereal file");
 
     py::class_<all_nav_attitude_sample>(m, "all_nav_attitude_sample", "Class for the all nav attitude sample entry")
@@ -82,7 +88,9 @@ PYBIND11_MODULE(all_data, m) {
         .def_readwrite("first_in_file_", &all_nav_attitude::first_in_file_, "Is first measurement in file?")
         .def_readwrite("samples", &all_nav_attitude::samples, "The measurements")
         .def_static("parse_file", &parse_file_from_str<all_nav_attitude>, "Parse all_nav_attitude from .all file")
-        .def_static("parse_folder", &parse_folder_from_str<all_nav_attitude>, "Parse all_nav_attitude from folder of .all files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<all_nav_attitude>, "Parse all_nav_attitude within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<all_nav_attitude>, "Parse all_nav_attitude from folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<all_nav_attitude>, "Parse all_nav_attitude from folder of .all files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<all_nav_attitude::EntriesT>, "Read all_nav_attitude::EntriesT from .cereal file");
 
     py::class_<all_echosounder_depth>(m, "all_echosounder_depth", "Class for the all single-beam echosounder depth")
@@ -93,14 +101,33 @@ PYBIND11_MODULE(all_data, m) {
         .def_readwrite("depth_", &all_echosounder_depth::depth_, "Depth")
         .def_readwrite("first_in_file_", &all_echosounder_depth::first_in_file_, "Is first measurement in file?")
         .def_static("parse_file", &parse_file_from_str<all_echosounder_depth>, "Parse all_echosounder_depth from .all file")
-        .def_static("parse_folder", &parse_folder_from_str<all_echosounder_depth>, "Parse all_echosounder_depth from folder of .all files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<all_echosounder_depth>, "Parse all_echosounder_depth within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<all_echosounder_depth>, "Parse all_echosounder_depth from folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<all_echosounder_depth>, "Parse all_echosounder_depth from folder of .all files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<all_echosounder_depth::EntriesT>, "Read all_echosounder_depth::EntriesT from .cereal file");
 
+    py::class_<all_datagrams>(m, "all_datagrams", "Class containing all the decoded datagram types from .all files")
+        .def(py::init<>())
+        .def_readwrite("mbes_pings", &all_datagrams::mbes_pings, "all_mbes_ping::PingsT in the files")
+        .def_readwrite("nav_entries", &all_datagrams::nav_entries, "all_nav_entry::EntriesT in the files")
+        .def_readwrite("nav_depths", &all_datagrams::nav_depths, "all_nav_depth::EntriesT in the files")
+        .def_readwrite("nav_attitudes", &all_datagrams::nav_attitudes, "all_nav_attitude::EntriesT in the files")
+        .def_readwrite("echosounder_depths", &all_datagrams::echosounder_depths, "all_echosounder_depth::EntriesT in the files")
+        .def_static("parse_file", [](const std::string& file) { return parse_datagrams_file(file); }, "Parse all datagram types in one pass over .all file")
+        .def_static("parse_file_time_range", [](const std::string& file, long long start_time, long long end_time, const std::vector<int>& types) {
+            return parse_datagrams_file(file, start_time, end_time, types);
+        }, "Parse the datagrams with codes in types (all if empty) within a time stamp range from .all file, using an index to seek to them")
+        .def_static("parse_folder", [](const std::string& folder, int nbr_threads) {
+            return parse_datagrams_folder(folder, nbr_threads);
+        }, "Parse all datagram types in one pass over each file in folder of .all files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("read_data", &read_data_from_str<all_datagrams>, "Read all_datagrams from .cereal file");
+
     m.def("write_data", &write_data_from_str<all_mbes_ping::PingsT>, "Write all_mbes_ping::PingsT to .cereal file");
     m.def("write_data", &write_data_from_str<all_nav_entry::EntriesT>, "Write all_nav_entry::EntriesT to .cereal file");
     m.def("write_data", &write_data_from_str<all_nav_depth::EntriesT>, "Write all_nav_depth::EntriesT to .cereal file");
     m.def("write_data", &write_data_from_str<all_nav_attitude::EntriesT>, "Write all_nav_attitude::EntriesT to .cereal file");
     m.def("write_data", &write_data_from_str<all_echosounder_depth::EntriesT>, "Write all_echosounder_depth::EntriesT to .cereal file");
+    m.def("write_data", &write_data_from_str<all_datagrams>, "Write all_datagrams to .cereal file");
     //m.def("convert_matched_entries", (all_mbes_ping::PingsT (*)(all_mbes_ping::PingsT&, all_nav_entry::EntriesT&) ) &convert_matched_entries, "Matches xtf_sss_ping::PingsT and csv_nav_entry::EntriesT and assign pos data to pings");
     m.def("convert_matched_entries", &convert_matched_entries, "Matches all_mbes_ping::PingsT and all_nav_entry::EntriesT and assign pos data to pings");
     m.def("match_attitude", &match_attitude, "Match mbes_ping::PingsT and all_nav_attitude::EntriesT and assign attitude data to pings");
@@ -112,5 +139,8 @@ PYBIND11_MODULE(all_data, m) {
         .def(py::init<>())
         .def("parse_packet", &StreamParser::parse_packet, "Parse a string containing the packet load, and call the set callbacks with the corresponding data types")
         .def("set_mbes_callback", &StreamParser::set_mbes_callback, "Callback to call when encountering all_mbes_ping packets")
-        .def("set_nav_entry_callback", &StreamParser::set_nav_entry_callback, "Callback to call when encountering all_nav_entry packets");
+        .def("set_nav_entry_callback", &StreamParser::set_nav_entry_callback, "Callback to call when encountering all_nav_entry packets")
+        .def("set_nav_depth_callback", &StreamParser::set_nav_depth_callback, "Callback to call when encountering all_nav_depth packets")
+        .def("set_nav_attitude_callback", &StreamParser::set_nav_attitude_callback, "Callback to call when encountering all_nav_attitude packets")
+        .def("set_echosounder_depth_callback", &StreamParser::set_echosounder_depth_callback, "Callback to call when encountering all_echosounder_depth packets");
 }
@@ -14,6 +14,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 using namespace csv_data;
@@ -39,7 +40,8 @@ PYBIND11_MODULE(csv_data, m) {
         .def_readwrite("pos_", &csv_nav_entry::pos_, "Position in ENU coordinates")
         .def_readwrite("vel_", &csv_nav_entry::vel_, "Velocity")
         .def_static("parse_file", &parse_file_from_str<csv_nav_entry>, "Parse csv_nav_entry from .csv file")
-        .def_static("parse_folder", &parse_folder_from_str<csv_nav_entry>, "Parse csv_nav_entry from folder of .csv files")
+        .def_static("parse_folder", &parse_folder_from_str<csv_nav_entry>, "Parse csv_nav_entry from folder of .csv files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<csv_nav_entry>, "Parse csv_nav_entry from folder of .csv files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<csv_nav_entry::EntriesT>, "Read csv_nav_entry::EntriesT from .cereal file");
 
     py::class_<csv_asvp_sound_speed>(m, "csv_asvp_sound_speed", "Class for a csv based nav entry")
@@ -51,7 +53,8 @@ PYBIND11_MODULE(csv_data, m) {
         .def_readwrite("dbars", &csv_asvp_sound_speed::dbars, "Pressure in decibars")
         .def_readwrite("vels", &csv_asvp_sound_speed::vels, "Corresponding velocities in m/s")
         .def_static("parse_file", &parse_file_from_str<csv_asvp_sound_speed>, "Parse csv_asvp_sound_speed from .csv file")
-        .def_static("parse_folder", &parse_folder_from_str<csv_asvp_sound_speed>, "Parse csv_asvp_sound_speed from folder of .csv files")
+        .def_static("parse_folder", &parse_folder_from_str<csv_asvp_sound_speed>, "Parse csv_asvp_sound_speed from folder of .csv files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<csv_asvp_sound_speed>, "Parse csv_asvp_sound_speed from folder of .csv files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<csv_asvp_sound_speed::EntriesT>, "Read csv_asvp_sound_speed::EntriesT from .cereal file");
 
     m.def("write_data", &write_data_from_str<csv_nav_entry::EntriesT>, "Write csv_nav_entry::EntriesT to .cereal file");
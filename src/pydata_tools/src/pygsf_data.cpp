@@ -14,6 +14,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 using namespace gsf_data;
@@ -75,7 +76,8 @@ PYBIND11_MODULE(gsf_data, m) {
         .def_readwrite("depth_", &gsf_mbes_ping::depth_, "Depth")
         .def_readwrite("beams", &gsf_mbes_ping::beams, "The hit positions in vehicle coordinates")
         .def_static("parse_file", &parse_file_from_str<gsf_mbes_ping>, "Parse gsf_mbes_ping from .gsf file")
-        .def_static("parse_folder", &parse_folder_from_str<gsf_mbes_ping>, "Parse gsf_mbes_ping from folder of .gsf files")
+        .def_static("parse_folder", &parse_folder_from_str<gsf_mbes_ping>, "Parse gsf_mbes_ping from folder of .gsf files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<gsf_mbes_ping>, "Parse gsf_mbes_ping from folder of .gsf files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<gsf_mbes_ping::PingsT>, "Read gsf_mbes_ping::PingsT from .cereal file");
     //PybindCerealArchive<gsf_mbes_ping> archive(c);
     //gsf_mbes_ping example; example.serialize(archive);
@@ -87,7 +89,8 @@ PYBIND11_MODULE(gsf_data, m) {
         .def_readwrite("near_speed", &gsf_sound_speed::near_speed, "Sound speed at vehicle depth")
         .def_readwrite("below_speed", &gsf_sound_speed::below_speed, "Sound speed below vehicle")
         .def_static("parse_file", &parse_file_from_str<gsf_sound_speed>, "Parse gsf_sound_speed from .gsf file")
-        .def_static("parse_folder", &parse_folder_from_str<gsf_sound_speed>, "Parse gsf_sound_speed from folder of .gsf files")
+        .def_static("parse_folder", &parse_folder_from_str<gsf_sound_speed>, "Parse gsf_sound_speed from folder of .gsf files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<gsf_sound_speed>, "Parse gsf_sound_speed from folder of .gsf files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<gsf_sound_speed::SpeedsT>, "Read gsf_sound_speed::SpeedsT from .cereal file");
 
     py::class_<gsf_nav_entry>(m, "gsf_nav_entry", "Class for the gsf nav entry type")
@@ -103,7 +106,8 @@ PYBIND11_MODULE(gsf_data, m) {
         .def_readwrite("altitude", &gsf_nav_entry::altitude, "Altitude")
         .def_readwrite("pos_", &gsf_nav_entry::pos_, "Position in ENU coordinates")
         .def_static("parse_file", &parse_file_from_str<gsf_nav_entry>, "Parse gsf_nav_entry from .gsf file")
-        .def_static("parse_folder", &parse_folder_from_str<gsf_nav_entry>, "Parse gsf_nav_entry from folder of .gsf files")
+        .def_static("parse_folder", &parse_folder_from_str<gsf_nav_entry>, "Parse gsf_nav_entry from folder of .gsf files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<gsf_nav_entry>, "Parse gsf_nav_entry from folder of .gsf files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<gsf_nav_entry::EntriesT>, "Read gsf_nav_entry::EntriesT from .cereal file");
 
     m.def("write_data", &write_data_from_str<gsf_mbes_ping::PingsT>, "Write gsf_mbes_ping::PingsT to .cereal file");
@@ -14,6 +14,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 using namespace jsf_data;
@@ -44,7 +45,12 @@ PYBIND11_MODULE(jsf_data, m) {
         .def_readwrite("frequency", &jsf_sss_ping::frequency, "Frequency of sampling")
         .def_readwrite("pos_", &jsf_sss_ping::pos_, "Position in ENU coordinates")
         .def_static("parse_file", &parse_file_from_str<jsf_sss_ping>, "Parse jsf_sss_ping from .jsf file")
-        .def_static("parse_folder", &parse_folder_from_str<jsf_sss_ping>, "Parse jsf_sss_ping from folder of .jsf files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<jsf_sss_ping>, "Parse jsf_sss_ping within a time stamp range from .jsf file, using an index to seek to them")
+        .def_static("parse_mapped_file", [](const std::string& file, int nbr_threads) {
+            return parse_mapped_file<jsf_sss_ping>(file, nbr_threads);
+        }, "Parse jsf_sss_ping from memory mapped .jsf file, decoding with nbr_threads threads (one per core if 0)")
+        .def_static("parse_folder", &parse_folder_from_str<jsf_sss_ping>, "Parse jsf_sss_ping from folder of .jsf files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<jsf_sss_ping>, "Parse jsf_sss_ping from folder of .jsf files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<jsf_sss_ping::PingsT>, "Read jsf_sss_ping::PingsT from .cereal file");
 
     m.def("write_data", &write_data_from_str<jsf_sss_ping::PingsT>, "Write jsf pings to .cereal file");
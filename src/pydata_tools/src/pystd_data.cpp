@@ -11,10 +11,13 @@
 
 #include <data_tools/std_data.h>
 #include <data_tools/navi_data.h>
+#include <data_tools/ping_cache.h>
+#include <data_tools/sss_store.h>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 
@@ -37,7 +40,8 @@ PYBIND11_MODULE(std_data, m) {
         .def_readwrite("beams", &mbes_ping::beams, "The beam hits in world ENU coordinates")
         .def_readwrite("back_scatter", &mbes_ping::back_scatter, "The beam reflectivities")
         .def_static("parse_file", &parse_file_from_str<mbes_ping>, "Parse mbes_ping from an ASCII file exported from NaviEdit")
-        .def_static("parse_folder", &parse_folder_from_str<mbes_ping>, "Parse mbes_ping from folder of ASCII files exported from NaviEdit")
+        .def_static("parse_folder", &parse_folder_from_str<mbes_ping>, "Parse mbes_ping from folder of ASCII files exported from NaviEdit, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<mbes_ping>, "Parse mbes_ping from folder of ASCII files exported from NaviEdit, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<mbes_ping::PingsT>, "Read mbes_ping::PingsT from .cereal file");
 
     py::class_<nav_entry>(m, "nav_entry", "Standard class interface for working with navigation data")
@@ -47,7 +51,8 @@ PYBIND11_MODULE(std_data, m) {
         .def_readwrite("first_in_file_", &nav_entry::first_in_file_, "Is first measurement in file?")
         .def_readwrite("pos_", &nav_entry::pos_, "Position in ENU coordinates")
         .def_static("parse_file", &parse_file_from_str<nav_entry>, "Parse nav_entry from an ASCII file exported from NaviEdit")
-        .def_static("parse_folder", &parse_folder_from_str<nav_entry>, "Parse nav_entry from folder of ASCII files exported from NaviEdit")
+        .def_static("parse_folder", &parse_folder_from_str<nav_entry>, "Parse nav_entry from folder of ASCII files exported from NaviEdit, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<nav_entry>, "Parse nav_entry from folder of ASCII files exported from NaviEdit, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<nav_entry::EntriesT>, "Read nav_entry::Entries from .cereal file");
 
     py::class_<attitude_entry>(m, "attitude_entry", "Standard class interface for working with attitude data")
@@ -85,9 +90,41 @@ PYBIND11_MODULE(std_data, m) {
         .def_readwrite("pos_", &std_data::sss_ping::pos_, "Position in ENU coordinates")
         .def_static("read_data", &read_data_from_str<std_data::sss_ping::PingsT>, "Read sss_ping::PingsT from .cereal file");
 
+    py::class_<compressed_sss_pings>(m, "compressed_sss_pings", "sss_ping::PingsT stored as compressed chunks")
+        .def_static("compress", &compress_sss_pings, "Compress sss_ping::PingsT in chunks of pings_per_chunk, using nbr_threads threads (one per core if 0)", py::arg("pings"), py::arg("pings_per_chunk") = 256, py::arg("nbr_threads") = 0)
+        .def("__len__", &compressed_sss_pings::size)
+        .def("ping", &compressed_sss_pings::ping, "Decompress ping i")
+        .def("decompress", [](const compressed_sss_pings& compressed, int nbr_threads) {
+            sss_ping::PingsT pings;
+            if (!compressed.decompress(pings, nbr_threads)) {
+                throw py::value_error("Corrupt sss ping chunk");
+            }
+            return pings;
+        }, "Decompress all pings, using nbr_threads threads (one per core if 0)", py::arg("nbr_threads") = 0);
+
     m.def("write_data", &write_data_from_str<mbes_ping::PingsT>, "Write mbes_ping::PingsT to .cereal file");
     m.def("write_data", &write_data_from_str<nav_entry::EntriesT>, "Write nav_entry::EntriesT to .cereal file");
     m.def("write_data", &write_data_from_str<attitude_entry::EntriesT>, "Write attitude_entry::EntriesT to .cereal file");
     m.def("write_data", &write_data_from_str<sss_ping::PingsT>, "Write sss_ping::PingsT to .cereal file");
+    m.def("write_ping_cache", [](const mbes_ping::PingsT& pings, const std::string& path) {
+        write_ping_cache(pings, boost::filesystem::path(path));
+    }, "Write mbes_ping::PingsT to a columnar ping cache file that can be opened with mapped_pings");
+
+    py::class_<mapped_pings>(m, "mapped_pings", "Memory mapped, read-only columnar ping cache")
+        .def(py::init([](const std::string& path) { return new mapped_pings(boost::filesystem::path(path)); }))
+        .def("__len__", &mapped_pings::size)
+        .def("__getitem__", [](const mapped_pings& pings, size_t i) {
+            if (i >= pings.size()) {
+                throw py::index_error();
+            }
+            return pings[i].to_ping();
+        }, "Copy of ping i as an mbes_ping")
+        .def("beams", &mapped_pings::beams, py::return_value_policy::reference_internal, "Nx3 array of all beams, without copying")
+        .def("back_scatter", &mapped_pings::back_scatter, py::return_value_policy::reference_internal, "Array of all back scatter values, without copying")
+        .def("beam_offsets", &mapped_pings::beam_offsets, py::return_value_policy::reference_internal, "Index of the first beam of each ping, with the total number of beams last")
+        .def("time_stamps", &mapped_pings::time_stamps, py::return_value_policy::reference_internal, "Time stamps of the pings")
+        .def("poses", &mapped_pings::poses, py::return_value_policy::reference_internal, "Nx3 array of ping positions")
+        .def("attitudes", &mapped_pings::attitudes, py::return_value_policy::reference_internal, "Nx4 array of heading, heave, pitch and roll of the pings")
+        .def("to_pings", &mapped_pings::to_pings, "Copy all pings into an mbes_ping::PingsT");
 
 }
@@ -14,6 +14,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 using namespace xtf_data;
@@ -46,11 +47,14 @@ PYBIND11_MODULE(xtf_data, m) {
         .def_readwrite("sound_vel_", &xtf_sss_ping::sound_vel_, "Sound speed in m/s")
         .def_readwrite("pos_", &xtf_sss_ping::pos_, "Position in ENU coordinates")
         .def_static("parse_file", &parse_file_from_str<xtf_sss_ping>, "Parse xtf_sss_ping from .xtf file")
-        .def_static("parse_folder", &parse_folder_from_str<xtf_sss_ping>, "Parse xtf_sss_ping from folder of .xtf files")
+        .def_static("parse_file_time_range", &parse_file_time_range_from_str<xtf_sss_ping>, "Parse xtf_sss_ping within a time stamp range from .xtf file, using an index to seek to them")
+        .def_static("parse_folder", &parse_folder_from_str<xtf_sss_ping>, "Parse xtf_sss_ping from folder of .xtf files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<xtf_sss_ping>, "Parse xtf_sss_ping from folder of .xtf files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<xtf_sss_ping::PingsT>, "Read xtf_sss_ping::PingsT from .cereal file");
 
     m.def("write_data", &write_data_from_str<xtf_sss_ping::PingsT>, "Write xtf pings to .cereal file");
-    m.def("make_waterfall_image", &make_eigen_waterfall_image, "Create a cv2 waterfall image from xtf_sss_ping::PingsT");
+    m.def("make_waterfall_image", static_cast<Eigen::MatrixXd (*)(const xtf_sss_ping::PingsT&)>(&make_eigen_waterfall_image), "Create a cv2 waterfall image from xtf_sss_ping::PingsT");
+    m.def("make_waterfall_image", static_cast<Eigen::MatrixXd (*)(const std_data::compressed_sss_pings&, int)>(&make_eigen_waterfall_image), "Create a cv2 waterfall image from compressed_sss_pings, using nbr_threads threads (one per core if 0)", py::arg("pings"), py::arg("nbr_threads") = 0);
     m.def("show_waterfall_image", &show_waterfall_image, "Show a waterfall image created from xtf_sss_ping::PingsT");
     m.def("correct_sensor_offset", &correct_sensor_offset, "Move the sensor onboard the vehicle with a given translation");
     m.def("match_attitudes", &match_attitudes, "Get roll and pitch from std_data::attitude_entry by matching timestamps");
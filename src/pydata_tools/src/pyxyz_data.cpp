@@ -14,6 +14,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
 
 using namespace std_data;
 
@@ -28,7 +29,11 @@ PYBIND11_MODULE(xyz_data, m) {
         .def_static("to_matrix", &xyz_data::to_matrix, "Create an Nx3 matrix from the list of points")
         .def_static("from_matrix", &xyz_data::from_matrix, "Create Points from an Nx3 matrix")
         .def_static("parse_file", &parse_file_from_str<Eigen::Vector3d>, "Parse xyz_data::Points from .xyz file")
-        .def_static("parse_folder", &parse_folder_from_str<Eigen::Vector3d>, "Parse xyz_data::Points from folder of .xyz files")
+        .def_static("parse_mapped_file", [](const std::string& file, int nbr_threads) {
+            return xyz_data::parse_mapped_file(boost::filesystem::path(file), nbr_threads);
+        }, "Parse xyz_data::Points from a memory mapped .xyz file, using nbr_threads threads (one per core if 0)", py::arg("file"), py::arg("nbr_threads") = 0)
+        .def_static("parse_folder", &parse_folder_from_str<Eigen::Vector3d>, "Parse xyz_data::Points from folder of .xyz files, using nbr_threads threads (one per core if 0)", py::arg("folder"), py::arg("nbr_threads") = 1)
+        .def_static("parse_folder_batches", &parse_folder_batches_from_str<Eigen::Vector3d>, "Parse xyz_data::Points from folder of .xyz files, calling callback with batches of at most batch_size entries", py::arg("folder"), py::arg("batch_size"), py::arg("callback"))
         .def_static("read_data", &read_data_from_str<xyz_data::Points>, "Read xyz_data::Points from .cereal file");
 
 
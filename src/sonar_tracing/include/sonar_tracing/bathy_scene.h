@@ -0,0 +1,63 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BATHY_SCENE_H
+#define BATHY_SCENE_H
+
+#include <Eigen/Dense>
+#include <embree3/rtcore.h>
+#include <memory>
+#include <cstdint>
+
+// an immutable embree bvh of a bathymetry mesh. scenes are shared through
+// BathyScene::Ptr and looked up by the content hash of V, F, so that building
+// the same mesh twice gives back the same bvh. on a hash match, the mesh is
+// compared with the float copy in the embree buffers, so colliding meshes get
+// their own scenes. tracing against a committed scene is thread safe, each
+// thread should use its own BathyTracer
+class BathyScene
+{
+public:
+
+    using Ptr = std::shared_ptr<const BathyScene>;
+
+private:
+
+    RTCScene scene;
+    uint64_t hash;
+    int nbr_vertices;
+    int nbr_faces;
+    const float* vertices; // owned by the geometry of scene
+    const unsigned* indices; // owned by the geometry of scene
+
+    BathyScene(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, uint64_t hash);
+
+    // true if the scene was built from V, F, up to their float conversion
+    bool same_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F) const;
+
+public:
+
+    BathyScene(const BathyScene&) = delete;
+    BathyScene& operator=(const BathyScene&) = delete;
+    ~BathyScene();
+
+    // returns the shared scene of V, F, building it if no live scene has the same contents
+    static Ptr create(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+
+    static uint64_t content_hash(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+
+    RTCScene rtc_scene() const { return scene; }
+    uint64_t get_hash() const { return hash; }
+    int get_nbr_vertices() const { return nbr_vertices; }
+    int get_nbr_faces() const { return nbr_faces; }
+};
+
+#endif // BATHY_SCENE_H
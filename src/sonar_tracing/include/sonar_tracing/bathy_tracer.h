@@ -2,26 +2,76 @@
 #define BATHY_TRACER_H
 
 #include <Eigen/Dense>
-#include <igl/embree/EmbreeIntersector.h>
+#include <sonar_tracing/bathy_scene.h>
+#include <sonar_tracing/height_field_scene.h>
 
+// scratch buffers for tracing one ping at a time, each tracer context owns one set
+// so that they are only allocated once per thread and then reused between pings
+struct ray_buffers
+{
+    Eigen::MatrixXd dirs_left;
+    Eigen::MatrixXd dirs_right;
+    Eigen::MatrixXd hits;
+    Eigen::VectorXi hits_inds;
+    Eigen::VectorXd hits_dists;
+};
+
+// a lightweight query context that traces rays against a shared BathyScene.
+// tracers are cheap to copy, use one per thread. if a height field is set, rays are
+// traced on it instead and the V, F arguments are only used by the embree scene
 class BathyTracer
 {
 private:
 
-    igl::embree::EmbreeIntersector embree;
-    Eigen::Vector3d first_V;
-    Eigen::Vector3i first_F;
+    BathyScene::Ptr scene; // bound with set_scene or set_mesh
+    HeightFieldScene::Ptr height_field;
+    BathyScene::Ptr last_scene; // of the last mesh looked up without a bound scene
+
+    // the bound scene if there is one, otherwise the shared scene of the contents of V, F
+    RTCScene mesh_scene(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
 
 public:
 
+    ray_buffers buffers; // reused by the callers between pings, not shared between copies
+
     BathyTracer()
     {
-        first_V.setZero();
-        first_F.setZero();
     }
 
+    BathyTracer(const BathyScene::Ptr& scene) : scene(scene)
+    {
+    }
+
+    // binds the tracer to a scene, the V, F arguments of the tracing functions are then
+    // ignored until the scene is reset. without a bound scene, every call looks up
+    // the scene of V, F by content, which costs a pass over the mesh
+    void set_scene(const BathyScene::Ptr& new_scene);
+    const BathyScene::Ptr& get_scene() const { return scene; }
+    // binds the tracer to the shared scene of V, F, copies of the tracer can then
+    // trace that mesh without looking it up again
+    void set_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
+    // traces the height map directly, the meshes passed to the tracer must then be the
+    // output of mesh_from_height_map or compact_mesh_from_height_map for the same height
+    // map, since faces are indexed as in F
+    void set_height_field(const HeightFieldScene::Ptr& new_height_field) { height_field = new_height_field; }
+    const HeightFieldScene::Ptr& get_height_field() const { return height_field; }
+
     std::tuple<Eigen::MatrixXd, Eigen::MatrixXi> compute_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs, const Eigen::MatrixXd& V, const Eigen::MatrixXi& F);
 
+    // traces dirs from sensor_origin in packets of 8 rays and writes the hit points,
+    // face indices and distances of the rays that hit into the first rows of
+    // hits, hits_inds and hits_dists, which are only reallocated if too small.
+    // returns the number of hits
+    int compute_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs,
+                     const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                     Eigen::MatrixXd& hits, Eigen::VectorXi& hits_inds, Eigen::VectorXd& hits_dists);
+
+    // same as above but keeps the order of the rays, the hit point of ray i is written to
+    // row i of hits and its face index to hits_inds(i), or -1 if the ray did not hit
+    void compute_ray_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs,
+                          const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                          Eigen::MatrixXd& hits, Eigen::VectorXi& hits_inds);
+
     Eigen::MatrixXd ray_mesh_intersection(
         const Eigen::MatrixXd& V_source,
         const Eigen::MatrixXd& N_source,
@@ -0,0 +1,82 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HEIGHT_FIELD_SCENE_H
+#define HEIGHT_FIELD_SCENE_H
+
+#include <Eigen/Dense>
+#include <memory>
+#include <vector>
+
+struct height_field_hit {
+    int face; // index of the face in the mesh of mesh_from_height_map
+    double u; // barycentric coordinates of the hit, as in embree
+    double v;
+    double t; // ray parameter of the hit, in units of the direction
+    Eigen::Vector3d point;
+};
+
+// an immutable tracing scene for the regular grid meshes of mesh_from_height_map,
+// traced directly on the height map instead of a bvh. the grid vertex (y, x) is at
+// ((x+.5)*res, (y+.5)*res, height_map(y, x)) and zero heights are missing data, as
+// in mesh_from_height_map. rays descend a min/max mipmap of the grid cells front to
+// back and are only intersected with the two triangles of the cells they reach.
+// face indices are the same as in the F of mesh_from_height_map
+class HeightFieldScene
+{
+public:
+
+    using Ptr = std::shared_ptr<const HeightFieldScene>;
+
+private:
+
+    int rows;
+    int cols;
+    double res;
+    std::vector<float> heights; // rows*cols, row major
+    std::vector<int> block_faces; // number of faces before each block of face_block_size vertices
+    int nbr_faces;
+    // min and max heights of blocks of 2^l x 2^l cells, level 0 (the cells) is not stored
+    std::vector<std::vector<float> > min_levels;
+    std::vector<std::vector<float> > max_levels;
+    std::vector<int> level_rows;
+    std::vector<int> level_cols;
+    Eigen::Vector3d bounds_min;
+    Eigen::Vector3d bounds_max;
+
+    float height(int y, int x) const { return heights[y*cols+x]; }
+    // the triangles emitted at vertex (y, x) by mesh_from_height_map, the upper one with
+    // vertices (y, x), (y, x-1), (y-1, x) and the lower one with (y, x), (y, x+1), (y+1, x)
+    bool has_upper_face(int y, int x) const;
+    bool has_lower_face(int y, int x) const;
+    int first_face(int y, int x) const;
+
+    bool intersect_cell(int y, int x, const Eigen::Vector3d& origin, const Eigen::Vector3d& dir,
+                        double t_max, height_field_hit& hit) const;
+
+public:
+
+    HeightFieldScene(const Eigen::MatrixXd& height_map, double res);
+    HeightFieldScene(const HeightFieldScene&) = delete;
+    HeightFieldScene& operator=(const HeightFieldScene&) = delete;
+
+    static Ptr create(const Eigen::MatrixXd& height_map, double res);
+
+    // finds the first hit of origin + t*dir, t >= 0, returns false if there is none
+    bool intersect(const Eigen::Vector3d& origin, const Eigen::Vector3d& dir, height_field_hit& hit) const;
+
+    int get_rows() const { return rows; }
+    int get_cols() const { return cols; }
+    double get_resolution() const { return res; }
+    int get_nbr_faces() const { return nbr_faces; }
+};
+
+#endif // HEIGHT_FIELD_SCENE_H
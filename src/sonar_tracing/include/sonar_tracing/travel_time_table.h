@@ -0,0 +1,82 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRAVEL_TIME_TABLE_H
+#define TRAVEL_TIME_TABLE_H
+
+#include <Eigen/Dense>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+
+// two way travel times from a sensor through horizontal sound speed layers, tabulated
+// over (horizontal range, depth below sensor). the table is filled by shooting rays at a
+// dense set of launch angles with the closed form snell solution and interpolating
+// between neighbouring rays, queries interpolate the time per distance bilinearly.
+// layer_depths and layer_speeds follow trace_multiple_layers: the depths are negative
+// and relative to the sensor, layer_speeds(k) is the speed above layer_depths(k)
+// and the last speed is also used below the last depth
+class TravelTimeTable
+{
+public:
+
+    using Ptr = std::shared_ptr<const TravelTimeTable>;
+
+private:
+
+    double range_res;
+    double depth_res;
+    // two way times over the straight distance, rows are depths and cols are ranges. this is
+    // close to twice the mean slowness and smooth, unlike the times near the sensor
+    Eigen::MatrixXd time_per_dist;
+    Eigen::VectorXd slowness; // mean vertical slowness down to each depth row, used outside the table
+
+    double fallback_time(double range, double depth) const;
+
+public:
+
+    TravelTimeTable(const Eigen::VectorXd& layer_depths, const Eigen::VectorXd& layer_speeds,
+                    double max_range, double max_depth, double resolution = 0.5, int nbr_angles = 2048);
+
+    // end point is (range, height) relative to the sensor, with height < 0
+    double two_way_time(const Eigen::Vector2d& end_point) const;
+    // drop-in for the times of trace_multiple_layers, with one end point per row
+    Eigen::VectorXd two_way_times(const Eigen::MatrixXd& end_points) const;
+};
+
+// thread safe cache of tables, one per sound speed profile and sensor depth,
+// where the sensor depth is rounded to depth_step
+class TravelTimeTableCache
+{
+private:
+
+    double max_range;
+    double floor_height; // lowest height in the world frame that needs to be covered
+    double resolution;
+    double depth_step;
+
+    std::mutex tables_mutex;
+    std::map<std::pair<int, std::vector<double> >, TravelTimeTable::Ptr> tables;
+
+public:
+
+    TravelTimeTableCache(double max_range, double floor_height, double resolution = 0.5, double depth_step = 0.25);
+
+    // layer_heights are absolute heights in the world frame, same as sensor_height
+    TravelTimeTable::Ptr get_table(const Eigen::VectorXd& layer_heights, const Eigen::VectorXd& layer_speeds, double sensor_height);
+
+    // two way times from sensor_origin to all points P, in the world frame
+    Eigen::VectorXd compute_times(const Eigen::VectorXd& layer_heights, const Eigen::VectorXd& layer_speeds,
+                                  const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P);
+};
+
+#endif // TRAVEL_TIME_TABLE_H
@@ -0,0 +1,168 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sonar_tracing/bathy_scene.h>
+#include <unordered_map>
+#include <mutex>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+RTCDevice embree_device()
+{
+    static RTCDevice device = rtcNewDevice(nullptr);
+    return device;
+}
+
+// mixes one 64 bit word into the hash, see splitmix64
+uint64_t hash_combine(uint64_t hash, uint64_t word)
+{
+    hash ^= word + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+uint64_t hash_bytes(uint64_t hash, const char* data, size_t size)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(uint64_t));
+        hash = hash_combine(hash, word);
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        memcpy(&word, data + i, size - i);
+        hash = hash_combine(hash, word);
+    }
+    return hash;
+}
+
+// live scenes, keyed by content hash
+mutex scenes_mutex;
+unordered_map<uint64_t, weak_ptr<const BathyScene> > scenes;
+
+} // namespace
+
+BathyScene::BathyScene(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, uint64_t hash)
+    : hash(hash), nbr_vertices(V.rows()), nbr_faces(F.rows())
+{
+    RTCDevice device = embree_device();
+    scene = rtcNewScene(device);
+    // robust traversal replaces the jittered extra rays of igl's intersectBeam
+    rtcSetSceneFlags(scene, RTC_SCENE_FLAG_ROBUST);
+    rtcSetSceneBuildQuality(scene, RTC_BUILD_QUALITY_HIGH);
+
+    // the float copy is written directly into the embree buffers, once per mesh
+    RTCGeometry geometry = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    float* vertex_buffer = (float*)rtcSetNewGeometryBuffer(geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                                                           3*sizeof(float), V.rows());
+    for (int i = 0; i < V.rows(); ++i) {
+        vertex_buffer[3*i+0] = V(i, 0);
+        vertex_buffer[3*i+1] = V(i, 1);
+        vertex_buffer[3*i+2] = V(i, 2);
+    }
+    unsigned* index_buffer = (unsigned*)rtcSetNewGeometryBuffer(geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                                                                3*sizeof(unsigned), F.rows());
+    for (int i = 0; i < F.rows(); ++i) {
+        index_buffer[3*i+0] = F(i, 0);
+        index_buffer[3*i+1] = F(i, 1);
+        index_buffer[3*i+2] = F(i, 2);
+    }
+    vertices = vertex_buffer;
+    indices = index_buffer;
+    rtcCommitGeometry(geometry);
+    rtcAttachGeometry(scene, geometry);
+    rtcReleaseGeometry(geometry);
+    rtcCommitScene(scene);
+}
+
+BathyScene::~BathyScene()
+{
+    rtcReleaseScene(scene);
+}
+
+bool BathyScene::same_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F) const
+{
+    if (V.rows() != nbr_vertices || F.rows() != nbr_faces) {
+        return false;
+    }
+    for (int i = 0; i < V.rows(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            // bitwise, so that meshes with nan heights compare equal too
+            float value = V(i, j);
+            if (memcmp(&vertices[3*i+j], &value, sizeof(float)) != 0) {
+                return false;
+            }
+        }
+    }
+    for (int i = 0; i < F.rows(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (indices[3*i+j] != unsigned(F(i, j))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t BathyScene::content_hash(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+    uint64_t hash = hash_combine(uint64_t(V.rows()), uint64_t(F.rows()));
+    hash = hash_bytes(hash, (const char*)V.data(), V.size()*sizeof(double));
+    hash = hash_bytes(hash, (const char*)F.data(), F.size()*sizeof(int));
+    return hash;
+}
+
+BathyScene::Ptr BathyScene::create(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+    uint64_t hash = content_hash(V, F);
+
+    {
+        lock_guard<mutex> lock(scenes_mutex);
+        auto iter = scenes.find(hash);
+        if (iter != scenes.end()) {
+            Ptr scene = iter->second.lock();
+            if (scene && scene->same_mesh(V, F)) {
+                return scene;
+            }
+        }
+    }
+
+    // build outside the lock, other threads may trace or build other meshes meanwhile
+    Ptr scene(new BathyScene(V, F, hash));
+
+    lock_guard<mutex> lock(scenes_mutex);
+    for (auto iter = scenes.begin(); iter != scenes.end(); ) {
+        if (iter->second.expired()) {
+            iter = scenes.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+    auto iter = scenes.find(hash);
+    if (iter != scenes.end()) {
+        Ptr other = iter->second.lock();
+        if (other && other->same_mesh(V, F)) {
+            return other; // built concurrently by another thread
+        }
+        if (other) {
+            return scene; // hash collision, the scene is not shared
+        }
+    }
+    scenes[hash] = scene;
+
+    return scene;
+}
@@ -1,24 +1,96 @@
 #include <sonar_tracing/bathy_tracer.h>
 #include <chrono>
-#include <igl/barycentric_to_global.h>
+#include <iostream>
+#include <limits>
 
 using namespace std;
 
 const bool DEBUG_OUTPUT = false;
 
+namespace {
+
+// number of rays traced together, 8 fills the AVX2 lanes
+const int packet_size = 8;
+
+// traces the rays origin(i) + t*dirs.row(i) in packets, calling
+// hit_fn(i, face, u, v, t) for each ray, with face = -1 for misses
+template <typename OriginFunc, typename HitFunc>
+void intersect_packets(RTCScene scene, const Eigen::MatrixXd& dirs, OriginFunc origin, HitFunc hit_fn)
+{
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    alignas(32) int valid[packet_size];
+    RTCRayHit8 rayhit;
+
+    int nbr_rays = dirs.rows();
+    for (int start = 0; start < nbr_rays; start += packet_size) {
+        int nbr_lanes = min(packet_size, nbr_rays - start);
+        for (int j = 0; j < packet_size; ++j) {
+            valid[j] = j < nbr_lanes? -1 : 0;
+            if (j >= nbr_lanes) {
+                continue;
+            }
+            Eigen::Vector3d pos = origin(start + j);
+            rayhit.ray.org_x[j] = pos(0);
+            rayhit.ray.org_y[j] = pos(1);
+            rayhit.ray.org_z[j] = pos(2);
+            rayhit.ray.dir_x[j] = dirs(start + j, 0);
+            rayhit.ray.dir_y[j] = dirs(start + j, 1);
+            rayhit.ray.dir_z[j] = dirs(start + j, 2);
+            rayhit.ray.tnear[j] = 0.f;
+            rayhit.ray.tfar[j] = numeric_limits<float>::infinity();
+            rayhit.ray.time[j] = 0.f;
+            rayhit.ray.mask[j] = 0xFFFFFFFF;
+            rayhit.ray.id[j] = start + j;
+            rayhit.ray.flags[j] = 0;
+            rayhit.hit.geomID[j] = RTC_INVALID_GEOMETRY_ID;
+            rayhit.hit.instID[0][j] = RTC_INVALID_GEOMETRY_ID;
+        }
+
+        rtcIntersect8(valid, scene, &context, &rayhit);
+
+        for (int j = 0; j < nbr_lanes; ++j) {
+            int face = rayhit.hit.geomID[j] == RTC_INVALID_GEOMETRY_ID? -1 : int(rayhit.hit.primID[j]);
+            hit_fn(start + j, face, rayhit.hit.u[j], rayhit.hit.v[j], rayhit.ray.tfar[j]);
+        }
+    }
+}
+
+} // namespace
+
+void BathyTracer::set_scene(const BathyScene::Ptr& new_scene)
+{
+    scene = new_scene;
+    last_scene.reset();
+}
+
+void BathyTracer::set_mesh(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+    if (!height_field) {
+        set_scene(BathyScene::create(V, F));
+    }
+}
+
+RTCScene BathyTracer::mesh_scene(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+    if (scene) {
+        return scene->rtc_scene();
+    }
+
+    // by content, since V, F may be new matrices in the buffers of freed ones or edited
+    // in place. holding on to the last scene makes the lookup find it again
+    last_scene = BathyScene::create(V, F);
+    return last_scene->rtc_scene();
+}
+
 Eigen::MatrixXd BathyTracer::ray_mesh_intersection(
     const Eigen::MatrixXd& V_source,
     const Eigen::MatrixXd& N_source,
     const Eigen::MatrixXd& V_target,
     const Eigen::MatrixXi& F_target)
 {
-    if (first_V != V_target.row(0).transpose() ||
-        first_F != F_target.row(0).transpose()) {
-        embree.init(V_target.template cast<float>(),F_target.template cast<int>());
-        first_V = V_target.row(0).transpose();
-        first_F = F_target.row(0).transpose();
-    }
-
     double tol = 0.00001;
 
     // Allocate matrix for the result
@@ -26,21 +98,31 @@ Eigen::MatrixXd BathyTracer::ray_mesh_intersection(
     R.resize(V_source.rows(), 3);
 
     // Shoot rays from the source to the target
-    for (unsigned i = 0; i < V_source.rows(); ++i) {
-        igl::Hit hit;
+    auto origin = [&](int i) -> Eigen::Vector3d {
+        return (V_source.row(i) - tol * N_source.row(i)).transpose();
+    };
 
-        // Shoot ray
-        Eigen::RowVector3d pos = V_source.row(i) - tol * N_source.row(i);
-        Eigen::RowVector3d dir = N_source.row(i);
-        bool did_hit = embree.intersectBeam(pos.cast<float>(), dir.cast<float>(), hit);
+    if (height_field) {
+        height_field_hit hit;
+        for (int i = 0; i < V_source.rows(); ++i) {
+            if (height_field->intersect(origin(i), N_source.row(i).transpose(), hit)) {
+                R.row(i) << hit.face, hit.u, hit.v;
+            }
+            else {
+                R.row(i) << -1, 0, 0;
+            }
+        }
+        return R;
+    }
 
-        if (did_hit) {
-            R.row(i) << hit.id, hit.u, hit.v;
+    intersect_packets(mesh_scene(V_target, F_target), N_source, origin, [&](int i, int face, float u, float v, float) {
+        if (face >= 0) {
+            R.row(i) << face, u, v;
         }
         else {
             R.row(i) << -1, 0, 0;
         }
-    }
+    });
 
     return R;
 }
@@ -49,63 +131,137 @@ double BathyTracer::depth_mesh_underneath_vehicle(const Eigen::Vector3d& origin,
                                                   const Eigen::MatrixXd& V_target,
                                                   const Eigen::MatrixXi& F_target)
 {
-    if (first_V != V_target.row(0).transpose() ||
-        first_F != F_target.row(0).transpose()) {
-        embree.init(V_target.template cast<float>(),F_target.template cast<int>());
-        first_V = V_target.row(0).transpose();
-        first_F = F_target.row(0).transpose();
+    if (height_field) {
+        height_field_hit hit;
+        bool did_hit = height_field->intersect(origin, Eigen::Vector3d(0., 0., -1.), hit);
+        return did_hit? origin(2) - hit.point(2) : 0.;
     }
 
+    RTCScene target_scene = mesh_scene(V_target, F_target);
+
     // Shoot ray
-    igl::Hit hit;
-    bool did_hit = embree.intersectBeam(origin.cast<float>(), Eigen::Vector3f(0., 0., -1.), hit);
-    return did_hit? origin(2) - V_target(F_target(hit.id, 0), 2) : 0.;
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+
+    RTCRayHit rayhit;
+    rayhit.ray.org_x = origin(0);
+    rayhit.ray.org_y = origin(1);
+    rayhit.ray.org_z = origin(2);
+    rayhit.ray.dir_x = 0.f;
+    rayhit.ray.dir_y = 0.f;
+    rayhit.ray.dir_z = -1.f;
+    rayhit.ray.tnear = 0.f;
+    rayhit.ray.tfar = numeric_limits<float>::infinity();
+    rayhit.ray.time = 0.f;
+    rayhit.ray.mask = 0xFFFFFFFF;
+    rayhit.ray.id = 0;
+    rayhit.ray.flags = 0;
+    rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+    rtcIntersect1(target_scene, &context, &rayhit);
+
+    bool did_hit = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+    return did_hit? origin(2) - V_target(F_target(rayhit.hit.primID, 0), 2) : 0.;
 }
 
-tuple<Eigen::MatrixXd, Eigen::MatrixXi> BathyTracer::compute_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs, const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+int BathyTracer::compute_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs,
+                              const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                              Eigen::MatrixXd& hits, Eigen::VectorXi& hits_inds, Eigen::VectorXd& hits_dists)
 {
     auto start = chrono::high_resolution_clock::now();
-    igl::Hit hit;
+
+    int nbr_lines = dirs.rows();
+    if (hits.rows() < nbr_lines || hits.cols() != 3) {
+        hits.resize(nbr_lines, 3);
+    }
+    if (hits_inds.rows() < nbr_lines) {
+        hits_inds.resize(nbr_lines);
+    }
+    if (hits_dists.rows() < nbr_lines) {
+        hits_dists.resize(nbr_lines);
+    }
+
+    // hit points are computed in double from the barycentric coordinates,
+    // directly in the same pass as the intersection
+    double tol = 0.00001;
+    int hit_count = 0;
+    auto origin = [&](int i) -> Eigen::Vector3d {
+        return sensor_origin - tol * dirs.row(i).transpose();
+    };
+
+    if (height_field) {
+        height_field_hit hit;
+        for (int i = 0; i < nbr_lines; ++i) {
+            if (!height_field->intersect(origin(i), dirs.row(i).transpose(), hit)) {
+                continue;
+            }
+            hits.row(hit_count) = hit.point.transpose();
+            hits_inds(hit_count) = hit.face;
+            hits_dists(hit_count) = (hit.t - tol) * dirs.row(i).norm();
+            ++hit_count;
+        }
+        return hit_count;
+    }
+
+    intersect_packets(mesh_scene(V, F), dirs, origin, [&](int i, int face, float u, float v, float t) {
+        if (face < 0) {
+            return;
+        }
+        hits.row(hit_count) = (1. - u - v) * V.row(F(face, 0)) + u * V.row(F(face, 1)) + v * V.row(F(face, 2));
+        hits_inds(hit_count) = face;
+        hits_dists(hit_count) = (double(t) - tol) * dirs.row(i).norm();
+        ++hit_count;
+    });
+
     auto stop = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::microseconds>(stop - start);
-    if (DEBUG_OUTPUT) cout << "compute_sss_dirs time: " << duration.count() << " microseconds" << endl;
+    if (DEBUG_OUTPUT) cout << "packet compute_hits time: " << duration.count() << " microseconds" << endl;
 
-    start = chrono::high_resolution_clock::now();
-    Eigen::MatrixXd hits(dirs.rows(), 3);
-    Eigen::VectorXi hits_inds(dirs.rows());
+    return hit_count;
+}
 
+void BathyTracer::compute_ray_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs,
+                                   const Eigen::MatrixXd& V, const Eigen::MatrixXi& F,
+                                   Eigen::MatrixXd& hits, Eigen::VectorXi& hits_inds)
+{
     int nbr_lines = dirs.rows();
-    Eigen::MatrixXd P = Eigen::MatrixXd(nbr_lines, 3);
-
-    // TODO: we can easily split origin into origin_port and origin_stbd
-    P.rowwise() = sensor_origin.transpose();
-    Eigen::MatrixXd hits_info = ray_mesh_intersection(P, dirs, V, F);
-    stop = chrono::high_resolution_clock::now();
-    duration = chrono::duration_cast<chrono::microseconds>(stop - start);
-    if (DEBUG_OUTPUT) cout << "line_mesh_intersection time: " << duration.count() << " microseconds" << endl;
-
-    start = chrono::high_resolution_clock::now();
-    Eigen::MatrixXd global_hits = igl::barycentric_to_global(V, F, hits_info);
-    stop = chrono::high_resolution_clock::now();
-    duration = chrono::duration_cast<chrono::microseconds>(stop - start);
-    if (DEBUG_OUTPUT) cout << "barycentric_to_global time: " << duration.count() << " microseconds" << endl;
-
-    start = chrono::high_resolution_clock::now();
-    int hit_count = 0;
-    for (int i = 0; i < dirs.rows(); ++i) {
-        int hit = hits_info(i, 0);
-        if (hit > 0) {
-            int vind = F(hit, 0);
-            hits_inds(hit_count) = hit;
-            hits.row(hit_count) = global_hits.row(i);
-            ++hit_count;
+    hits.setZero(nbr_lines, 3);
+    hits_inds.setConstant(nbr_lines, -1);
+
+    double tol = 0.00001;
+    auto origin = [&](int i) -> Eigen::Vector3d {
+        return sensor_origin - tol * dirs.row(i).transpose();
+    };
+
+    if (height_field) {
+        height_field_hit hit;
+        for (int i = 0; i < nbr_lines; ++i) {
+            if (height_field->intersect(origin(i), dirs.row(i).transpose(), hit)) {
+                hits.row(i) = hit.point.transpose();
+                hits_inds(i) = hit.face;
+            }
         }
+        return;
     }
+
+    intersect_packets(mesh_scene(V, F), dirs, origin, [&](int i, int face, float u, float v, float) {
+        if (face < 0) {
+            return;
+        }
+        hits.row(i) = (1. - u - v) * V.row(F(face, 0)) + u * V.row(F(face, 1)) + v * V.row(F(face, 2));
+        hits_inds(i) = face;
+    });
+}
+
+tuple<Eigen::MatrixXd, Eigen::MatrixXi> BathyTracer::compute_hits(const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& dirs, const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+{
+    Eigen::MatrixXd hits;
+    Eigen::VectorXi hits_inds;
+    Eigen::VectorXd hits_dists;
+    int hit_count = compute_hits(sensor_origin, dirs, V, F, hits, hits_inds, hits_dists);
+
     hits.conservativeResize(hit_count, 3);
     hits_inds.conservativeResize(hit_count);
-    stop = chrono::high_resolution_clock::now();
-    duration = chrono::duration_cast<chrono::microseconds>(stop - start);
-    if (DEBUG_OUTPUT) cout << "hits loop time: " << duration.count() << " microseconds" << endl;
 
-    return make_tuple(hits, hits_inds);
+    return make_tuple(hits, Eigen::MatrixXi(hits_inds));
 }
@@ -0,0 +1,295 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sonar_tracing/height_field_scene.h>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// face offsets are stored once per block of vertices and counted within the block
+const int face_block_size = 32;
+
+// slack on the height bounds and cell boxes, so rays along cell borders are not lost
+const double bounds_tolerance = 1e-4;
+
+// clips t0, t1 to the ray interval between lo and hi along one axis
+bool clip_axis(double o, double d, double lo, double hi, double& t0, double& t1)
+{
+    if (d == 0.) {
+        return o >= lo && o <= hi;
+    }
+    double ta = (lo - o)/d;
+    double tb = (hi - o)/d;
+    if (ta > tb) {
+        swap(ta, tb);
+    }
+    t0 = max(t0, ta);
+    t1 = min(t1, tb);
+    return t0 <= t1;
+}
+
+// moller-trumbore, with u, v such that p = (1-u-v)*v0 + u*v1 + v*v2 as in embree
+bool intersect_triangle(const Eigen::Vector3d& origin, const Eigen::Vector3d& dir,
+                        const Eigen::Vector3d& v0, const Eigen::Vector3d& v1, const Eigen::Vector3d& v2,
+                        double& t, double& u, double& v)
+{
+    const double eps = 1e-9;
+    Eigen::Vector3d e1 = v1 - v0;
+    Eigen::Vector3d e2 = v2 - v0;
+    Eigen::Vector3d p = dir.cross(e2);
+    double det = e1.dot(p);
+    if (fabs(det) < 1e-15) {
+        return false;
+    }
+    double inv_det = 1./det;
+    Eigen::Vector3d s = origin - v0;
+    u = s.dot(p)*inv_det;
+    if (u < -eps || u > 1. + eps) {
+        return false;
+    }
+    Eigen::Vector3d q = s.cross(e1);
+    v = dir.dot(q)*inv_det;
+    if (v < -eps || u + v > 1. + eps) {
+        return false;
+    }
+    t = e2.dot(q)*inv_det;
+    return t >= 0.;
+}
+
+// the mipmap has at most one level per bit of the grid size, the traversal
+// stack then never holds more than 3 siblings per level plus the root
+const int max_levels = 32;
+const int max_stack_size = 4*max_levels + 4;
+
+struct traversal_node {
+    int level;
+    int y;
+    int x;
+    double t0;
+    double t1;
+};
+
+} // namespace
+
+HeightFieldScene::HeightFieldScene(const Eigen::MatrixXd& height_map, double res)
+    : rows(height_map.rows()), cols(height_map.cols()), res(res), nbr_faces(0)
+{
+    heights.resize(rows*cols);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            heights[y*cols+x] = height_map(y, x);
+        }
+    }
+
+    // faces are counted in the same order as mesh_from_height_map emits them
+    block_faces.resize((rows*cols + face_block_size - 1)/face_block_size);
+    for (int i = 0; i < rows*cols; ++i) {
+        if (i % face_block_size == 0) {
+            block_faces[i/face_block_size] = nbr_faces;
+        }
+        nbr_faces += int(has_upper_face(i/cols, i%cols)) + int(has_lower_face(i/cols, i%cols));
+    }
+
+    const float empty_min = numeric_limits<float>::max();
+    const float empty_max = -numeric_limits<float>::max();
+
+    // level 1 from the triangles of the cells, then 2x2 reductions up to a single node.
+    // grids with a single row or column have no cells, and so no faces and no levels
+    int cell_rows = max(rows - 1, 0);
+    int cell_cols = max(cols - 1, 0);
+    int level_y = cell_rows;
+    int level_x = cell_cols;
+    while (level_y > 0 && level_x > 0 && (level_y > 1 || level_x > 1)) {
+        int next_y = (level_y + 1)/2;
+        int next_x = (level_x + 1)/2;
+        vector<float> mins(next_y*next_x, empty_min);
+        vector<float> maxs(next_y*next_x, empty_max);
+        for (int y = 0; y < level_y; ++y) {
+            for (int x = 0; x < level_x; ++x) {
+                float min_height = empty_min;
+                float max_height = empty_max;
+                if (min_levels.empty()) {
+                    auto add_vertex = [&](int vy, int vx) {
+                        min_height = min(min_height, height(vy, vx));
+                        max_height = max(max_height, height(vy, vx));
+                    };
+                    if (has_lower_face(y, x)) {
+                        add_vertex(y, x); add_vertex(y, x+1); add_vertex(y+1, x);
+                    }
+                    if (has_upper_face(y+1, x+1)) {
+                        add_vertex(y+1, x+1); add_vertex(y+1, x); add_vertex(y, x+1);
+                    }
+                }
+                else {
+                    min_height = min_levels.back()[y*level_x+x];
+                    max_height = max_levels.back()[y*level_x+x];
+                }
+                int parent = (y/2)*next_x + x/2;
+                mins[parent] = min(mins[parent], min_height);
+                maxs[parent] = max(maxs[parent], max_height);
+            }
+        }
+        min_levels.push_back(mins);
+        max_levels.push_back(maxs);
+        level_rows.push_back(next_y);
+        level_cols.push_back(next_x);
+        level_y = next_y;
+        level_x = next_x;
+    }
+
+    bounds_min = Eigen::Vector3d(.5*res, .5*res, 0.);
+    bounds_max = Eigen::Vector3d((double(cols)-.5)*res, (double(rows)-.5)*res, 0.);
+    if (!min_levels.empty()) {
+        bounds_min(2) = min_levels.back()[0];
+        bounds_max(2) = max_levels.back()[0];
+    }
+    else if (cell_rows == 1 && cell_cols == 1) {
+        bounds_min(2) = *min_element(heights.begin(), heights.end());
+        bounds_max(2) = *max_element(heights.begin(), heights.end());
+    }
+}
+
+HeightFieldScene::Ptr HeightFieldScene::create(const Eigen::MatrixXd& height_map, double res)
+{
+    return Ptr(new HeightFieldScene(height_map, res));
+}
+
+bool HeightFieldScene::has_upper_face(int y, int x) const
+{
+    return x > 0 && y > 0 && height(y, x) != 0 && height(y, x-1) != 0 && height(y-1, x) != 0;
+}
+
+bool HeightFieldScene::has_lower_face(int y, int x) const
+{
+    return x < cols-1 && y < rows-1 && height(y, x) != 0 && height(y+1, x) != 0 && height(y, x+1) != 0;
+}
+
+int HeightFieldScene::first_face(int y, int x) const
+{
+    int index = y*cols + x;
+    int block = index/face_block_size;
+    int face = block_faces[block];
+    for (int i = block*face_block_size; i < index; ++i) {
+        face += int(has_upper_face(i/cols, i%cols)) + int(has_lower_face(i/cols, i%cols));
+    }
+    return face;
+}
+
+bool HeightFieldScene::intersect_cell(int y, int x, const Eigen::Vector3d& origin, const Eigen::Vector3d& dir,
+                                      double t_max, height_field_hit& hit) const
+{
+    auto vertex = [&](int vy, int vx) {
+        return Eigen::Vector3d((double(vx)+.5)*res, (double(vy)+.5)*res, height(vy, vx));
+    };
+
+    bool did_hit = false;
+    double t, u, v;
+    hit.t = t_max;
+    if (has_lower_face(y, x)) {
+        Eigen::Vector3d v0 = vertex(y, x);
+        Eigen::Vector3d v1 = vertex(y, x+1);
+        Eigen::Vector3d v2 = vertex(y+1, x);
+        if (intersect_triangle(origin, dir, v0, v1, v2, t, u, v) && t < hit.t) {
+            hit.face = first_face(y, x) + int(has_upper_face(y, x));
+            hit.u = u;
+            hit.v = v;
+            hit.t = t;
+            hit.point = (1. - u - v)*v0 + u*v1 + v*v2;
+            did_hit = true;
+        }
+    }
+    if (has_upper_face(y+1, x+1)) {
+        Eigen::Vector3d v0 = vertex(y+1, x+1);
+        Eigen::Vector3d v1 = vertex(y+1, x);
+        Eigen::Vector3d v2 = vertex(y, x+1);
+        if (intersect_triangle(origin, dir, v0, v1, v2, t, u, v) && t < hit.t) {
+            hit.face = first_face(y+1, x+1);
+            hit.u = u;
+            hit.v = v;
+            hit.t = t;
+            hit.point = (1. - u - v)*v0 + u*v1 + v*v2;
+            did_hit = true;
+        }
+    }
+
+    return did_hit;
+}
+
+bool HeightFieldScene::intersect(const Eigen::Vector3d& origin, const Eigen::Vector3d& dir, height_field_hit& hit) const
+{
+    if (nbr_faces == 0) {
+        return false;
+    }
+
+    double t0 = 0.;
+    double t1 = numeric_limits<double>::infinity();
+    for (int i = 0; i < 3; ++i) {
+        if (!clip_axis(origin(i), dir(i), bounds_min(i) - bounds_tolerance, bounds_max(i) + bounds_tolerance, t0, t1)) {
+            return false;
+        }
+    }
+
+    // depth first, front to back, so the first cell with a hit has the closest one
+    traversal_node stack[max_stack_size];
+    int stack_size = 0;
+    stack[stack_size++] = traversal_node{ int(min_levels.size()), 0, 0, t0, t1 };
+    while (stack_size > 0) {
+        traversal_node node = stack[--stack_size];
+
+        if (node.level == 0) {
+            if (intersect_cell(node.y, node.x, origin, dir, numeric_limits<double>::infinity(), hit)) {
+                return true;
+            }
+            continue;
+        }
+
+        // skip the node if the ray passes above or below all of its triangles
+        int index = node.y*level_cols[node.level-1] + node.x;
+        double za = origin(2) + node.t0*dir(2);
+        double zb = origin(2) + node.t1*dir(2);
+        if (max(za, zb) < min_levels[node.level-1][index] - bounds_tolerance ||
+            min(za, zb) > max_levels[node.level-1][index] + bounds_tolerance) {
+            continue;
+        }
+
+        int child_level = node.level - 1;
+        int child_rows = child_level == 0? rows - 1 : level_rows[child_level-1];
+        int child_cols = child_level == 0? cols - 1 : level_cols[child_level-1];
+        int child_size = 1 << child_level;
+        traversal_node children[4];
+        int nbr_children = 0;
+        for (int y = 2*node.y; y < min(2*node.y + 2, child_rows); ++y) {
+            for (int x = 2*node.x; x < min(2*node.x + 2, child_cols); ++x) {
+                // the cells of a child span vertices child_size*x to child_size*(x+1)
+                double minx = (double(x*child_size)+.5)*res - bounds_tolerance;
+                double maxx = (double(min((x+1)*child_size, cols-1))+.5)*res + bounds_tolerance;
+                double miny = (double(y*child_size)+.5)*res - bounds_tolerance;
+                double maxy = (double(min((y+1)*child_size, rows-1))+.5)*res + bounds_tolerance;
+                traversal_node child{ child_level, y, x, node.t0, node.t1 };
+                if (clip_axis(origin(0), dir(0), minx, maxx, child.t0, child.t1) &&
+                    clip_axis(origin(1), dir(1), miny, maxy, child.t0, child.t1)) {
+                    children[nbr_children] = child;
+                    ++nbr_children;
+                }
+            }
+        }
+        sort(children, children + nbr_children, [](const traversal_node& a, const traversal_node& b) {
+            return a.t0 > b.t0;
+        });
+        copy(children, children + nbr_children, stack + stack_size);
+        stack_size += nbr_children;
+    }
+
+    return false;
+}
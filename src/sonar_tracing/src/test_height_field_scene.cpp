@@ -0,0 +1,138 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sonar_tracing/height_field_scene.h>
+
+#include <iostream>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+// moller-trumbore without tolerances, for the brute force reference
+bool intersect_triangle(const Eigen::Vector3d& origin, const Eigen::Vector3d& dir,
+                        const Eigen::Vector3d& v0, const Eigen::Vector3d& v1, const Eigen::Vector3d& v2, double& t)
+{
+    Eigen::Vector3d e1 = v1 - v0;
+    Eigen::Vector3d e2 = v2 - v0;
+    Eigen::Vector3d p = dir.cross(e2);
+    double det = e1.dot(p);
+    if (fabs(det) < 1e-15) {
+        return false;
+    }
+    Eigen::Vector3d s = origin - v0;
+    double u = s.dot(p)/det;
+    if (u < 0. || u > 1.) {
+        return false;
+    }
+    Eigen::Vector3d q = s.cross(e1);
+    double v = dir.dot(q)/det;
+    if (v < 0. || u + v > 1.) {
+        return false;
+    }
+    t = e2.dot(q)/det;
+    return t >= 0.;
+}
+
+// the mesh of mesh_from_height_map, with vertex (y, x) at ((x+.5)*res, (y+.5)*res, height)
+void grid_mesh(const Eigen::MatrixXd& height_map, double res, Eigen::MatrixXd& V, Eigen::MatrixXi& F)
+{
+    int rows = height_map.rows();
+    int cols = height_map.cols();
+    V.resize(rows*cols, 3);
+    F.resize(2*rows*cols, 3);
+    int nbr_faces = 0;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            V.row(y*cols+x) << (double(x)+.5)*res, (double(y)+.5)*res, height_map(y, x);
+            if (height_map(y, x) == 0) {
+                continue;
+            }
+            if (x > 0 && y > 0 && height_map(y, x-1) != 0 && height_map(y-1, x) != 0) {
+                F.row(nbr_faces++) << y*cols+x, y*cols+x-1, (y-1)*cols+x;
+            }
+            if (x < cols-1 && y < rows-1 && height_map(y+1, x) != 0 && height_map(y, x+1) != 0) {
+                F.row(nbr_faces++) << y*cols+x, y*cols+x+1, (y+1)*cols+x;
+            }
+        }
+    }
+    F.conservativeResize(nbr_faces, 3);
+}
+
+// traces random rays on a random grid with holes, returns false if the faces or any
+// hit differ from brute force intersection of all the triangles of the mesh
+bool check_grid(int rows, int cols, mt19937& generator)
+{
+    uniform_real_distribution<double> uniform(0., 1.);
+    const double res = .7;
+
+    Eigen::MatrixXd height_map(rows, cols);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            height_map(y, x) = uniform(generator) < .05? 0. : -20. + 3.*sin(.2*x) + 2.*cos(.15*y) + uniform(generator);
+        }
+    }
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    grid_mesh(height_map, res, V, F);
+    HeightFieldScene::Ptr scene = HeightFieldScene::create(height_map, res);
+    if (scene->get_nbr_faces() != F.rows()) {
+        cout << "Grid " << rows << " x " << cols << " has " << scene->get_nbr_faces() << " faces, expected " << F.rows() << endl;
+        return false;
+    }
+
+    for (int k = 0; k < 2000; ++k) {
+        // oblique rays, vertical rays and rays close to horizontal
+        Eigen::Vector3d origin(uniform(generator)*cols*res, uniform(generator)*rows*res, 10.*uniform(generator) - 5.);
+        Eigen::Vector3d dir(uniform(generator) - .5, uniform(generator) - .5, -uniform(generator));
+        if (k % 10 == 0) {
+            dir = Eigen::Vector3d(0., 0., -1.);
+        }
+        else if (k % 13 == 0) {
+            dir(2) = .3*(uniform(generator) - .2);
+        }
+
+        double closest_t = numeric_limits<double>::infinity();
+        for (int f = 0; f < F.rows(); ++f) {
+            double t;
+            if (intersect_triangle(origin, dir, V.row(F(f, 0)), V.row(F(f, 1)), V.row(F(f, 2)), t)) {
+                closest_t = min(closest_t, t);
+            }
+        }
+
+        // rays through shared edges may hit either face, so the faces are not compared
+        height_field_hit hit;
+        bool did_hit = scene->intersect(origin, dir, hit);
+        bool correct = did_hit == (closest_t < numeric_limits<double>::infinity());
+        if (correct && did_hit) {
+            Eigen::Vector3d point = (1. - hit.u - hit.v)*V.row(F(hit.face, 0)) + hit.u*V.row(F(hit.face, 1)) + hit.v*V.row(F(hit.face, 2));
+            correct = fabs(hit.t - closest_t) < 1e-6*(1. + closest_t) && (point - hit.point).norm() < 1e-4;
+        }
+        if (!correct) {
+            cout << "Grid " << rows << " x " << cols << ": ray " << k << " does not match brute force" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // includes grids with a single row or column, which have no faces
+    mt19937 generator(1);
+    const int grid_sizes[][2] = { {57, 83}, {130, 5}, {2, 2}, {2, 9}, {9, 2}, {3, 3}, {1, 7}, {7, 1}, {1, 1} };
+    bool passed = true;
+    for (const auto& grid_size : grid_sizes) {
+        passed = check_grid(grid_size[0], grid_size[1], generator) && passed;
+    }
+
+    return passed? 0 : 1;
+}
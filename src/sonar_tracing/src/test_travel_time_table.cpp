@@ -0,0 +1,103 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sonar_tracing/travel_time_table.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// reference two way time from the sensor to (range, depth), found by bisection on the snell
+// ray parameter over the straight segments in each layer. returns -1 if no ray gets there
+double bisection_time(const Eigen::VectorXd& layer_depths, const Eigen::VectorXd& layer_speeds, double range, double depth)
+{
+    vector<double> heights;
+    vector<double> speeds;
+    double top = 0.;
+    for (int k = 0; k < layer_speeds.rows() && top < depth; ++k) {
+        double bottom = k < layer_depths.rows()? min(-layer_depths(k), depth) : depth;
+        heights.push_back(bottom - top);
+        speeds.push_back(layer_speeds(k));
+        top = bottom;
+    }
+    double max_speed = *max_element(speeds.begin(), speeds.end());
+
+    auto ray_range = [&](double p) {
+        double x = 0.;
+        for (int k = 0; k < int(heights.size()); ++k) {
+            double s = p*speeds[k];
+            x += heights[k]*s/sqrt(1. - s*s);
+        }
+        return x;
+    };
+
+    double low = 0.;
+    double high = (1. - 1e-12)/max_speed;
+    if (ray_range(high) < range) {
+        return -1.;
+    }
+    for (int i = 0; i < 200; ++i) {
+        double p = .5*(low + high);
+        (ray_range(p) < range? low : high) = p;
+    }
+
+    double p = .5*(low + high);
+    double time = 0.;
+    for (int k = 0; k < int(heights.size()); ++k) {
+        double s = p*speeds[k];
+        time += heights[k]/(speeds[k]*sqrt(1. - s*s));
+    }
+    return 2.*time;
+}
+
+// the tables should agree with bisection solves to 2e-4 off the grid points, both
+// for speeds decreasing with depth and for speeds increasing with depth. points
+// above the sensor should get the straight slant distance at the top speed
+int main(int argc, char** argv)
+{
+    Eigen::VectorXd layer_depths(3); layer_depths << -10., -20., -30.;
+    Eigen::MatrixXd profiles(2, 4);
+    profiles << 1500., 1490., 1485., 1480.,
+                1480., 1490., 1500., 1520.;
+
+    int nbr_failed = 0;
+    for (int k = 0; k < profiles.rows(); ++k) {
+        Eigen::VectorXd layer_speeds = profiles.row(k).transpose();
+        TravelTimeTable table(layer_depths, layer_speeds, 100., 60., .5);
+        for (double depth = 1.3; depth < 60.; depth += 1.7) {
+            for (double range = .4; range < 100.; range += 2.3) {
+                double reference = bisection_time(layer_depths, layer_speeds, range, depth);
+                if (reference < 0.) {
+                    continue;
+                }
+                double time = table.two_way_time(Eigen::Vector2d(range, -depth));
+                if (fabs(time - reference) > 2e-4*reference) {
+                    cout << "Profile " << k << ", range " << range << ", depth " << depth << ": "
+                         << time << " s, expected " << reference << " s" << endl;
+                    ++nbr_failed;
+                }
+            }
+        }
+        for (double height = .5; height < 20.; height += 3.1) {
+            double range = 2.*height + 1.;
+            double reference = 2.*sqrt(range*range + height*height)/layer_speeds(0);
+            double time = table.two_way_time(Eigen::Vector2d(range, height));
+            if (fabs(time - reference) > 1e-9*reference) {
+                cout << "Profile " << k << ", range " << range << ", height " << height << ": "
+                     << time << " s, expected " << reference << " s" << endl;
+                ++nbr_failed;
+            }
+        }
+    }
+
+    return nbr_failed == 0? 0 : 1;
+}
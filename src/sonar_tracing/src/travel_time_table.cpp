@@ -0,0 +1,195 @@
+/* Copyright 2018 Nils Bore (nbore@kth.se)
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sonar_tracing/travel_time_table.h>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+TravelTimeTable::TravelTimeTable(const Eigen::VectorXd& layer_depths, const Eigen::VectorXd& layer_speeds,
+                                 double max_range, double max_depth, double resolution, int nbr_angles)
+    : range_res(resolution), depth_res(resolution)
+{
+    const int nbr_ranges = int(ceil(max(max_range, 0.)/range_res)) + 1;
+    const int nbr_depths = int(ceil(max(max_depth, 0.)/depth_res)) + 1;
+    time_per_dist.resize(nbr_depths, nbr_ranges);
+    slowness.resize(nbr_depths);
+
+    // layer boundaries as positive depths below the sensor, skipping the ones above it
+    vector<double> boundaries;
+    vector<double> speeds;
+    for (int k = 0; k < layer_speeds.rows(); ++k) {
+        if (k < layer_depths.rows() && layer_depths(k) >= 0.) {
+            continue;
+        }
+        speeds.push_back(layer_speeds(k));
+        if (k < layer_depths.rows()) {
+            boundaries.push_back(-layer_depths(k));
+        }
+    }
+    if (speeds.empty()) {
+        speeds.push_back(layer_speeds.rows() > 0? layer_speeds(layer_speeds.rows()-1) : 1500.);
+    }
+
+    // the ray state of each launch angle, going down one depth row at a time
+    const double max_angle = M_PI/180.*89.9;
+    vector<double> sin_angles(nbr_angles); // sine of the angle from the vertical in the first layer
+    vector<double> ray_ranges(nbr_angles, 0.);
+    vector<double> ray_times(nbr_angles, 0.);
+    for (int a = 0; a < nbr_angles; ++a) {
+        sin_angles[a] = sin(max_angle*double(a)/double(max(nbr_angles-1, 1)));
+    }
+
+    int layer = 0; // layer of the current depth row
+    for (int j = 0; j < nbr_depths; ++j) {
+        double depth = double(j)*depth_res;
+        if (j > 0) {
+            // advance all rays from the previous row, in steps that stop at the layer boundaries
+            double last_depth = depth - depth_res;
+            while (last_depth < depth) {
+                double next_depth = layer < int(boundaries.size())? min(depth, boundaries[layer]) : depth;
+                double height = next_depth - last_depth;
+                double speed = speeds[min(layer, int(speeds.size())-1)];
+                double ratio = speed/speeds[0];
+                for (int a = 0; a < nbr_angles; ++a) {
+                    double s = sin_angles[a]*ratio; // snell's law
+                    if (s >= 1. || ray_ranges[a] == numeric_limits<double>::infinity()) {
+                        ray_ranges[a] = numeric_limits<double>::infinity(); // the ray turned above this depth
+                        continue;
+                    }
+                    double c = sqrt(1. - s*s);
+                    ray_ranges[a] += height*s/c;
+                    ray_times[a] += height/(speed*c);
+                }
+                last_depth = next_depth;
+                if (layer < int(boundaries.size()) && next_depth >= boundaries[layer]) {
+                    ++layer;
+                }
+            }
+            slowness(j) = ray_times[0]/depth;
+        }
+        else {
+            slowness(j) = 1./speeds[0];
+        }
+
+        // invert the ray ranges to get the times at the range grid, the
+        // ranges increase with the launch angle until the rays start turning
+        int a = 1;
+        for (int i = 0; i < nbr_ranges; ++i) {
+            double range = double(i)*range_res;
+            double dist = sqrt(range*range + depth*depth);
+            if (j == 0 || nbr_angles < 2) {
+                time_per_dist(j, i) = 2.*slowness(j);
+                continue;
+            }
+            while (a < nbr_angles && ray_ranges[a] < range) {
+                ++a;
+            }
+            if (a >= nbr_angles || ray_ranges[a] == numeric_limits<double>::infinity()) {
+                time_per_dist(j, i) = fallback_time(range, depth)/dist;
+                continue;
+            }
+            double dr = ray_ranges[a] - ray_ranges[a-1];
+            double t = dr > 0.? (range - ray_ranges[a-1])/dr : 1.;
+            time_per_dist(j, i) = 2.*((1. - t)*ray_times[a-1] + t*ray_times[a])/dist;
+        }
+    }
+}
+
+double TravelTimeTable::fallback_time(double range, double depth) const
+{
+    // straight ray with the vertical mean slowness down to that depth,
+    // or the surface slowness for points above the sensor
+    double row = min(max(depth/depth_res, 0.), double(slowness.rows()-1));
+    int j = int(row);
+    int jn = min(j+1, int(slowness.rows())-1);
+    double t = row - double(j);
+    double s = (1. - t)*slowness(j) + t*slowness(jn);
+    return 2.*sqrt(range*range + depth*depth)*s;
+}
+
+double TravelTimeTable::two_way_time(const Eigen::Vector2d& end_point) const
+{
+    double range = fabs(end_point(0));
+    double depth = -end_point(1);
+    double col = range/range_res;
+    double row = depth/depth_res;
+    if (row < 0. || col > double(time_per_dist.cols()-1) || row > double(time_per_dist.rows()-1)) {
+        return fallback_time(range, depth);
+    }
+
+    int i = min(int(col), int(time_per_dist.cols())-2);
+    int j = min(int(row), int(time_per_dist.rows())-2);
+    if (i < 0 || j < 0) { // single row or column table
+        return fallback_time(range, depth);
+    }
+    double u = col - double(i);
+    double v = row - double(j);
+    double ratio = (1. - v)*((1. - u)*time_per_dist(j, i) + u*time_per_dist(j, i+1)) +
+                   v*((1. - u)*time_per_dist(j+1, i) + u*time_per_dist(j+1, i+1));
+    return ratio*sqrt(range*range + depth*depth);
+}
+
+Eigen::VectorXd TravelTimeTable::two_way_times(const Eigen::MatrixXd& end_points) const
+{
+    Eigen::VectorXd end_times(end_points.rows());
+    for (int i = 0; i < end_points.rows(); ++i) {
+        end_times(i) = two_way_time(end_points.row(i).transpose());
+    }
+    return end_times;
+}
+
+TravelTimeTableCache::TravelTimeTableCache(double max_range, double floor_height, double resolution, double depth_step)
+    : max_range(max_range), floor_height(floor_height), resolution(resolution), depth_step(depth_step)
+{
+}
+
+TravelTimeTable::Ptr TravelTimeTableCache::get_table(const Eigen::VectorXd& layer_heights, const Eigen::VectorXd& layer_speeds, double sensor_height)
+{
+    int depth_index = int(round(sensor_height/depth_step));
+    vector<double> profile(layer_heights.data(), layer_heights.data() + layer_heights.size());
+    profile.insert(profile.end(), layer_speeds.data(), layer_speeds.data() + layer_speeds.size());
+    auto key = make_pair(depth_index, profile);
+
+    {
+        lock_guard<mutex> lock(tables_mutex);
+        auto iter = tables.find(key);
+        if (iter != tables.end()) {
+            return iter->second;
+        }
+    }
+
+    // build outside the lock, two threads may build the same table but that is harmless
+    double height = double(depth_index)*depth_step;
+    Eigen::VectorXd layer_depths = layer_heights.array() - height;
+    double max_depth = max(height - floor_height, 0.) + depth_step;
+    TravelTimeTable::Ptr table = make_shared<const TravelTimeTable>(layer_depths, layer_speeds, max_range, max_depth, resolution);
+
+    lock_guard<mutex> lock(tables_mutex);
+    if (tables.size() > 4096) {
+        tables.clear();
+    }
+    return tables.insert(make_pair(key, table)).first->second;
+}
+
+Eigen::VectorXd TravelTimeTableCache::compute_times(const Eigen::VectorXd& layer_heights, const Eigen::VectorXd& layer_speeds,
+                                                    const Eigen::Vector3d& sensor_origin, const Eigen::MatrixXd& P)
+{
+    TravelTimeTable::Ptr table = get_table(layer_heights, layer_speeds, sensor_origin(2));
+
+    Eigen::VectorXd times(P.rows());
+    for (int i = 0; i < P.rows(); ++i) {
+        Eigen::Vector2d end_point((P.row(i).head<2>() - sensor_origin.head<2>().transpose()).norm(), P(i, 2) - sensor_origin(2));
+        times(i) = table->two_way_time(end_point);
+    }
+    return times;
+}